@@ -6,6 +6,7 @@ namespace Analytics {
         this->minSupport      = minSupport;
         this->maxSupportError = maxSupportError;
         this->minConfidence   = minConfidence;
+        this->miningEngine    = MINING_ENGINE_FPGROWTH;
 
         // Stats for the UI.
         this->allBatchesNumPageViews = 0;
@@ -21,6 +22,7 @@ namespace Analytics {
 #endif
 
         this->fpstream = new FPStream(this->minSupport, this->maxSupportError, &this->itemIDNameHash, &this->itemNameIDHash, &this->sortedFrequentItemIDs);
+        this->fpstream->setMiningEngine(this->miningEngine);
         connect(this->fpstream, SIGNAL(batchProcessed()), this, SLOT(fpstreamProcessedBatch()));
     }
 
@@ -64,6 +66,21 @@ namespace Analytics {
         this->ruleConsequentItemConstraints.addItemConstraint(item, type);
     }
 
+    /**
+     * Set the engine that mines the frequent itemsets of a batch when it is
+     * mined synchronously: the initial batch of FPStream. By default,
+     * FP-growth is used. MINING_ENGINE_FASTEST first mines a sample of the
+     * first such batch with every engine, which only pays off for large
+     * batches; the selected engine is then used for later batches as well.
+     *
+     * @param miningEngine
+     *   A mining engine.
+     */
+    void Analyst::setMiningEngine(MiningEngine miningEngine) {
+        this->miningEngine = miningEngine;
+        this->fpstream->setMiningEngine(miningEngine);
+    }
+
     /**
      * Override of QObject::moveToThread(), to automatically also move the
      * FPStream object to the other thread.
@@ -107,12 +124,28 @@ namespace Analytics {
     //------------------------------------------------------------------------
     // Public slots.
 
-    void Analyst::analyzeTransactions(const QList<QStringList> &transactions, double transactionsPerEvent, Time start, Time end) {
+    /**
+     * Analyze a batch of transactions.
+     *
+     * @param transactions
+     *   A batch of transactions.
+     * @param transactionsPerEvent
+     *   The number of transactions per event.
+     * @param start
+     *   The time of the first event in the batch.
+     * @param end
+     *   The time of the last event in the batch.
+     * @param samplingRate
+     *   The fraction of the batch's events that was sampled (1/k for some
+     *   integer k) when load shedding, 1 otherwise. The stats and supports
+     *   are scaled up to the full batch.
+     */
+    void Analyst::analyzeTransactions(const QList<QStringList> &transactions, double transactionsPerEvent, Time start, Time end, double samplingRate) {
         // Stats for the UI.
         this->currentBatchStartTime = start;
         this->currentBatchEndTime = end;
-        this->currentBatchNumPageViews = transactions.size() / transactionsPerEvent;
-        this->currentBatchNumTransactions = transactions.size();
+        this->currentBatchNumPageViews = transactions.size() / transactionsPerEvent / samplingRate;
+        this->currentBatchNumTransactions = transactions.size() / samplingRate;
         this->timer.start();
 
         // Necessary to be able to update the browsable concept hierarchy in
@@ -123,7 +156,7 @@ namespace Analytics {
         emit analyzing(true, this->currentBatchStartTime, this->currentBatchEndTime, this->currentBatchNumPageViews, this->currentBatchNumTransactions);
 
         // Perform the actual mining.
-        this->performMining(transactions, transactionsPerEvent);
+        this->performMining(transactions, transactionsPerEvent, samplingRate);
 
         // Since the mining above is performed asynchronously, this is NOT the
         // place where we know the calculations end. Only FP-Stream can know,
@@ -313,13 +346,14 @@ namespace Analytics {
                     this->fpstream->getNumFrequentItems(),
                     this->fpstream->getPatternTreeSize()
         );
+        emit deduplicatedTransactions(this->fpstream->getBatchNumTransactions(), this->fpstream->getBatchNumDistinctTransactions());
     }
 
 
     //------------------------------------------------------------------------
     // Protected methods.
 
-    void Analyst::performMining(const QList<QStringList> & transactions, double transactionsPerEvent) {
+    void Analyst::performMining(const QList<QStringList> & transactions, double transactionsPerEvent, double samplingRate) {
         bool fpstream = true;
 
         if (!fpstream) {
@@ -330,10 +364,15 @@ namespace Analytics {
         this->sortedFrequentItemIDs.clear();
 
         qDebug() << "starting mining, # transactions: " << transactions.size();
-        FPGrowth * fpgrowth = new FPGrowth(transactions, ceil(this->minSupport * transactions.size() / transactionsPerEvent), &this->itemIDNameHash, &this->itemNameIDHash, &this->sortedFrequentItemIDs);
+        FPGrowth * fpgrowth = new FPGrowth(transactions, ceil(this->minSupport * transactions.size() / transactionsPerEvent / samplingRate), &this->itemIDNameHash, &this->itemNameIDHash, &this->sortedFrequentItemIDs);
+        fpgrowth->setTransactionWeight(qMax(1, qRound(1.0 / samplingRate)));
         fpgrowth->setConstraints(this->frequentItemsetItemConstraints);
         fpgrowth->setConstraintsForRuleConsequents(this->ruleConsequentItemConstraints);
+        fpgrowth->setMiningEngine(this->miningEngine);
         QList<FrequentItemset> frequentItemsets = fpgrowth->mineFrequentItemsets(false);
+        // Remember the engine that MINING_ENGINE_FASTEST selected, so that
+        // it isn't selected again for every batch.
+        this->miningEngine = fpgrowth->getMiningEngine();
         qDebug() << "frequent itemset mining complete, # frequent itemsets:" << frequentItemsets.size();
 
         /*
@@ -357,7 +396,8 @@ namespace Analytics {
             this->fpstream->setConstraintsToPreprocess(this->ruleConsequentItemConstraints);
             initial = false;
         }
-        this->fpstream->processBatchTransactions(transactions, transactionsPerEvent);
+        this->fpstream->processBatchTransactions(transactions, transactionsPerEvent, samplingRate);
+        this->miningEngine = this->fpstream->getMiningEngine();
         /*
         qDebug() << this->fpstream->getPatternTree().getNodeCount();
         qDebug() << this->itemIDNameHash.size() << this->itemNameIDHash.size() << this->sortedFrequentItemIDs.size();
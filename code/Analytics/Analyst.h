@@ -32,6 +32,7 @@ namespace Analytics {
         ~Analyst();
         void addFrequentItemsetItemConstraint(ItemName item, ItemConstraintType type);
         void addRuleConsequentItemConstraint(ItemName item, ItemConstraintType type);
+        void setMiningEngine(MiningEngine miningEngine);
 
         // Override moveToThread to also move the FPStream instance.
         void moveToThread(QThread * thread);
@@ -45,6 +46,7 @@ namespace Analytics {
         void analyzing(bool, Time start, Time end, int pageViews, int transactions);
         void analyzedDuration(int duration);
         void stats(Time start, Time end, int pageViews, int transactions, int uniqueItems, int frequentItems, int patternTreeSize);
+        void deduplicatedTransactions(int transactions, int distinctTransactions);
         void mining(bool);
         void minedDuration(int duration);
 
@@ -64,7 +66,7 @@ namespace Analytics {
                                 Analytics::SupportCount eventsInNewerTimeRange);
 
     public slots:
-        void analyzeTransactions(const QList<QStringList> & transactions, double transactionsPerEvent, Time start, Time end);
+        void analyzeTransactions(const QList<QStringList> & transactions, double transactionsPerEvent, Time start, Time end, double samplingRate = 1.0);
         void mineRules(uint from, uint to);
         void mineAndCompareRules(uint fromOlder, uint toOlder, uint fromNewer, uint toNewer);
 
@@ -72,13 +74,14 @@ namespace Analytics {
         void fpstreamProcessedBatch();
 
     protected:
-        void performMining(const QList<QStringList> & transactions, double transactionsPerEvent);
+        void performMining(const QList<QStringList> & transactions, double transactionsPerEvent, double samplingRate);
         void updateConceptHierarchyModel(int itemsAlreadyProcessed);
 
         FPStream * fpstream;
         double minSupport;
         double maxSupportError;
         double minConfidence;
+        MiningEngine miningEngine;
 
         Constraints frequentItemsetItemConstraints;
         Constraints ruleConsequentItemConstraints;
@@ -5,7 +5,12 @@ INCLUDEPATH += $${PWD}
 
 SOURCES += \
     $${PWD}/Item.cpp \
+    $${PWD}/NodeArena.cpp \
     $${PWD}/FPTree.cpp \
+    $${PWD}/ProjectedDatabase.cpp \
+    $${PWD}/WorkStealingPool.cpp \
+    $${PWD}/TidBitset.cpp \
+    $${PWD}/Eclat.cpp \
     $${PWD}/FPGrowth.cpp\
     $${PWD}/RuleMiner.cpp \
     $${PWD}/Analyst.cpp \
@@ -15,8 +20,13 @@ SOURCES += \
     $${PWD}/TiltedTimeWindow.cpp
 HEADERS += \
     $${PWD}/Item.h \
+    $${PWD}/NodeArena.h \
     $${PWD}/FPNode.h \
     $${PWD}/FPTree.h \
+    $${PWD}/ProjectedDatabase.h \
+    $${PWD}/WorkStealingPool.h \
+    $${PWD}/TidBitset.h \
+    $${PWD}/Eclat.h \
     $${PWD}/FPGrowth.h \
     $${PWD}/RuleMiner.h \
     $${PWD}/Analyst.h \
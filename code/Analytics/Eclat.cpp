@@ -0,0 +1,270 @@
+#include "Eclat.h"
+
+namespace Analytics {
+
+    //------------------------------------------------------------------------
+    // Public methods.
+
+    /**
+     * Build the tidsets of the frequent items.
+     *
+     * @param transactions
+     *   The weighted transactions.
+     * @param itemIDs
+     *   The frequent items, in the order in which they occur in the FP-tree
+     *   (see FPGrowth::optimizeItemset()). Other items are ignored.
+     * @param minSupportAbsolute
+     *   The minimum absolute support count that itemsets should meet. Like
+     *   FP-growth, only itemsets that occur in the transactions are mined,
+     *   even when it is zero.
+     */
+    Eclat::Eclat(const QList<WeightedTransaction> & transactions, const ItemIDList & itemIDs, SupportCount minSupportAbsolute) {
+        this->itemIDs = itemIDs;
+        this->minSupportAbsolute = qMax(minSupportAbsolute, (SupportCount) 1);
+#ifdef DEBUG
+        this->itemIDNameHash = NULL;
+#endif
+
+        for (int i = 0; i < itemIDs.size(); i++)
+            this->itemIndices.insert(itemIDs[i], i);
+
+        // Count the transactions per weight. Transactions without any
+        // frequent items don't need a bit.
+        QVector<bool> containsFrequentItems(transactions.size());
+        QMap<SupportCount, int> numTransactionsPerWeight;
+        for (int t = 0; t < transactions.size(); t++) {
+            foreach (ItemID itemID, transactions[t].itemIDs) {
+                if (this->itemIndices.contains(itemID)) {
+                    containsFrequentItems[t] = true;
+                    numTransactionsPerWeight[transactions[t].weight]++;
+                    break;
+                }
+            }
+        }
+
+        // Lay out the bits: first the weight groups, then the tail.
+        QHash<SupportCount, int> nextGroupBit;
+        int numTailTransactions = 0;
+        int offset = 0;
+        QMap<SupportCount, int>::const_iterator it;
+        for (it = numTransactionsPerWeight.constBegin(); it != numTransactionsPerWeight.constEnd(); ++it) {
+            if (it.value() < ECLAT_MIN_WEIGHT_GROUP_SIZE) {
+                numTailTransactions += it.value();
+                continue;
+            }
+
+            WeightGroup group;
+            group.offset = offset;
+            group.numWords = (it.value() + 63) / 64;
+            group.weight = it.key();
+            this->weightGroups.append(group);
+            nextGroupBit.insert(it.key(), 64 * offset);
+            offset += group.numWords;
+        }
+        this->tailOffset = offset;
+        this->numWords = offset + (numTailTransactions + 63) / 64;
+        this->tailWeights.resize(numTailTransactions);
+
+        // Set the bits of the items of each transaction.
+        this->itemTidsets.fill(0, itemIDs.size() * this->numWords);
+        quint64 * tidsets = this->itemTidsets.data();
+        int numTailBits = 0;
+        int bit, index;
+        for (int t = 0; t < transactions.size(); t++) {
+            if (!containsFrequentItems[t])
+                continue;
+
+            const WeightedTransaction & transaction = transactions[t];
+            if (nextGroupBit.contains(transaction.weight))
+                bit = nextGroupBit[transaction.weight]++;
+            else {
+                this->tailWeights[numTailBits] = transaction.weight;
+                bit = 64 * this->tailOffset + numTailBits++;
+            }
+
+            foreach (ItemID itemID, transaction.itemIDs) {
+                index = this->itemIndices.value(itemID, -1);
+                if (index != -1)
+                    tidsets[index * this->numWords + bit / 64] |= Q_UINT64_C(1) << (bit % 64);
+            }
+        }
+
+        // The support of an item is the support of its tidset.
+        QVector<quint64> intersection(this->numWords);
+        this->itemSupports.resize(itemIDs.size());
+        for (int i = 0; i < itemIDs.size(); i++) {
+            const quint64 * tidset = tidsets + i * this->numWords;
+            this->itemSupports[i] = this->intersect(tidset, tidset, intersection.data());
+        }
+    }
+
+    Eclat::~Eclat() {
+        qDeleteAll(this->candidates);
+    }
+
+    /**
+     * Mine frequent itemsets, depth-first: each frequent itemset is extended
+     * with each of the preceding items with which it is still frequent.
+     *
+     * @return
+     *   The frequent itemsets that match the constraints: the same ones as
+     *   FP-growth finds, but not necessarily in the same order.
+     */
+    QList<FrequentItemset> Eclat::mineFrequentItemsets() {
+        QList<FrequentItemset> frequentItemsets;
+        QVector<int> items(this->itemIDs.size());
+
+        for (int i = 0; i < items.size(); i++)
+            items[i] = i;
+
+        this->generateFrequentItemsets(FrequentItemset(), items.constData(), this->itemTidsets.constData(), this->itemSupports.constData(), items.size(), frequentItemsets);
+
+        return frequentItemsets;
+    }
+
+    /**
+     * Calculate the support count for an itemset, by intersecting the tidsets
+     * of its items.
+     *
+     * @param itemset
+     *   The itemset to calculate the support count for, in any order.
+     * @return
+     *   The support count for this itemset, or 0 when it contains items
+     *   that are not frequent.
+     */
+    SupportCount Eclat::calculateSupportCount(const ItemIDList & itemset) const {
+        QVector<quint64> intersection(this->numWords);
+        const quint64 * tidset = NULL;
+        SupportCount support = 0;
+        int index;
+
+        foreach (ItemID itemID, itemset) {
+            index = this->itemIndices.value(itemID, -1);
+            if (index == -1)
+                return 0;
+
+            const quint64 * itemTidset = this->itemTidsets.constData() + index * this->numWords;
+            if (tidset == NULL) {
+                tidset = itemTidset;
+                support = this->itemSupports[index];
+            }
+            else {
+                support = this->intersect(tidset, itemTidset, intersection.data());
+                tidset = intersection.constData();
+            }
+        }
+
+        return support;
+    }
+
+
+    //------------------------------------------------------------------------
+    // Protected methods.
+
+    /**
+     * Intersect two tidsets and calculate the support of the intersection.
+     *
+     * @param a
+     *   The first tidset.
+     * @param b
+     *   The second tidset.
+     * @param result
+     *   The intersection of both tidsets. May be identical to a or b.
+     * @return
+     *   The sum of the weights of the transactions in the intersection.
+     */
+    SupportCount Eclat::intersect(const quint64 * a, const quint64 * b, quint64 * result) const {
+        SupportCount support = 0;
+        int numTailWords = this->numWords - this->tailOffset;
+        quint64 word;
+
+        for (int g = 0; g < this->weightGroups.size(); g++) {
+            const WeightGroup & group = this->weightGroups[g];
+            support += group.weight * TidBitset::intersect(a + group.offset, b + group.offset, result + group.offset, group.numWords);
+        }
+
+        if (numTailWords > 0 && TidBitset::intersect(a + this->tailOffset, b + this->tailOffset, result + this->tailOffset, numTailWords) > 0) {
+            for (int i = 0; i < numTailWords; i++) {
+                for (word = result[this->tailOffset + i]; word != 0; word &= word - 1)
+                    support += this->tailWeights[64 * i + TidBitset::lowestBit(word)];
+            }
+        }
+
+        return support;
+    }
+
+    /**
+     * Generate the frequent itemsets recursively.
+     *
+     * @param suffix
+     *   The frequent itemset that is being extended. Empty in the initial
+     *   call.
+     * @param items
+     *   The indices of the candidate items with which the suffix can be
+     *   extended, in FP-tree order.
+     * @param tidsets
+     *   The tidsets of the suffix extended with each candidate item.
+     * @param supports
+     *   The support counts of the suffix extended with each candidate item.
+     * @param numCandidates
+     *   The number of candidate items.
+     * @param frequentItemsets
+     *   The list to which the frequent itemsets are appended.
+     */
+    void Eclat::generateFrequentItemsets(const FrequentItemset & suffix, const int * items, const quint64 * tidsets, const SupportCount * supports, int numCandidates, QList<FrequentItemset> & frequentItemsets) {
+        QHash<ItemID, SupportCount> extensionSupportCounts;
+        int numExtensions;
+        SupportCount support;
+
+        // The candidates for this suffix length are reused for every item:
+        // the previous item's extensions have been mined completely by the
+        // time the next item is extended.
+        int depth = suffix.itemset.size();
+        while (depth >= this->candidates.size())
+            this->candidates.append(new Candidates());
+        Candidates * extensions = this->candidates[depth];
+
+        for (int i = 0; i < numCandidates; i++) {
+            if (supports[i] < this->minSupportAbsolute)
+                continue;
+
+            FrequentItemset frequentItemset(this->itemIDs[items[i]], supports[i], suffix);
+#ifdef DEBUG
+            frequentItemset.IDNameHash = this->itemIDNameHash;
+#endif
+            if (this->constraints.matchItemset(frequentItemset.itemset))
+                frequentItemsets.append(frequentItemset);
+
+            // Extend the frequent itemset with the preceding candidates: the
+            // items in its prefix paths, in FP-growth's terms.
+            if (extensions->items.size() < i) {
+                extensions->items.resize(i);
+                extensions->supports.resize(i);
+                extensions->tidsets.resize(i * this->numWords);
+            }
+            numExtensions = 0;
+            for (int j = 0; j < i; j++) {
+                support = this->intersect(tidsets + j * this->numWords, tidsets + i * this->numWords, extensions->tidsets.data() + numExtensions * this->numWords);
+                if (support < this->minSupportAbsolute)
+                    continue;
+
+                extensions->items[numExtensions] = items[j];
+                extensions->supports[numExtensions] = support;
+                numExtensions++;
+            }
+            if (numExtensions == 0)
+                continue;
+
+            if (!this->constraints.empty()) {
+                extensionSupportCounts.clear();
+                for (int e = 0; e < numExtensions; e++)
+                    extensionSupportCounts.insert(this->itemIDs[extensions->items[e]], extensions->supports[e]);
+                if (!this->constraints.matchSearchSpace(frequentItemset.itemset, extensionSupportCounts))
+                    continue;
+            }
+
+            this->generateFrequentItemsets(frequentItemset, extensions->items.constData(), extensions->tidsets.constData(), extensions->supports.constData(), numExtensions, frequentItemsets);
+        }
+    }
+
+}
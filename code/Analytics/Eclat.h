@@ -0,0 +1,103 @@
+#ifndef ECLAT_H
+#define ECLAT_H
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#include "Item.h"
+#include "Constraints.h"
+#include "TidBitset.h"
+
+
+namespace Analytics {
+
+    // Transactions whose weight is shared by at least this many transactions
+    // get a weight group of their own (see Eclat).
+    #define ECLAT_MIN_WEIGHT_GROUP_SIZE 64
+
+    /**
+     * Mines frequent itemsets from a vertical layout of the weighted
+     * transactions: for each frequent item, the tidset of the transactions
+     * that contain it, as a bitset. The support of an itemset is calculated
+     * by intersecting the tidsets of its items, i.e. without building any
+     * trees.
+     *
+     * Transactions are weighted, so the support of a tidset is not simply
+     * its number of bits. The transactions are therefore grouped by weight:
+     * the support of the bits in a weight group is their count times the
+     * group's weight. Transactions whose weight is rare are stored after all
+     * groups, and their weights are summed bit by bit.
+     *
+     * The items are given in the order in which they occur in the FP-tree,
+     * and an itemset is only extended with items that precede all of its
+     * items in that order, exactly like FP-growth extends a suffix with the
+     * items in its prefix paths. Hence the same frequent itemsets are found
+     * as by FP-growth, with their items in the same order, and the same
+     * constraints can be applied to the same (partial) itemsets.
+     */
+    class Eclat {
+    public:
+        Eclat(const QList<WeightedTransaction> & transactions, const ItemIDList & itemIDs, SupportCount minSupportAbsolute);
+        ~Eclat();
+
+        void setConstraints(const Constraints & constraints) { this->constraints = constraints; }
+
+        QList<FrequentItemset> mineFrequentItemsets();
+        SupportCount calculateSupportCount(const ItemIDList & itemset) const;
+
+        // Stats.
+        int getNumItems() const { return this->itemIDs.size(); }
+        int getNumWords() const { return this->numWords; }
+        int getNumWeightGroups() const { return this->weightGroups.size(); }
+
+#ifdef DEBUG
+        ItemIDNameHash * itemIDNameHash;
+#endif
+
+    protected:
+        struct WeightGroup {
+            int offset;
+            int numWords;
+            SupportCount weight;
+        };
+
+        // The candidate items with which an itemset can be extended: their
+        // indices, and the tidsets and support counts of the itemset
+        // extended with each of them.
+        struct Candidates {
+            QVector<int> items;
+            QVector<quint64> tidsets;
+            QVector<SupportCount> supports;
+        };
+
+        SupportCount intersect(const quint64 * a, const quint64 * b, quint64 * result) const;
+        void generateFrequentItemsets(const FrequentItemset & suffix, const int * items, const quint64 * tidsets, const SupportCount * supports, int numCandidates, QList<FrequentItemset> & frequentItemsets);
+
+        // The frequent items, in FP-tree order, and their tidsets, stored
+        // consecutively.
+        ItemIDList itemIDs;
+        QHash<ItemID, int> itemIndices;
+        QVector<quint64> itemTidsets;
+        QVector<SupportCount> itemSupports;
+        int numWords;
+
+        // The bits of each weight group start at a word boundary. The bits
+        // of the remaining transactions start at tailOffset, each with its
+        // own weight.
+        QVector<WeightGroup> weightGroups;
+        int tailOffset;
+        QVector<SupportCount> tailWeights;
+
+        // The candidates that are reused while mining: one per length of the
+        // itemset that is being extended.
+        QList<Candidates *> candidates;
+
+        Constraints constraints;
+        SupportCount minSupportAbsolute;
+    };
+
+}
+
+#endif // ECLAT_H
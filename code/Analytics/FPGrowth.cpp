@@ -8,10 +8,16 @@ namespace Analytics {
         this->sortedFrequentItemIDs = sortedFrequentItemIDs;
 
         this->transactions = transactions;
+        this->numTransactions = transactions.size();
+        this->transactionWeight = 1;
+        this->miningCore = FPGROWTH_PROJECTED_DATABASES;
+        this->miningEngine = MINING_ENGINE_FPGROWTH;
+        this->eclat = NULL;
+        this->numThreads = qMax(1, QThread::idealThreadCount());
 
         this->minSupportAbsolute = minSupportAbsolute;
 
-        this->tree = new FPTree();
+        this->tree = new FPTree(&this->arenaPool);
 #ifdef DEBUG
         this->tree->itemIDNameHash = this->itemIDNameHash;
 #endif
@@ -19,6 +25,9 @@ namespace Analytics {
 
     FPGrowth::~FPGrowth() {
         delete this->tree;
+        delete this->eclat;
+        for (int i = 0; i < this->projectedDatabases.size(); i++)
+            qDeleteAll(this->projectedDatabases[i]);
     }
 
     /**
@@ -27,13 +36,37 @@ namespace Analytics {
      *
      * @param asynchronous
      *   See the explanation for the identically named parameter of @fn
-     *   generateFrequentItemsets().
+     *   generateFrequentItemsets(). When mining synchronously, the mining
+     *   core that was set with setMiningCore() is used, and mining with
+     *   FPGROWTH_PROJECTED_DATABASES runs on setNumThreads() threads (by
+     *   default as many as there are cores). Synchronous mining uses the
+     *   engine that was set with setMiningEngine(); asynchronous mining
+     *   always uses FP-growth.
      * @return
      *   The frequent itemsets that were found.
      */
     QList<FrequentItemset> FPGrowth::mineFrequentItemsets(bool asynchronous) {
+        if (!asynchronous && this->miningEngine == MINING_ENGINE_FASTEST)
+            this->miningEngine = this->selectFastestMiningEngine();
+
         this->scanTransactions();
+
+        if (!asynchronous && this->miningEngine == MINING_ENGINE_ECLAT) {
+            // Eclat extends itemsets in the same order as FP-growth, hence
+            // it needs the order of the items in the FP-tree.
+            this->eclat = new Eclat(this->weightedTransactions, this->optimizeItemset(this->totalFrequentSupportCounts.keys()), this->minSupportAbsolute);
+#ifdef DEBUG
+            this->eclat->itemIDNameHash = this->itemIDNameHash;
+#endif
+            this->eclat->setConstraints(this->constraints);
+            return this->eclat->mineFrequentItemsets();
+        }
+
         this->buildFPTree();
+
+        if (!asynchronous && this->miningCore == FPGROWTH_PROJECTED_DATABASES)
+            return this->generateFrequentItemsetsFromProjections();
+
         return this->generateFrequentItemsets(this->tree, FrequentItemset(), asynchronous);
     }
 
@@ -51,9 +84,14 @@ namespace Analytics {
         // data we need (this is FPGrowth::totalFrequentSupportCounts).
         // For larger itemsets, we'll have to get the exact support count by
         // examining the FP-tree.
+        // When mining with Eclat, there is no FP-tree, but the tidsets of
+        // the items can be intersected instead.
         if (itemset.size() == 1) {
             return this->totalFrequentSupportCounts[itemset[0]];
         }
+        else if (this->eclat != NULL) {
+            return this->eclat->calculateSupportCount(itemset);
+        }
         else {
             // First optimize the itemset so that the item with the least
             // support is the last item.
@@ -83,7 +121,7 @@ namespace Analytics {
                 // Note that it is impossible to end with zero prefix paths
                 // after filtering, since the itemset that is passed to this
                 // function consists of frequent items.
-                cfptree = new FPTree();
+                cfptree = new FPTree(&this->arenaPool);
 #ifdef DEBUG
                 cfptree->itemIDNameHash = this->itemIDNameHash;
 #endif
@@ -93,11 +131,26 @@ namespace Analytics {
             // The conditional FP-tree for the second item in the itemset
             // contains the support count for the itemset that was passed into
             // this function.
-            return cfptree->getItemSupport(itemset[0]);
+            SupportCount supportCount = cfptree->getItemSupport(itemset[0]);
+            delete cfptree;
+            return supportCount;
         }
     }
 
 
+    /**
+     * @return
+     *   The fraction of the transactions that was collapsed into weighted
+     *   transactions by scanTransactions(): 0 if all transactions are
+     *   distinct, close to 1 if nearly all of them are identical.
+     */
+    double FPGrowth::getTransactionReductionRatio() const {
+        if (this->numTransactions == 0)
+            return 0.0;
+        return 1.0 - ((double) this->weightedTransactions.size()) / this->numTransactions;
+    }
+
+
     //------------------------------------------------------------------------------
     // Protected slots.
 
@@ -201,6 +254,23 @@ namespace Analytics {
         return filteredPrefixPaths;
     }
 
+    /**
+     * Hash a list of item IDs, using 32-bit FNV-1a.
+     *
+     * @param itemIDs
+     *   A list of item IDs.
+     * @return
+     *   The hash of the item IDs, which depends on their order.
+     */
+    uint FPGrowth::hashItemIDs(const ItemIDList & itemIDs) {
+        uint hash = 2166136261u;
+
+        foreach (ItemID itemID, itemIDs)
+            hash = (hash ^ itemID) * 16777619u;
+
+        return hash;
+    }
+
 
     //------------------------------------------------------------------------
     // Protected methods.
@@ -213,6 +283,9 @@ namespace Analytics {
      *    with step 1)
      * 3) discard infrequent items' support count
      * 4) sort the frequent items by decreasing support count
+     * 5) collapse identical transactions into a single weighted transaction
+     *    (happens simultaneously with step 1), which buildFPTree() adds to
+     *    the FP-tree at once
      *
      * Also, each time when a new item name is mapped to an item id, it is
      * processed for use in constraints as well.
@@ -231,7 +304,10 @@ namespace Analytics {
         // Map the item names to item IDs. Maintain two dictionaries: one for
         // each look-up direction (name -> id and id -> name).
         ItemID itemID;
+        ItemIDList itemIDs;
+        QMultiHash<uint, int> distinctTransactions;
         foreach (QStringList transaction, this->transactions) {
+            itemIDs.clear();
             foreach (QString itemName, transaction) {
                 // Look up the itemID for this itemName, or create it.
                 if (!this->itemNameIDHash->contains(itemName)) {
@@ -247,10 +323,18 @@ namespace Analytics {
                 else
                     itemID = this->itemNameIDHash->value(itemName);
 
-                this->totalFrequentSupportCounts[itemID]++;
+                this->totalFrequentSupportCounts[itemID] += this->transactionWeight;
+                itemIDs.append(itemID);
             }
+
+            this->addWeightedTransaction(itemIDs, distinctTransactions);
         }
 
+        // Only the weighted transactions are used from here on.
+        this->numTransactions = this->transactions.size();
+        this->transactions.clear();
+        emit scannedTransactions(this->numTransactions, this->weightedTransactions.size());
+
         // Discard infrequent items' SupportCount.
         foreach (itemID, this->totalFrequentSupportCounts.keys()) {
             if (this->totalFrequentSupportCounts[itemID] < this->minSupportAbsolute) {
@@ -276,7 +360,41 @@ namespace Analytics {
     }
 
     /**
-     * Build the FP-tree, by using the results from scanTransactions().
+     * Add a transaction to the weighted transactions: if an identical
+     * transaction has been added before, its weight is incremented by the
+     * transaction weight.
+     * Transactions are identical if they consist of the same items, in any
+     * order, since each transaction is ordered by optimizeTransaction()
+     * anyway.
+     *
+     * @param itemIDs
+     *   The item IDs of a transaction. They are sorted.
+     * @param distinctTransactions
+     *   The indices of the weighted transactions, by hash.
+     */
+    void FPGrowth::addWeightedTransaction(ItemIDList & itemIDs, QMultiHash<uint, int> & distinctTransactions) {
+        uint hash;
+
+        qSort(itemIDs);
+        hash = FPGrowth::hashItemIDs(itemIDs);
+
+        QMultiHash<uint, int>::const_iterator it = distinctTransactions.constFind(hash);
+        for (; it != distinctTransactions.constEnd() && it.key() == hash; ++it) {
+            WeightedTransaction & weightedTransaction = this->weightedTransactions[it.value()];
+            if (weightedTransaction.itemIDs == itemIDs) {
+                weightedTransaction.weight += this->transactionWeight;
+                return;
+            }
+        }
+
+        distinctTransactions.insert(hash, this->weightedTransactions.size());
+        this->weightedTransactions.append(WeightedTransaction(itemIDs, this->transactionWeight));
+    }
+
+    /**
+     * Build the FP-tree, by using the results from scanTransactions(): each
+     * weighted transaction is added once, with its weight as the support
+     * count of its items.
      *
      * TODO: figure out if this can be done in one pass with scanTransactions.
      * This should be doable since we can use the generated itemIDs as they
@@ -285,27 +403,86 @@ namespace Analytics {
     void FPGrowth::buildFPTree() {
         Transaction transaction;
 
-        foreach (QStringList transactionAsStrings, this->transactions) {
+        foreach (const WeightedTransaction & weightedTransaction, this->weightedTransactions) {
             transaction.clear();
-            foreach (ItemName name, transactionAsStrings) {
+            foreach (ItemID itemID, weightedTransaction.itemIDs) {
 #ifdef DEBUG
-                transaction << Item((ItemID) this->itemNameIDHash->value(name), this->itemIDNameHash);
+                transaction << Item(itemID, weightedTransaction.weight, this->itemIDNameHash);
 #else
-                transaction << Item((ItemID) this->itemNameIDHash->value(name));
+                transaction << Item(itemID, weightedTransaction.weight);
 #endif
             }
 
-            // The transaction in QStringList form has been converted to
-            // QList<Item> form. Now process the transaction in this form.
+            // The weighted transaction has been converted to QList<Item>
+            // form. Now process the transaction in this form.
             this->processTransaction(transaction);
         }
 
 #ifdef FPGROWTH_DEBUG
-        qDebug() << "Parsed" << this->transactions.size() << "transactions.";
+        qDebug() << "Parsed" << this->numTransactions << "transactions," << this->weightedTransactions.size() << "distinct.";
         qDebug() << *this->tree;
 #endif
     }
 
+    /**
+     * Mine an evenly spread sample of the transactions with each mining
+     * engine, with the same settings and a proportionally lower minimum
+     * support, and time them. A small sample is mined in a few milliseconds
+     * at most, hence it is mined repeatedly until the total time is
+     * meaningful. Must be called before scanTransactions().
+     *
+     * @return
+     *   The mining engine that mined the sample fastest; FP-growth when both
+     *   are equally fast.
+     */
+    MiningEngine FPGrowth::selectFastestMiningEngine() const {
+        QList<QStringList> sample;
+        int step = qMax(1, this->transactions.size() / FPGROWTH_ENGINE_SAMPLE_SIZE);
+        for (int i = 0; i < this->transactions.size() && sample.size() < FPGROWTH_ENGINE_SAMPLE_SIZE; i += step)
+            sample.append(this->transactions[i]);
+        SupportCount minSupportAbsolute = qMax((SupportCount) 1, (SupportCount) ceil((double) this->minSupportAbsolute * sample.size() / qMax(1, this->transactions.size())));
+
+        // The constraints are preprocessed for the item IDs of the sample.
+        Constraints constraints = this->constraints;
+        Constraints constraintsForRuleConsequents = this->constraintsForRuleConsequents;
+        constraints.clearPreprocessedItems();
+        constraintsForRuleConsequents.clearPreprocessedItems();
+
+        MiningEngine engines[2] = { MINING_ENGINE_FPGROWTH, MINING_ENGINE_ECLAT };
+        MiningEngine fastestEngine = MINING_ENGINE_FPGROWTH;
+        double fastestDuration = -1;
+        double duration;
+        qint64 elapsed;
+        int runs;
+        QElapsedTimer timer;
+        for (int e = 0; e < 2; e++) {
+            runs = 0;
+            timer.start();
+            do {
+                ItemIDNameHash itemIDNameHash;
+                ItemNameIDHash itemNameIDHash;
+                ItemIDList sortedFrequentItemIDs;
+                FPGrowth fpgrowth(sample, minSupportAbsolute, &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+                fpgrowth.setConstraints(constraints);
+                fpgrowth.setConstraintsForRuleConsequents(constraintsForRuleConsequents);
+                fpgrowth.setTransactionWeight(this->transactionWeight);
+                fpgrowth.setMiningCore(this->miningCore);
+                fpgrowth.setNumThreads(this->numThreads);
+                fpgrowth.setMiningEngine(engines[e]);
+                fpgrowth.mineFrequentItemsets(FPGROWTH_SYNC);
+                runs++;
+            } while ((elapsed = timer.elapsed()) < FPGROWTH_ENGINE_SAMPLE_MIN_DURATION);
+            duration = (double) elapsed / runs;
+
+            if (fastestDuration == -1 || duration < fastestDuration) {
+                fastestEngine = engines[e];
+                fastestDuration = duration;
+            }
+        }
+
+        return fastestEngine;
+    }
+
     /**
      * Optimize a transaction.
      *
@@ -539,7 +716,7 @@ namespace Analytics {
             // Build the conditional FP-tree for these prefix paths,
             // by creating a new FP-tree and pretending the prefix
             // paths are transactions.
-            FPTree * cfptree = new FPTree();
+            FPTree * cfptree = new FPTree(&this->arenaPool);
 #ifdef DEBUG
             cfptree->itemIDNameHash = this->itemIDNameHash;
 #endif
@@ -553,4 +730,188 @@ namespace Analytics {
         else
             return NULL;
     }
+
+    /**
+     * Generate all frequent itemsets from projected databases, on as many
+     * threads as were set with setNumThreads(). Each item in the FP-tree is
+     * mined in a separate task, which splits off subtasks for large
+     * projected databases. Idle threads steal tasks from busy ones.
+     *
+     * @return
+     *   The frequent itemsets: identical to those of
+     *   generateFrequentItemsets() and in the same order, regardless of the
+     *   number of threads.
+     */
+    QList<FrequentItemset> FPGrowth::generateFrequentItemsetsFromProjections() {
+        QList<FrequentItemset> frequentItemsets;
+        ItemIDList itemIDs = this->tree->getItemIDs();
+
+        if (this->projectedDatabases.size() < this->numThreads)
+            this->projectedDatabases.resize(this->numThreads);
+
+        if (this->numThreads == 1) {
+            FPGrowthTask task(this, NULL, this->tree, false, itemIDs, FrequentItemset());
+            task.run(0);
+            task.collectFrequentItemsets(frequentItemsets);
+        }
+        else {
+            WorkStealingPool pool(this->numThreads);
+            QList<FPGrowthTask *> tasks;
+            for (int i = 0; i < itemIDs.size(); i++) {
+                tasks.append(new FPGrowthTask(this, &pool, this->tree, false, ItemIDList() << itemIDs[i], FrequentItemset()));
+                pool.submit(tasks.last(), i);
+            }
+            pool.run();
+
+            foreach (FPGrowthTask * task, tasks)
+                task->collectFrequentItemsets(frequentItemsets);
+            qDeleteAll(tasks);
+        }
+
+        return frequentItemsets;
+    }
+
+    /**
+     * Generate the frequent itemsets recursively, like the synchronous case
+     * of generateFrequentItemsets(), but from projected databases: the
+     * prefix paths of each frequent item are collected (and their items'
+     * support counts counted) in a single pass over its node-links, into a
+     * reusable projected database. Only a large projected database is turned
+     * into a conditional FP-tree, which is mined in a subtask when mining in
+     * parallel.
+     *
+     * @param ctree
+     *   Initially the entire FP-tree, but in subsequent (recursive) calls,
+     *   a conditional FP-tree, or NULL when cdatabase is given.
+     * @param cdatabase
+     *   A projected database, or NULL when ctree is given.
+     * @param itemIDs
+     *   The items in ctree or cdatabase to generate frequent itemsets for.
+     * @param suffix
+     *   The current frequent itemset suffix. Empty in the initial call, but
+     *   automatically filled by this function when it recurses.
+     * @param task
+     *   The task that is running this method. The frequent itemsets are
+     *   appended to it.
+     */
+    void FPGrowth::generateFrequentItemsetsFromProjection(const FPTree * ctree, const ProjectedDatabase * cdatabase, const ItemIDList & itemIDs, const FrequentItemset & suffix, FPGrowthTask * task) {
+        // The projected database for this suffix length is reused for every
+        // item: the previous item's projection has been mined completely by
+        // the time the next item is projected. Each worker has its own.
+        QList<ProjectedDatabase *> & projectedDatabases = this->projectedDatabases[task->worker];
+        int depth = suffix.itemset.size();
+        while (depth >= projectedDatabases.size())
+            projectedDatabases.append(new ProjectedDatabase());
+        ProjectedDatabase * projection = projectedDatabases[depth];
+
+        foreach (ItemID prefixItemID, itemIDs) {
+            SupportCount prefixItemSupport = (ctree != NULL) ? ctree->getItemSupport(prefixItemID) : cdatabase->getItemSupport(prefixItemID);
+            if (prefixItemSupport < this->minSupportAbsolute)
+                continue;
+
+            FrequentItemset frequentItemset(prefixItemID, prefixItemSupport, suffix);
+#ifdef DEBUG
+            frequentItemset.IDNameHash = this->itemIDNameHash;
+#endif
+            if (this->constraints.matchItemset(frequentItemset.itemset))
+                task->frequentItemsets.append(frequentItemset);
+
+            // Collect the prefix paths of the current frequent itemset, like
+            // considerFrequentItemsupersets() does.
+            if (ctree != NULL)
+                projection->projectTree(ctree, prefixItemID, this->minSupportAbsolute);
+            else
+                projection->projectDatabase(*cdatabase, prefixItemID, this->minSupportAbsolute);
+            if (projection->isEmpty())
+                continue;
+            if (!this->constraints.matchSearchSpace(frequentItemset.itemset, projection->getSupportCounts()))
+                continue;
+
+            if (projection->getNumPaths() >= FPGROWTH_MIN_PATHS_FOR_CONDITIONAL_TREE) {
+                FPTree * cfptree = new FPTree(&this->arenaPool);
+#ifdef DEBUG
+                cfptree->itemIDNameHash = this->itemIDNameHash;
+#endif
+                projection->buildTree(cfptree);
+
+                if (task->pool != NULL) {
+                    // Mine the conditional FP-tree in a subtask, which can be
+                    // stolen by an idle worker. The subtask deletes it.
+                    FPGrowthTask * subtask = new FPGrowthTask(this, task->pool, cfptree, true, cfptree->getItemIDs(), frequentItemset);
+                    task->subtasks.append(qMakePair(task->frequentItemsets.size(), subtask));
+                    task->pool->submit(subtask, task->worker);
+                }
+                else {
+                    this->generateFrequentItemsetsFromProjection(cfptree, NULL, cfptree->getItemIDs(), frequentItemset, task);
+                    delete cfptree;
+                }
+            }
+            else
+                this->generateFrequentItemsetsFromProjection(NULL, projection, projection->getItemIDs(), frequentItemset, task);
+        }
+    }
+
+
+    //------------------------------------------------------------------------
+    // FPGrowthTask.
+
+    /**
+     * @param fpgrowth
+     *   The FPGrowth instance that is mining.
+     * @param pool
+     *   The pool to submit subtasks to, or NULL to mine without subtasks.
+     * @param ctree
+     *   The (conditional) FP-tree to mine.
+     * @param ownsTree
+     *   Whether this task should delete ctree once it has been mined.
+     * @param itemIDs
+     *   The items in ctree to mine.
+     * @param suffix
+     *   The frequent itemset suffix for ctree.
+     */
+    FPGrowthTask::FPGrowthTask(FPGrowth * fpgrowth, WorkStealingPool * pool, const FPTree * ctree, bool ownsTree, const ItemIDList & itemIDs, const FrequentItemset & suffix) {
+        this->fpgrowth = fpgrowth;
+        this->pool     = pool;
+        this->ctree    = ctree;
+        this->ownsTree = ownsTree;
+        this->itemIDs  = itemIDs;
+        this->suffix   = suffix;
+        this->worker   = 0;
+    }
+
+    FPGrowthTask::~FPGrowthTask() {
+        for (int i = 0; i < this->subtasks.size(); i++)
+            delete this->subtasks[i].second;
+    }
+
+    void FPGrowthTask::run(int worker) {
+        this->worker = worker;
+        this->fpgrowth->generateFrequentItemsetsFromProjection(this->ctree, NULL, this->itemIDs, this->suffix, this);
+
+        if (this->ownsTree) {
+            delete this->ctree;
+            this->ctree = NULL;
+        }
+    }
+
+    /**
+     * Append the frequent itemsets that were found by this task and its
+     * subtasks, in the order in which sequential mining would find them:
+     * the frequent itemsets of each subtask are inserted where this task
+     * submitted the subtask.
+     *
+     * @param frequentItemsets
+     *   The list to which the frequent itemsets are appended.
+     */
+    void FPGrowthTask::collectFrequentItemsets(QList<FrequentItemset> & frequentItemsets) const {
+        int next = 0;
+
+        for (int i = 0; i < this->subtasks.size(); i++) {
+            for (; next < this->subtasks[i].first; next++)
+                frequentItemsets.append(this->frequentItemsets[next]);
+            this->subtasks[i].second->collectFrequentItemsets(frequentItemsets);
+        }
+        for (; next < this->frequentItemsets.size(); next++)
+            frequentItemsets.append(this->frequentItemsets[next]);
+    }
 }
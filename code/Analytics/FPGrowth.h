@@ -7,12 +7,20 @@
 #include <QString>
 #include <QStringList>
 #include <QRegExp>
+#include <QPair>
+#include <QThread>
+#include <QTime>
+#include <QElapsedTimer>
 #include <math.h>
 
 #include "Item.h"
 #include "Constraints.h"
 #include "FPNode.h"
 #include "FPTree.h"
+#include "NodeArena.h"
+#include "ProjectedDatabase.h"
+#include "WorkStealingPool.h"
+#include "Eclat.h"
 
 
 namespace Analytics {
@@ -24,6 +32,76 @@ namespace Analytics {
 #define FPGROWTH_ASYNC true
 #define FPGROWTH_SYNC false
 
+// Projected databases with at least this many paths are turned into a
+// conditional FP-tree before they are mined further: the tree merges the
+// common prefixes of the paths, which then no longer need to be scanned for
+// each item.
+#define FPGROWTH_MIN_PATHS_FOR_CONDITIONAL_TREE 512
+
+    // The way in which synchronous mining generates the frequent itemsets.
+    // Both yield exactly the same frequent itemsets, in the same order.
+    enum FPGrowthMiningCore {
+        // A conditional FP-tree for every frequent itemset.
+        FPGROWTH_CONDITIONAL_TREES,
+        // A projected database for every frequent itemset, which is only
+        // turned into a conditional FP-tree when it is large.
+        FPGROWTH_PROJECTED_DATABASES
+    };
+
+// MINING_ENGINE_FASTEST mines a sample of at most this many transactions of
+// the batch with each engine, repeatedly, until at least this many
+// milliseconds have passed.
+#define FPGROWTH_ENGINE_SAMPLE_SIZE 2000
+#define FPGROWTH_ENGINE_SAMPLE_MIN_DURATION 50
+
+    // The engine with which synchronous mining generates the frequent
+    // itemsets. Both yield exactly the same frequent itemsets, but not
+    // necessarily in the same order.
+    enum MiningEngine {
+        // FP-growth, with the mining core that was set with setMiningCore().
+        MINING_ENGINE_FPGROWTH,
+        // Eclat: intersections of the items' tidsets, on a single thread.
+        MINING_ENGINE_ECLAT,
+        // Whichever of the above mines a sample of the batch faster.
+        MINING_ENGINE_FASTEST
+    };
+
+    class FPGrowth;
+
+    /**
+     * A task of parallel synchronous mining: generating the frequent itemsets
+     * that start with the given items of a (conditional) FP-tree. Large
+     * projected databases that are found along the way are mined in subtasks.
+     * collectFrequentItemsets() merges the frequent itemsets of a task and
+     * its subtasks in the order in which sequential mining finds them.
+     */
+    class FPGrowthTask : public WorkStealingTask {
+    public:
+        FPGrowthTask(FPGrowth * fpgrowth, WorkStealingPool * pool, const FPTree * ctree, bool ownsTree, const ItemIDList & itemIDs, const FrequentItemset & suffix);
+        ~FPGrowthTask();
+
+        void run(int worker);
+        void collectFrequentItemsets(QList<FrequentItemset> & frequentItemsets) const;
+
+    protected:
+        friend class FPGrowth;
+
+        FPGrowth * fpgrowth;
+        // NULL when mining on a single thread: then there are no subtasks.
+        WorkStealingPool * pool;
+        const FPTree * ctree;
+        bool ownsTree;
+        ItemIDList itemIDs;
+        FrequentItemset suffix;
+        int worker;
+
+        // The frequent itemsets found by this task itself, and its subtasks,
+        // each with the number of frequent itemsets that this task had found
+        // when it submitted the subtask.
+        QList<FrequentItemset> frequentItemsets;
+        QList<QPair<int, FPGrowthTask *> > subtasks;
+    };
+
     class FPGrowth : public QObject {
         Q_OBJECT
 
@@ -33,6 +111,12 @@ namespace Analytics {
 
         void setConstraints(const Constraints & constraints) { this->constraints = constraints; }
         void setConstraintsForRuleConsequents(const Constraints & constraints) { this->constraintsForRuleConsequents = constraints; }
+        void setTransactionWeight(SupportCount weight) { this->transactionWeight = weight; }
+        void setMiningCore(FPGrowthMiningCore miningCore) { this->miningCore = miningCore; }
+        void setNumThreads(int numThreads) { this->numThreads = qMax(1, numThreads); }
+        void setMiningEngine(MiningEngine miningEngine) { this->miningEngine = miningEngine; }
+        MiningEngine getMiningEngine() const { return this->miningEngine; }
+        SupportCount getTransactionWeight() const { return this->transactionWeight; }
         const Constraints & getConstraintsForRuleConsequents() const { return this->constraintsForRuleConsequents; }
 
         QList<FrequentItemset> mineFrequentItemsets(bool asynchronous = true);
@@ -42,6 +126,11 @@ namespace Analytics {
         SupportCount calculateSupportCount(const ItemIDList & itemset) const;
 
         ItemID getItemID(ItemName name) const { return this->itemNameIDHash->value(name); }
+
+        // Stats on the deduplication of transactions.
+        int getNumTransactions() const { return this->numTransactions; }
+        int getNumDistinctTransactions() const { return this->weightedTransactions.size(); }
+        double getTransactionReductionRatio() const;
 #ifdef DEBUG
         ItemIDNameHash * getItemIDNameHash() { return this->itemIDNameHash; }
 #endif
@@ -49,6 +138,7 @@ namespace Analytics {
     signals:
         void minedFrequentItemset(const FrequentItemset & frequentItemset, bool frequentItemsetMatchesConstraints, const FPTree * ctree);
         void branchCompleted(const ItemIDList & itemset);
+        void scannedTransactions(int numTransactions, int numDistinctTransactions);
 
     public slots:
         QList<FrequentItemset> generateFrequentItemsets(const FPTree * tree, const FrequentItemset & suffix, bool asynchronous = FPGROWTH_ASYNC);
@@ -57,20 +147,40 @@ namespace Analytics {
         void processTransaction(const Transaction & transaction);
 
     protected:
+        friend class FPGrowthTask;
+
         // Static methods.
         static ItemIDList sortItemIDsByDecreasingSupportCount(const QHash<ItemID, SupportCount> & itemSupportCounts, const ItemIDList * const ignoreList);
         static QList<ItemList> filterPrefixPaths(const QList<ItemList> & prefixPaths, SupportCount minSupportAbsolute);
+        static uint hashItemIDs(const ItemIDList & itemIDs);
 
         // Methods.
         void scanTransactions();
+        void addWeightedTransaction(ItemIDList & itemIDs, QMultiHash<uint, int> & distinctTransactions);
         void buildFPTree();
+        MiningEngine selectFastestMiningEngine() const;
         FPTree * considerFrequentItemsupersets(const FPTree * ctree, const ItemIDList & frequentItemset);
+        QList<FrequentItemset> generateFrequentItemsetsFromProjections();
+        void generateFrequentItemsetsFromProjection(const FPTree * ctree, const ProjectedDatabase * cdatabase, const ItemIDList & itemIDs, const FrequentItemset & suffix, FPGrowthTask * task);
         Transaction optimizeTransaction(const Transaction & transaction) const;
         ItemIDList optimizeItemset(const ItemIDList & itemset) const;
         ItemIDList orderItemsetBySupport(const ItemIDList & itemset) const;
 
         // Properties.
         FPTree * tree;
+        // Arenas for the nodes of the FP-tree and of the conditional FP-trees
+        // that are built while mining: a conditional FP-tree reuses the
+        // arena of a conditional FP-tree that has already been deleted.
+        mutable NodeArenaPool arenaPool;
+        // The projected databases that are reused while mining with
+        // FPGROWTH_PROJECTED_DATABASES: one per length of the suffix, for
+        // each worker thread.
+        QVector<QList<ProjectedDatabase *> > projectedDatabases;
+        FPGrowthMiningCore miningCore;
+        MiningEngine miningEngine;
+        // Only when mining with MINING_ENGINE_ECLAT.
+        Eclat * eclat;
+        int numThreads;
         Constraints constraints;
         Constraints constraintsForRuleConsequents;
         ItemIDNameHash * itemIDNameHash;
@@ -78,6 +188,12 @@ namespace Analytics {
         ItemIDList     * sortedFrequentItemIDs;
 
         QList<QStringList> transactions;
+        // The distinct transactions, in order of first occurrence.
+        QList<WeightedTransaction> weightedTransactions;
+        int numTransactions;
+        // The number of times each transaction counts, e.g. when only a
+        // sample of the transactions is mined.
+        SupportCount transactionWeight;
 
         SupportCount minSupportAbsolute;
 
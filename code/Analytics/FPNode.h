@@ -2,70 +2,137 @@
 #define FPNODE_H
 
 #include <QHash>
+#include <QAtomicInt>
 #include <QMetaType>
 #include <QString>
+#include <new>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "Item.h"
+#include "NodeArena.h"
 
 
 namespace Analytics {
 
+    // Children are searched 4 at a time with SSE2 when it is available.
+    #ifdef __SSE2__
+    #define FPNODE_SSE2 1
+    #endif
+
+    // Number of children that is stored inside the node itself (a power of
+    // two, stored as its base 2 logarithm as well).
+    #define FPNODE_INLINE_CHILDREN 1
+    #define FPNODE_INLINE_CHILDREN_LOG2 0
+    // Nodes with more children than this also get a hash index of their
+    // children (the child capacity is always a power of two).
+    #define FPNODE_MAX_SORTED_CHILDREN 64
+    // The sorted children are narrowed down with binary search to this many
+    // and then scanned linearly.
+    #define FPNODE_LINEAR_SEARCH_SIZE 16
+
     template <class T>
     class FPNode {
     public:
         FPNode(ItemID itemID, SupportCount count) {
             this->itemID = itemID;
             this->value  = count;
-            this->parent = NULL;
-
-#ifdef DEBUG
-            this->nodeID = FPNode<T>::nextNodeID();
-#endif
+            this->init();
         }
         FPNode(ItemID itemID) {
             this->itemID = itemID;
-            this->parent = NULL;
-
-#ifdef DEBUG
-            this->nodeID = FPNode<T>::nextNodeID();
-#endif
+            this->init();
         }
         ~FPNode() {
+            // Nodes that live in an arena are released along with the arena.
+            if (this->inArena)
+                return;
+
             // Delete all child nodes.
-            foreach (FPNode<T> * child, this->children) {
-                delete child;
+            FPNode<T> ** nodes = this->getChildNodes();
+            for (unsigned int i = 0; i < this->numChildNodes; i++) {
+                nodes[i]->parent = NULL;
+                delete nodes[i];
             }
-            this->children.clear();
+            this->freeChildStorage();
 
             // Remove this node from its parent's children.
             if (this->parent != NULL)
-                this->parent->children.remove(this->itemID);
+                this->parent->removeChild(this->itemID);
+        }
+
+        /**
+         * Create a node in an arena. The node and its child storage are
+         * released when the arena is reset; the node itself must never be
+         * deleted. Hence T must not need its destructor to be called.
+         * The arena must also be passed to setParent() (or addChild()) when
+         * adding children to the node.
+         */
+        static FPNode<T> * create(NodeArena * arena, ItemID itemID, SupportCount count) {
+            FPNode<T> * node = new (arena->allocate(sizeof(FPNode<T>))) FPNode<T>(itemID, count);
+            node->inArena = true;
+            return node;
         }
 
         // Accessors.
         bool isRoot() const { return this->itemID == ROOT_ITEMID; }
-        bool isLeaf() const { return this->children.size() == 0; }
+        bool isLeaf() const { return this->numChildNodes == 0; }
         ItemID getItemID() const { return this->itemID; }
         const T & getValue() const { return this->value; }
         T * getPointerToValue() { return &this->value; }
         FPNode<T> * getParent() const { return this->parent; }
         FPNode<T> * getChild(ItemID itemID) const {
-            if (this->children.contains(itemID))
-                return this->children.value(itemID);
-            else
+            if (this->getChildCapacity() <= FPNODE_INLINE_CHILDREN) {
+                for (unsigned int i = 0; i < this->numChildNodes; i++) {
+                    if (this->children.inlined[i]->itemID == itemID)
+                        return this->children.inlined[i];
+                }
+                return NULL;
+            }
+            else if (this->getChildCapacity() > FPNODE_MAX_SORTED_CHILDREN)
+                return this->findIndexedChild(itemID);
+            else {
+                unsigned int i = this->findChild(itemID);
+                if (i < this->numChildNodes && this->getChildIDs()[i] == itemID)
+                    return this->children.external[i];
                 return NULL;
+            }
+        }
+        FPNode<T> * getChildAt(unsigned int i) const { return this->getChildNodes()[i]; }
+        QList<FPNode<T> *> getChildren() const {
+            QList<FPNode<T> *> children;
+            FPNode<T> ** nodes = this->getChildNodes();
+            for (unsigned int i = 0; i < this->numChildNodes; i++)
+                children.append(nodes[i]);
+            return children;
         }
-        const QHash<ItemID, FPNode<T> *> & getChildren() const { return this->children; }
-        bool hasChild(ItemID itemID) const { return this->children.contains(itemID); }
-        unsigned int numChildren() const { return this->children.size(); }
+        bool hasChild(ItemID itemID) const { return this->getChild(itemID) != NULL; }
+        unsigned int numChildren() const { return this->numChildNodes; }
         unsigned int getNumDescendants() const {
-            unsigned int n = this->children.size();
-            if (n > 0) {
-                foreach (FPNode<T> * child, this->children.values())
-                    n += child->getNumDescendants();
-            }
+            unsigned int n = this->numChildNodes;
+            FPNode<T> ** nodes = this->getChildNodes();
+            for (unsigned int i = 0; i < this->numChildNodes; i++)
+                n += nodes[i]->getNumDescendants();
             return n;
         }
+        /**
+         * @return
+         *   The number of bytes used by this node and its descendants,
+         *   including their child storage (but not including memory that is
+         *   allocated by T itself).
+         */
+        quint64 getMemoryUsage() const {
+            quint64 bytes = sizeof(FPNode<T>);
+            if (this->getChildCapacity() > FPNODE_INLINE_CHILDREN)
+                bytes += FPNode<T>::childStorageSize(this->getChildCapacity());
+
+            FPNode<T> ** nodes = this->getChildNodes();
+            for (unsigned int i = 0; i < this->numChildNodes; i++)
+                bytes += nodes[i]->getMemoryUsage();
+            return bytes;
+        }
         T * findNodeByPattern(const ItemIDList & pattern) const {
             // This method only works from the root node.
             if (this->itemID != ROOT_ITEMID) {
@@ -75,9 +142,8 @@ namespace Analytics {
 
             FPNode<T> * node = const_cast<FPNode<T> *>(this);
             foreach (ItemID itemID, pattern) {
-                if (node->hasChild(itemID))
-                    node = node->getChild(itemID);
-                else
+                node = node->getChild(itemID);
+                if (node == NULL)
                     return NULL;
             }
 
@@ -85,14 +151,60 @@ namespace Analytics {
         }
 
         // Modifiers.
-        void addChild(FPNode<T> * child) { this->children.insert(child->getItemID(), child); }
-        void setParent(FPNode<T> * parent) {
+        void addChild(FPNode<T> * child, NodeArena * arena = NULL) {
+            ItemID childItemID = child->getItemID();
+            unsigned int i = this->findChild(childItemID);
+            FPNode<T> ** nodes;
+            ItemID * ids;
+
+            // Replace an existing child with the same ItemID.
+            if (i < this->numChildNodes && this->getChildItemID(i) == childItemID) {
+                this->getChildNodes()[i] = child;
+                if (this->getChildCapacity() > FPNODE_MAX_SORTED_CHILDREN)
+                    this->indexChild(child);
+                return;
+            }
+
+            if (this->numChildNodes == this->getChildCapacity())
+                this->growChildren(arena);
+            nodes = this->getChildNodes();
+            memmove(nodes + i + 1, nodes + i, (this->numChildNodes - i) * sizeof(FPNode<T> *));
+            nodes[i] = child;
+            if (this->getChildCapacity() > FPNODE_INLINE_CHILDREN) {
+                ids = this->getChildIDs();
+                memmove(ids + i + 1, ids + i, (this->numChildNodes - i) * sizeof(ItemID));
+                ids[i] = childItemID;
+            }
+            this->numChildNodes++;
+
+            if (this->getChildCapacity() > FPNODE_MAX_SORTED_CHILDREN)
+                this->indexChild(child);
+        }
+        void removeChild(ItemID itemID) {
+            unsigned int i = this->findChild(itemID);
+            FPNode<T> ** nodes;
+            ItemID * ids;
+            if (i == this->numChildNodes || this->getChildItemID(i) != itemID)
+                return;
+
+            this->numChildNodes--;
+            nodes = this->getChildNodes();
+            memmove(nodes + i, nodes + i + 1, (this->numChildNodes - i) * sizeof(FPNode<T> *));
+            if (this->getChildCapacity() > FPNODE_INLINE_CHILDREN) {
+                ids = this->getChildIDs();
+                memmove(ids + i, ids + i + 1, (this->numChildNodes - i) * sizeof(ItemID));
+            }
+
+            if (this->getChildCapacity() > FPNODE_MAX_SORTED_CHILDREN)
+                this->buildIndex();
+        }
+        void setParent(FPNode<T> * parent, NodeArena * arena = NULL) {
             this->parent = parent;
 
             // Also let the parent know it has a new child, when it is a valid
             // parent.
             if (this->parent != NULL)
-                this->parent->addChild(this);
+                this->parent->addChild(this, arena);
 
         }
         /**
@@ -110,22 +222,196 @@ namespace Analytics {
 #endif
 
     protected:
+        void init() {
+            this->parent = NULL;
+            this->numChildNodes = 0;
+            this->childCapacityLog2 = FPNODE_INLINE_CHILDREN_LOG2;
+            this->inArena = false;
+
+#ifdef DEBUG
+            this->nodeID = FPNode<T>::nextNodeID();
+#endif
+        }
+
+        /**
+         * Up to FPNODE_INLINE_CHILDREN children are stored in the node
+         * itself, which suffices for the vast majority of nodes; their
+         * ItemIDs are read from the children themselves. More children are
+         * stored in a single separate allocation (from the arena if this
+         * node lives in one): the child pointers, followed by their ItemIDs.
+         * For nodes with more than FPNODE_MAX_SORTED_CHILDREN children, the
+         * child pointers are followed by a hash index of them, with twice as
+         * many slots.
+         */
+        static size_t childStorageSize(unsigned int capacity) {
+            size_t size = capacity * (sizeof(FPNode<T> *) + sizeof(ItemID));
+            if (capacity > FPNODE_MAX_SORTED_CHILDREN)
+                size += 2 * capacity * sizeof(FPNode<T> *);
+            return size;
+        }
+        unsigned int getChildCapacity() const { return 1U << this->childCapacityLog2; }
+        FPNode<T> ** getChildNodes() const {
+            if (this->getChildCapacity() <= FPNODE_INLINE_CHILDREN)
+                return const_cast<FPNode<T> **>(this->children.inlined);
+            return this->children.external;
+        }
+        ItemID * getChildIDs() const {
+            unsigned int capacity = this->getChildCapacity();
+            return (ItemID *) (this->children.external + ((capacity > FPNODE_MAX_SORTED_CHILDREN) ? 3 * capacity : capacity));
+        }
+        ItemID getChildItemID(unsigned int i) const {
+            if (this->getChildCapacity() <= FPNODE_INLINE_CHILDREN)
+                return this->children.inlined[i]->itemID;
+            return this->getChildIDs()[i];
+        }
+
+        /**
+         * Search for a child in the children, which are sorted by ItemID:
+         * binary search narrows the range down, in which the children with a
+         * smaller ItemID are then counted. Both steps are branchless, since
+         * the branches would be unpredictable.
+         *
+         * @return
+         *   The index of the child with the given ItemID, or the index at
+         *   which it should be inserted.
+         */
+        unsigned int findChild(ItemID itemID) const {
+            unsigned int low = 0, n = this->numChildNodes, i, end;
+
+            if (this->getChildCapacity() <= FPNODE_INLINE_CHILDREN) {
+                while (low < n && this->children.inlined[low]->itemID < itemID)
+                    low++;
+                return low;
+            }
+
+            const ItemID * ids = this->getChildIDs();
+            while (n > FPNODE_LINEAR_SEARCH_SIZE) {
+                low = (ids[low + n / 2] < itemID) ? low + n / 2 : low;
+                n -= n / 2;
+            }
+
+            i = low;
+            end = low + n;
+#ifdef FPNODE_SSE2
+            // SSE2 only has signed comparisons: flip the sign bits to compare
+            // unsigned ItemIDs. Because the ItemIDs are sorted, the ones that
+            // are smaller than the searched ItemID form the low bits of the
+            // mask.
+            const __m128i signBit = _mm_set1_epi32((int) 0x80000000);
+            const __m128i key = _mm_xor_si128(_mm_set1_epi32(itemID), signBit);
+            __m128i block;
+            for (; i + 4 <= end; i += 4) {
+                block = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (ids + i)), signBit);
+                low += __builtin_ctz(~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(block, key))));
+            }
+#endif
+            for (; i < end; i++)
+                low += (ids[i] < itemID);
+            return low;
+        }
+
+        /**
+         * Double the child storage. In an arena, the old storage is simply
+         * abandoned.
+         */
+        void growChildren(NodeArena * arena) {
+            unsigned int capacity = this->getChildCapacity() * 2;
+            FPNode<T> ** nodes = (FPNode<T> **) this->allocateChildStorage(FPNode<T>::childStorageSize(capacity), arena);
+            ItemID * ids = (ItemID *) (nodes + ((capacity > FPNODE_MAX_SORTED_CHILDREN) ? 3 * capacity : capacity));
+
+            memcpy(nodes, this->getChildNodes(), this->numChildNodes * sizeof(FPNode<T> *));
+            for (unsigned int i = 0; i < this->numChildNodes; i++)
+                ids[i] = this->getChildItemID(i);
+            this->freeChildStorage();
+
+            this->children.external = nodes;
+            this->childCapacityLog2++;
+
+            if (this->getChildCapacity() > FPNODE_MAX_SORTED_CHILDREN)
+                this->buildIndex();
+        }
+
+        void * allocateChildStorage(size_t size, NodeArena * arena) {
+            if (this->inArena) {
+                Q_ASSERT(arena != NULL);
+                return arena->allocate(size);
+            }
+            return qMalloc(size);
+        }
+
+        void freeChildStorage() {
+            if (!this->inArena && this->getChildCapacity() > FPNODE_INLINE_CHILDREN)
+                qFree(this->children.external);
+        }
+
+        /**
+         * The hash index is an open addressing hash table with linear
+         * probing. Unused slots are NULL.
+         */
+        static unsigned int hashItemID(ItemID itemID) {
+            itemID ^= itemID >> 16;
+            itemID *= 0x45d9f3b;
+            itemID ^= itemID >> 16;
+            return itemID;
+        }
+
+        FPNode<T> * findIndexedChild(ItemID itemID) const {
+            unsigned int capacity = this->getChildCapacity();
+            unsigned int mask = 2 * capacity - 1;
+            FPNode<T> ** index = this->children.external + capacity;
+
+            for (unsigned int s = FPNode<T>::hashItemID(itemID) & mask; index[s] != NULL; s = (s + 1) & mask) {
+                if (index[s]->itemID == itemID)
+                    return index[s];
+            }
+            return NULL;
+        }
+
+        void indexChild(FPNode<T> * child) {
+            unsigned int capacity = this->getChildCapacity();
+            unsigned int mask = 2 * capacity - 1;
+            FPNode<T> ** index = this->children.external + capacity;
+
+            unsigned int s = FPNode<T>::hashItemID(child->itemID) & mask;
+            while (index[s] != NULL && index[s]->itemID != child->itemID)
+                s = (s + 1) & mask;
+            index[s] = child;
+        }
+
+        void buildIndex() {
+            unsigned int capacity = this->getChildCapacity();
+            memset(this->children.external + capacity, 0, 2 * capacity * sizeof(FPNode<T> *));
+
+            for (unsigned int i = 0; i < this->numChildNodes; i++)
+                this->indexChild(this->children.external[i]);
+        }
+
         ItemID itemID;
         T value;
+        quint32 numChildNodes;
+        // The child capacity is a power of two.
+        quint8 childCapacityLog2;
+        bool inArena;
         FPNode<T> * parent;
-        QHash<ItemID, FPNode<T> *> children;
+        // Children, sorted by ItemID. See childStorageSize().
+        union {
+            FPNode<T> * inlined[FPNODE_INLINE_CHILDREN];
+            FPNode<T> ** external;
+        } children;
 
 #ifdef DEBUG
         unsigned int nodeID;
-        static unsigned int lastNodeID;
-        static unsigned int nextNodeID() { return FPNode<T>::lastNodeID++; }
+        // Atomic, because FP-trees are built by multiple threads in parallel
+        // mining.
+        static QAtomicInt lastNodeID;
+        static unsigned int nextNodeID() { return FPNode<T>::lastNodeID.fetchAndAddRelaxed(1); }
 #endif
     };
 
 #ifdef DEBUG
     // Initialize static members.
     template <class T>
-    unsigned int FPNode<T>::lastNodeID = 0;
+    QAtomicInt FPNode<T>::lastNodeID = 0;
 
 #endif
 }
@@ -12,6 +12,9 @@ namespace Analytics {
         this->itemNameIDHash        = itemNameIDHash;
         this->f_list                = sortedFrequentItemIDs;
         this->initialBatchProcessed = false;
+        this->miningEngine          = MINING_ENGINE_FPGROWTH;
+        this->batchNumTransactions         = 0;
+        this->batchNumDistinctTransactions = 0;
 
         this->statusMutex.lock();
         this->processingBatch = false;
@@ -48,8 +51,15 @@ namespace Analytics {
      *   The number of transactions per event. Necessary to determine the
      *   correct minimum absolute support when a single event is expanded
      *   into multiple transactions..
+     * @param samplingRate
+     *   The fraction of the batch's events that was sampled, which must be
+     *   1/k for some integer k: each transaction then represents k
+     *   transactions, which keeps the supports unbiased.
      */
-    void FPStream::processBatchTransactions(const QList<QStringList> & transactions, double transactionsPerEvent) {
+    void FPStream::processBatchTransactions(const QList<QStringList> & transactions, double transactionsPerEvent, double samplingRate) {
+        SupportCount transactionWeight = qMax(1, qRound(1.0 / samplingRate));
+        SupportCount numTransactions = transactions.size() * transactionWeight;
+
         this->statusMutex.lock();
         this->processingBatch = true;
         this->currentBatchID++;
@@ -57,20 +67,26 @@ namespace Analytics {
 
         // Store the batch sizes. By storing it in a tilted time window, they
         // will automatically be summed in the same way as any other tilted
-        // time window's support counts.
-        this->transactionsPerBatch.appendQuarter(transactions.size(), this->currentBatchID);
-        this->eventsPerBatch.appendQuarter(transactions.size() / transactionsPerEvent, this->currentBatchID);
+        // time window's support counts. Sampled batches are scaled up to
+        // their estimated full size.
+        this->transactionsPerBatch.appendQuarter(numTransactions, this->currentBatchID);
+        this->eventsPerBatch.appendQuarter(numTransactions / transactionsPerEvent, this->currentBatchID);
 
         // Mine the frequent itemsets in this batch.
-        this->currentFPGrowth = new FPGrowth(transactions, (SupportCount) (this->maxSupportError * transactions.size() / transactionsPerEvent), this->itemIDNameHash, this->itemNameIDHash, this->f_list);
+        this->currentFPGrowth = new FPGrowth(transactions, (SupportCount) (this->maxSupportError * numTransactions / transactionsPerEvent), this->itemIDNameHash, this->itemNameIDHash, this->f_list);
+        this->currentFPGrowth->setTransactionWeight(transactionWeight);
 //        this->currentFPGrowth = new FPGrowth(transactions, (SupportCount) ceil(this->minSupport * transactions.size() / transactionsPerEvent), this->itemIDNameHash, this->itemNameIDHash, this->f_list);
         this->currentFPGrowth->setConstraints(this->constraints);
         this->currentFPGrowth->setConstraintsForRuleConsequents(this->constraintsToPreprocess);
+        this->currentFPGrowth->setMiningEngine(this->miningEngine);
+        connect(this->currentFPGrowth, SIGNAL(scannedTransactions(int,int)), this, SLOT(batchTransactionsScanned(int,int)));
 
         // Initial batch.
         if (!this->initialBatchProcessed) {
             // Calculate frequent itemsets synchronously using FPGrowth.
             QList<FrequentItemset> frequentItemsets = this->currentFPGrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+            // Remember the engine that MINING_ENGINE_FASTEST selected.
+            this->miningEngine = this->currentFPGrowth->getMiningEngine();
             delete this->currentFPGrowth;
 
             // Add all frequent itemsets to the PatternTree.
@@ -285,6 +301,24 @@ namespace Analytics {
     }
 
 
+    //----------------------------------------------------------------------
+    // Protected slots.
+
+    /**
+     * Keep track of how many of the current batch's transactions were
+     * distinct, i.e. how much FPGrowth's deduplication reduced the batch.
+     *
+     * @param numTransactions
+     *   The number of transactions in the batch.
+     * @param numDistinctTransactions
+     *   The number of distinct transactions in the batch.
+     */
+    void FPStream::batchTransactionsScanned(int numTransactions, int numDistinctTransactions) {
+        this->batchNumTransactions         = numTransactions;
+        this->batchNumDistinctTransactions = numDistinctTransactions;
+    }
+
+
     //----------------------------------------------------------------------
     // Protected static methods.
 
@@ -397,8 +431,8 @@ namespace Analytics {
         if (node == NULL)
             return;
 
-        const QHash<ItemID, FPNode<TiltedTimeWindow> *> children = node->getChildren();
-        foreach (const FPNode<TiltedTimeWindow> * child, children.values()) {
+        const QList<FPNode<TiltedTimeWindow> *> children = node->getChildren();
+        foreach (const FPNode<TiltedTimeWindow> * child, children) {
             this->updateUnaffectedNodes(const_cast<FPNode<TiltedTimeWindow> *>(child));
         }
 
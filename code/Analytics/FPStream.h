@@ -35,10 +35,14 @@ namespace Analytics {
         const TiltedTimeWindow * const getEventsPerBatch() const { return &this->eventsPerBatch; }
         void setConstraints(const Constraints & constraints) { this->constraints = constraints; }
         void setConstraintsToPreprocess(const Constraints & constraints) { this->constraintsToPreprocess = constraints; }
+        void setMiningEngine(MiningEngine miningEngine) { this->miningEngine = miningEngine; }
+        MiningEngine getMiningEngine() const { return this->miningEngine; }
 
         // Stats for UI.
         int getNumFrequentItems() const { return this->f_list->size(); }
         int getPatternTreeSize() const { return this->patternTree.getNodeCount(); }
+        int getBatchNumTransactions() const { return this->batchNumTransactions; }
+        int getBatchNumDistinctTransactions() const { return this->batchNumDistinctTransactions; }
         SupportCount getNumEventsInRange(uint from, uint to) const { return this->eventsPerBatch.getSupportForRange(from, to); }
 
         // Unit testing helper method.
@@ -55,12 +59,15 @@ namespace Analytics {
         void batchProcessed();
 
     public slots:
-        void processBatchTransactions(const QList<QStringList> & transactions, double transactionsPerEvent = 1.0);
+        void processBatchTransactions(const QList<QStringList> & transactions, double transactionsPerEvent = 1.0, double samplingRate = 1.0);
         void processFrequentItemset(const FrequentItemset & frequentItemset,
                                     bool frequentItemsetMatchesConstraints,
                                     const FPTree * ctree);
         void branchCompleted(const ItemIDList & itemset);
 
+    protected slots:
+        void batchTransactionsScanned(int numTransactions, int numDistinctTransactions);
+
     protected:
         // Methods.
         void updateUnaffectedNodes(FPNode<TiltedTimeWindow> * node);
@@ -76,6 +83,9 @@ namespace Analytics {
         double maxSupportError;
         Constraints constraints;
         Constraints constraintsToPreprocess;
+        // The engine that mines the initial batch. Later batches are always
+        // mined asynchronously, with FP-growth.
+        MiningEngine miningEngine;
 
         // Properties that are updated in each batch.
         ItemIDNameHash * itemIDNameHash;
@@ -90,6 +100,8 @@ namespace Analytics {
         quint32 currentBatchID;
         FPGrowth * currentFPGrowth;
         QList<ItemIDList> supersetsBeingCalculated;
+        int batchNumTransactions;
+        int batchNumDistinctTransactions;
     };
 
 }
@@ -5,41 +5,53 @@ namespace Analytics {
     //------------------------------------------------------------------------
     // Public methods.
 
-    FPTree::FPTree() {
-        root = new FPNode<SupportCount>(ROOT_ITEMID, 0);
+    /**
+     * @param arenaPool
+     *   When given, the arena for this tree's nodes is acquired from this
+     *   pool, and released to it when this tree is deleted. This allows the
+     *   many short-lived conditional FP-trees to reuse the same memory.
+     */
+    FPTree::FPTree(NodeArenaPool * arenaPool) {
+        this->arenaPool = arenaPool;
+        this->arena = (arenaPool != NULL) ? arenaPool->acquire() : new NodeArena();
+        this->root = FPTreeNode::create(this->arena, ROOT_ITEMID, 0);
     }
 
     FPTree::~FPTree() {
-        delete root;
+        // Release all nodes at once.
+        if (this->arenaPool != NULL)
+            this->arenaPool->release(this->arena);
+        else
+            delete this->arena;
     }
 
     bool FPTree::hasItemPath(ItemID itemID) const {
-        return this->itemPaths.contains(itemID);
+        return this->headerTable.contains(itemID);
     }
 
+    /**
+     * @return
+     *   All nodes for the given item, in the order of their node-links.
+     *   Use getFirstNodeForItem() to walk the node-links without copying.
+     */
     QList<FPNode<SupportCount> *> FPTree::getItemPath(ItemID itemID) const {
-        if (this->itemPaths.contains(itemID))
-            return this->itemPaths[itemID];
-        else {
-            QList<FPNode<SupportCount> *> empty;
-            return empty;
-        }
+        QList<FPNode<SupportCount> *> itemPath;
+        for (FPTreeNode * node = this->getFirstNodeForItem(itemID); node != NULL; node = node->getNextSameItem())
+            itemPath.append(node);
+        return itemPath;
     }
 
     bool FPTree::itemPathContains(ItemID itemID, FPNode<SupportCount> * node) const {
-        return (this->itemPaths.contains(itemID) && this->itemPaths[itemID].contains(node));
-    }
-
-    SupportCount FPTree::getItemSupport(ItemID itemID) const {
-        SupportCount supportCount = 0;
-        foreach (FPNode<SupportCount> * node, this->itemPaths[itemID])
-            supportCount += node->getValue();
-        return supportCount;
+        for (FPTreeNode * n = this->getFirstNodeForItem(itemID); n != NULL; n = n->getNextSameItem()) {
+            if (n == node)
+                return true;
+        }
+        return false;
     }
 
     /**
      * Calculate prefix paths that end with a node that has the given ItemID.
-     * These nodes can be retrieved very quickly using the FPTree's itemPaths.
+     * These nodes can be retrieved very quickly using the FPTree's node-links.
      * A prefix path is a list of Items that reflects a path from the bottom
      * of the tree to the root (but excluding the root), following along the
      * path of an FPNode that has the ItemID itemID. Because it is a list of
@@ -57,8 +69,7 @@ namespace Analytics {
         SupportCount supportCount;
         Item item;
 
-        QList<FPNode<SupportCount> *> leafNodes = this->getItemPath(itemID);
-        foreach (FPNode<SupportCount> * leafNode, leafNodes) {
+        for (FPTreeNode * leafNode = this->getFirstNodeForItem(itemID); leafNode != NULL; leafNode = leafNode->getNextSameItem()) {
             // Build the prefix path starting from the given leaf node, by
             // traversing up the tree (but do not include the leaf node's item
             // in the prefix path).
@@ -98,34 +109,29 @@ namespace Analytics {
 
     void FPTree::addTransaction(const Transaction & transaction) {
         // The initial current node is the root node.
-        FPNode<SupportCount> * currentNode = root;
-        FPNode<SupportCount> * nextNode;
-
-        foreach (Item item, transaction) {
-            if (currentNode->hasChild(item.id)) {
-                // There is already a node in the tree for the current
-                // transaction item, so reuse it: increase its support count.
-                nextNode = currentNode->getChild(item.id);
-                nextNode->addSupportCount(item.supportCount);
-            }
-            else {
-                // Create a new node and add it as a child of the current node.
-                nextNode = new FPNode<SupportCount>(item.id, item.supportCount);
-                nextNode->setParent(currentNode);
+        FPTreeNode * currentNode = root;
 
-                // Update the item path to include the new node.
-                this->addNodeToItemPath(nextNode);
-            }
+        // Each item in the transaction becomes the child of the previous one.
+        foreach (Item item, transaction)
+            currentNode = this->addItem(currentNode, item.id, item.supportCount);
+    }
 
-#ifdef DEBUG
-            nextNode->itemIDNameHash = this->itemIDNameHash;
-#endif
+    /**
+     * Add a path of items to the tree, like a transaction, but given as an
+     * array of ItemIDs that all have the same support count.
+     *
+     * @param itemIDs
+     *   The ItemIDs along the path, starting at the root.
+     * @param numItemIDs
+     *   The number of ItemIDs in the path.
+     * @param supportCount
+     *   The support count of the path.
+     */
+    void FPTree::addPath(const ItemID * itemIDs, int numItemIDs, SupportCount supportCount) {
+        FPTreeNode * currentNode = root;
 
-            // We've processed this item in the transaction, time to move on
-            // to the next!
-            currentNode = nextNode;
-            nextNode = NULL;
-        }
+        for (int i = 0; i < numItemIDs; i++)
+            currentNode = this->addItem(currentNode, itemIDs[i], supportCount);
     }
 
     void FPTree::buildTreeFromPrefixPaths(const QList<ItemList> & prefixPaths) {
@@ -138,18 +144,48 @@ namespace Analytics {
     //------------------------------------------------------------------------
     // Protected methods.
 
-    void FPTree::addNodeToItemPath(FPNode<SupportCount> * node) {
-        QList<FPNode<SupportCount> *> itemPath;
-
-        ItemID itemID = node->getItemID();
+    /**
+     * Add an item below the given node: reuse the child node for the item if
+     * there is one, otherwise create it.
+     *
+     * @param currentNode
+     *   The node below which the item should be added.
+     * @param itemID
+     *   The ItemID of the item.
+     * @param supportCount
+     *   The support count that should be added for the item.
+     * @return
+     *   The node for the item.
+     */
+    FPTreeNode * FPTree::addItem(FPTreeNode * currentNode, ItemID itemID, SupportCount supportCount) {
+        // All nodes in this tree are FPTreeNodes.
+        FPTreeNode * nextNode = static_cast<FPTreeNode *>(currentNode->getChild(itemID));
+        FPTreeHeaderEntry & entry = this->headerTable[itemID];
+
+        if (nextNode != NULL) {
+            // There is already a node in the tree for the current
+            // transaction item, so reuse it: increase its support count.
+            nextNode->addSupportCount(supportCount);
+        }
+        else {
+            // Create a new node and add it as a child of the current node.
+            nextNode = FPTreeNode::create(this->arena, itemID, supportCount);
+            nextNode->setParent(currentNode, this->arena);
+
+            // Append the new node to the item's node-links.
+            if (entry.last != NULL)
+                entry.last->nextSameItem = nextNode;
+            else
+                entry.first = nextNode;
+            entry.last = nextNode;
+        }
+        entry.support += supportCount;
 
-        // If there already is an item path for this item, load it so it can
-        // be updated.
-        if (this->itemPaths.contains(itemID))
-            itemPath = this->itemPaths[itemID];
+#ifdef DEBUG
+        nextNode->itemIDNameHash = this->itemIDNameHash;
+#endif
 
-        itemPath.append(node);
-        this->itemPaths.insert(itemID, itemPath);
+        return nextNode;
     }
 
 
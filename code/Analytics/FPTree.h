@@ -9,25 +9,65 @@
 
 #include "Item.h"
 #include "FPNode.h"
+#include "NodeArena.h"
 
 
 namespace Analytics {
+
+    /**
+     * An FP-tree node: an FPNode that also links to the next node in the
+     * FP-tree for the same item (its node-link).
+     */
+    class FPTreeNode : public FPNode<SupportCount> {
+    public:
+        FPTreeNode(ItemID itemID, SupportCount count)
+            : FPNode<SupportCount>(itemID, count), nextSameItem(NULL) {}
+
+        static FPTreeNode * create(NodeArena * arena, ItemID itemID, SupportCount count) {
+            FPTreeNode * node = new (arena->allocate(sizeof(FPTreeNode))) FPTreeNode(itemID, count);
+            node->inArena = true;
+            return node;
+        }
+
+        FPTreeNode * getNextSameItem() const { return this->nextSameItem; }
+
+    protected:
+        friend class FPTree;
+        FPTreeNode * nextSameItem;
+    };
+
+    /**
+     * An entry in the FP-tree's header table: the first and last node for
+     * an item (all of its nodes are linked through their node-links, in the
+     * order in which they were added) and the item's total support.
+     */
+    struct FPTreeHeaderEntry {
+        FPTreeHeaderEntry() : first(NULL), last(NULL), support(0) {}
+
+        FPTreeNode * first;
+        FPTreeNode * last;
+        SupportCount support;
+    };
+
     class FPTree {
     public:
-        FPTree();
+        FPTree(NodeArenaPool * arenaPool = NULL);
         ~FPTree();
 
         // Accessors.
         FPNode<SupportCount> * getRoot() const { return this->root; }
+        const NodeArena * getArena() const { return this->arena; }
         bool hasItemPath(ItemID itemID) const;
-        ItemIDList getItemIDs() const { return this->itemPaths.keys(); }
+        ItemIDList getItemIDs() const { return this->headerTable.keys(); }
+        FPTreeNode * getFirstNodeForItem(ItemID itemID) const { return this->headerTable.value(itemID).first; }
         QList<FPNode<SupportCount> *> getItemPath(ItemID itemID) const;
         bool itemPathContains(ItemID itemID, FPNode<SupportCount> * node) const;
-        SupportCount getItemSupport(ItemID item) const;
+        SupportCount getItemSupport(ItemID itemID) const { return this->headerTable.value(itemID).support; }
         QList<ItemList> calculatePrefixPaths(ItemID itemID) const;
 
         // Modifiers.
         void addTransaction(const Transaction & transaction);
+        void addPath(const ItemID * itemIDs, int numItemIDs, SupportCount supportCount);
         void buildTreeFromPrefixPaths(const QList<ItemList> & prefixPaths);
 
         // Static (class) methods.
@@ -38,11 +78,15 @@ namespace Analytics {
 #endif
 
     protected:
-        FPNode<SupportCount> * root;
-        QHash<ItemID, QList<FPNode<SupportCount> *> > itemPaths;
+        // All nodes are allocated from this arena, which is either owned by
+        // this tree or acquired from (and released to) the arena pool.
+        NodeArena * arena;
+        NodeArenaPool * arenaPool;
+        FPTreeNode * root;
+        QHash<ItemID, FPTreeHeaderEntry> headerTable;
 
         void init();
-        void addNodeToItemPath(FPNode<SupportCount> * node);
+        FPTreeNode * addItem(FPTreeNode * currentNode, ItemID itemID, SupportCount supportCount);
     };
 
 #ifdef DEBUG
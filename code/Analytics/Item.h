@@ -74,6 +74,16 @@ namespace Analytics {
     typedef QList<Item> ItemList;
     typedef QList<ItemName> ItemNameList;
     typedef QList<Item> Transaction;
+    // A distinct transaction (as item IDs) and the number of times it
+    // occurs in a batch.
+    struct WeightedTransaction {
+        WeightedTransaction() : weight(0) {}
+        WeightedTransaction(const ItemIDList & itemIDs, SupportCount weight)
+            : itemIDs(itemIDs), weight(weight) {}
+
+        ItemIDList itemIDs;
+        SupportCount weight;
+    };
     struct FrequentItemset {
         FrequentItemset() : support(0) {}
         FrequentItemset(ItemIDList itemset, SupportCount support)
@@ -0,0 +1,122 @@
+#include "NodeArena.h"
+
+namespace Analytics {
+
+    //------------------------------------------------------------------------
+    // Public methods.
+
+    NodeArena::NodeArena() {
+        this->currentBlock = -1;
+        this->cursor       = NULL;
+        this->blockEnd     = NULL;
+    }
+
+    NodeArena::~NodeArena() {
+        for (int i = 0; i < this->blocks.size(); i++)
+            qFree(this->blocks[i].data);
+    }
+
+    /**
+     * Release all memory that was allocated from this arena, in O(1). The
+     * blocks are kept, so that they can be reused.
+     */
+    void NodeArena::reset() {
+        if (this->blocks.isEmpty())
+            return;
+
+        this->currentBlock = 0;
+        this->cursor   = this->blocks[0].data;
+        this->blockEnd = this->blocks[0].data + this->blocks[0].size;
+    }
+
+    quint64 NodeArena::getBytesUsed() const {
+        quint64 bytes = 0;
+        for (int i = 0; i < this->currentBlock; i++)
+            bytes += this->blocks[i].size;
+        if (this->currentBlock >= 0)
+            bytes += this->cursor - this->blocks[this->currentBlock].data;
+        return bytes;
+    }
+
+    quint64 NodeArena::getBytesReserved() const {
+        quint64 bytes = 0;
+        for (int i = 0; i < this->blocks.size(); i++)
+            bytes += this->blocks[i].size;
+        return bytes;
+    }
+
+
+    //------------------------------------------------------------------------
+    // Protected methods.
+
+    /**
+     * Move on to the next block, because the current block does not have
+     * enough space left. A block that was kept by reset() is reused when it
+     * is large enough, otherwise a new block is inserted after the current
+     * block.
+     *
+     * @param size
+     *   The (aligned) size of the allocation.
+     * @return
+     *   The allocated memory.
+     */
+    void * NodeArena::allocateFromNextBlock(size_t size) {
+        int next = this->currentBlock + 1;
+
+        if (next >= this->blocks.size() || this->blocks[next].size < size) {
+            Block block;
+            block.size = (this->currentBlock >= 0) ? qMin((size_t) NODE_ARENA_MAX_BLOCK_SIZE, this->blocks[this->currentBlock].size * 2) : NODE_ARENA_MIN_BLOCK_SIZE;
+            if (block.size < size)
+                block.size = size;
+            block.data = (char *) qMalloc(block.size);
+            if (block.data == NULL)
+                qFatal("NodeArena: could not allocate a block of %d bytes.", (int) block.size);
+            this->blocks.insert(next, block);
+        }
+
+        this->currentBlock = next;
+        this->cursor   = this->blocks[next].data + size;
+        this->blockEnd = this->blocks[next].data + this->blocks[next].size;
+        return this->blocks[next].data;
+    }
+
+
+    //------------------------------------------------------------------------
+    // NodeArenaPool.
+
+    NodeArenaPool::NodeArenaPool() {
+        this->numArenasCreated = 0;
+    }
+
+    NodeArenaPool::~NodeArenaPool() {
+        qDeleteAll(this->freeArenas);
+    }
+
+    /**
+     * @return
+     *   An empty arena: the most recently released one, or a new one.
+     */
+    NodeArena * NodeArenaPool::acquire() {
+        QMutexLocker locker(&this->mutex);
+
+        if (!this->freeArenas.isEmpty())
+            return this->freeArenas.takeLast();
+
+        this->numArenasCreated++;
+        return new NodeArena();
+    }
+
+    /**
+     * Return an arena to the pool. All memory allocated from it is released.
+     */
+    void NodeArenaPool::release(NodeArena * arena) {
+        arena->reset();
+
+        QMutexLocker locker(&this->mutex);
+        if (this->freeArenas.size() < NODE_ARENA_POOL_MAX_FREE)
+            this->freeArenas.append(arena);
+        else
+            delete arena;
+    }
+
+}
@@ -0,0 +1,88 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+
+
+namespace Analytics {
+
+    // Size (in bytes) of the first block of an arena. Subsequent blocks are
+    // twice as large as the previous one, up to the maximum block size.
+    #define NODE_ARENA_MIN_BLOCK_SIZE 4096
+    #define NODE_ARENA_MAX_BLOCK_SIZE 1048576
+    // All allocations are aligned to this many bytes.
+    #define NODE_ARENA_ALIGNMENT 8
+    // Maximum number of released arenas an arena pool keeps for reuse.
+    #define NODE_ARENA_POOL_MAX_FREE 64
+
+    /**
+     * A bump-pointer allocator for the nodes of a tree (and their child
+     * storage). Memory is allocated from large blocks and is never freed
+     * individually: the entire arena is released at once by reset(), which
+     * keeps the blocks so that they can be reused.
+     * Destructors of the objects that live in an arena are never called.
+     */
+    class NodeArena {
+    public:
+        NodeArena();
+        ~NodeArena();
+
+        void * allocate(size_t size) {
+            size = (size + NODE_ARENA_ALIGNMENT - 1) & ~((size_t) NODE_ARENA_ALIGNMENT - 1);
+            if (size > (size_t) (this->blockEnd - this->cursor))
+                return this->allocateFromNextBlock(size);
+            void * memory = this->cursor;
+            this->cursor += size;
+            return memory;
+        }
+        void reset();
+
+        // Stats.
+        int getNumBlocks() const { return this->blocks.size(); }
+        quint64 getBytesUsed() const;
+        quint64 getBytesReserved() const;
+
+    protected:
+        struct Block {
+            char * data;
+            size_t size;
+        };
+
+        void * allocateFromNextBlock(size_t size);
+
+        QVector<Block> blocks;
+        int currentBlock;
+        char * cursor;
+        char * blockEnd;
+    };
+
+    /**
+     * A stack of arenas, so that short-lived trees (e.g. the conditional
+     * FP-trees that are built while mining) can reuse the blocks of the
+     * arenas of trees that have already been deleted.
+     */
+    class NodeArenaPool {
+    public:
+        NodeArenaPool();
+        ~NodeArenaPool();
+
+        NodeArena * acquire();
+        void release(NodeArena * arena);
+
+        // Stats.
+        int getNumArenasCreated() const { return this->numArenasCreated; }
+        int getNumFreeArenas() const { return this->freeArenas.size(); }
+
+    protected:
+        QList<NodeArena *> freeArenas;
+        int numArenasCreated;
+        QMutex mutex;
+    };
+
+}
+
+#endif // NODEARENA_H
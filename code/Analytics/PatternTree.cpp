@@ -64,14 +64,14 @@ namespace Analytics {
             frequentItemsets.append(frequentItemset);
 
         // Recursive call for each child node of the current node.
-        foreach (FPNode<TiltedTimeWindow> * child, node->getChildren()) {
+        for (unsigned int i = 0; i < node->numChildren(); i++) {
             frequentItemsets.append(this->getFrequentItemsetsForRange(
                     minSupport,
                     frequentItemsetConstraints,
                     from,
                     to,
                     frequentItemset.itemset,
-                    child
+                    node->getChildAt(i)
             ));
         }
 
@@ -0,0 +1,205 @@
+#include "ProjectedDatabase.h"
+
+namespace Analytics {
+
+    // While infrequent items are being removed, the count of an item that
+    // has already been added to the support counts is set to this value.
+    #define PROJECTED_DATABASE_ITEM_ADDED MAX_SUPPORT
+
+    //------------------------------------------------------------------------
+    // Public methods.
+
+    ProjectedDatabase::ProjectedDatabase() {
+        this->items.resize(PROJECTED_DATABASE_MIN_ITEMS);
+        this->paths.resize(PROJECTED_DATABASE_MIN_PATHS);
+        this->numItems = 0;
+        this->numPaths = 0;
+    }
+
+    /**
+     * Project an FP-tree: collect the prefix paths of the given item by
+     * following its node-links, and count the support of the items in them
+     * along the way (i.e. in the same traversal).
+     *
+     * @param tree
+     *   An FP-tree or conditional FP-tree.
+     * @param itemID
+     *   The item whose prefix paths should be collected.
+     * @param minSupportAbsolute
+     *   The minimum absolute support count that items should meet to be
+     *   kept in the prefix paths.
+     */
+    void ProjectedDatabase::projectTree(const FPTree * tree, ItemID itemID, SupportCount minSupportAbsolute) {
+        FPNode<SupportCount> * node;
+        SupportCount weight;
+        int offset;
+
+        this->clear();
+
+        for (FPTreeNode * leafNode = tree->getFirstNodeForItem(itemID); leafNode != NULL; leafNode = leafNode->getNextSameItem()) {
+            // Collect the items from the leaf node up to (but excluding) the
+            // root, with the count of the leaf node as the weight.
+            offset = this->numItems;
+            weight = leafNode->getValue();
+            node = leafNode;
+            while ((node = node->getParent()) != NULL && node->getItemID() != ROOT_ITEMID)
+                this->appendItem(node->getItemID(), weight);
+
+            // The items were collected from the bottom up, but prefix paths
+            // start at the root.
+            for (int i = offset, j = this->numItems - 1; i < j; i++, j--)
+                qSwap(this->items[i], this->items[j]);
+
+            this->appendPath(offset, weight);
+        }
+
+        this->removeInfrequentItems(minSupportAbsolute);
+    }
+
+    /**
+     * Project another projected database, in the same way as projectTree()
+     * projects the conditional FP-tree that would be built from it: the
+     * prefix path of the given item in each of its paths is collected.
+     *
+     * @param database
+     *   A projected database (not this one).
+     * @param itemID
+     *   The item whose prefix paths should be collected.
+     * @param minSupportAbsolute
+     *   The minimum absolute support count that items should meet to be
+     *   kept in the prefix paths.
+     */
+    void ProjectedDatabase::projectDatabase(const ProjectedDatabase & database, ItemID itemID, SupportCount minSupportAbsolute) {
+        Q_ASSERT(&database != this);
+
+        const ItemID * pathItems;
+        int length, offset;
+
+        this->clear();
+
+        for (int p = 0; p < database.numPaths; p++) {
+            const WeightedPath & path = database.paths[p];
+
+            // An item occurs at most once in a path. The items before it are
+            // its prefix path.
+            pathItems = database.items.constData() + path.offset;
+            for (length = 0; length < path.length && pathItems[length] != itemID; length++)
+                ;
+            if (length == path.length)
+                continue;
+
+            offset = this->numItems;
+            for (int i = 0; i < length; i++)
+                this->appendItem(pathItems[i], path.weight);
+            this->appendPath(offset, path.weight);
+        }
+
+        this->removeInfrequentItems(minSupportAbsolute);
+    }
+
+    /**
+     * Build the conditional FP-tree for this projected database.
+     *
+     * @param tree
+     *   An empty FP-tree.
+     */
+    void ProjectedDatabase::buildTree(FPTree * tree) const {
+        for (int p = 0; p < this->numPaths; p++) {
+            const WeightedPath & path = this->paths[p];
+            tree->addPath(this->items.constData() + path.offset, path.length, path.weight);
+        }
+    }
+
+
+    //------------------------------------------------------------------------
+    // Protected methods.
+
+    /**
+     * Empty this projected database, but keep its buffers.
+     */
+    void ProjectedDatabase::clear() {
+        this->numItems = 0;
+        this->numPaths = 0;
+        this->supportCounts.clear();
+    }
+
+    /**
+     * Add a path that consists of the items that were appended since the
+     * given offset. Empty paths are ignored.
+     *
+     * @param offset
+     *   The offset of the first item of the path in the items buffer.
+     * @param weight
+     *   The support count of the path.
+     */
+    void ProjectedDatabase::appendPath(int offset, SupportCount weight) {
+        if (this->numItems == offset)
+            return;
+
+        if (this->numPaths == this->paths.size())
+            this->paths.resize(2 * this->paths.size());
+
+        WeightedPath & path = this->paths[this->numPaths++];
+        path.offset = offset;
+        path.length = this->numItems - offset;
+        path.weight = weight;
+    }
+
+    /**
+     * Remove the items that don't meet the minimum support from the paths
+     * (and the paths that become empty), by compacting the buffers in place.
+     * The items that do meet the minimum support are added to the support
+     * counts in the order in which they are first encountered, which is the
+     * order in which FPTree::addTransaction() would add them to the header
+     * table of a conditional FP-tree.
+     *
+     * @param minSupportAbsolute
+     *   The minimum absolute support count that should be met.
+     */
+    void ProjectedDatabase::removeInfrequentItems(SupportCount minSupportAbsolute) {
+        ItemID * items = this->items.data();
+        SupportCount * itemCounts = this->itemCounts.data();
+        ItemID itemID;
+        SupportCount count;
+        int numItems = 0;
+        int numPaths = 0;
+        int offset;
+
+        for (int p = 0; p < this->numPaths; p++) {
+            WeightedPath path = this->paths[p];
+
+            offset = numItems;
+            for (int i = path.offset; i < path.offset + path.length; i++) {
+                itemID = items[i];
+                count = itemCounts[itemID];
+
+                // Infrequent items are reset as soon as they are encountered.
+                if (count < minSupportAbsolute) {
+                    itemCounts[itemID] = 0;
+                    continue;
+                }
+                if (count != PROJECTED_DATABASE_ITEM_ADDED) {
+                    this->supportCounts.insert(itemID, count);
+                    itemCounts[itemID] = PROJECTED_DATABASE_ITEM_ADDED;
+                }
+                items[numItems++] = itemID;
+            }
+
+            if (numItems > offset) {
+                WeightedPath & filteredPath = this->paths[numPaths++];
+                filteredPath.offset = offset;
+                filteredPath.length = numItems - offset;
+                filteredPath.weight = path.weight;
+            }
+        }
+
+        this->numItems = numItems;
+        this->numPaths = numPaths;
+
+        // Reset the counts of the frequent items.
+        QHash<ItemID, SupportCount>::const_iterator it;
+        for (it = this->supportCounts.constBegin(); it != this->supportCounts.constEnd(); ++it)
+            itemCounts[it.key()] = 0;
+    }
+
+}
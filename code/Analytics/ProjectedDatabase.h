@@ -0,0 +1,88 @@
+#ifndef PROJECTEDDATABASE_H
+#define PROJECTEDDATABASE_H
+
+#include <QHash>
+#include <QVector>
+
+#include "Item.h"
+#include "FPNode.h"
+#include "FPTree.h"
+
+
+namespace Analytics {
+
+    // Initial capacity of the buffers of a projected database. They grow by
+    // doubling and are never shrunk.
+    #define PROJECTED_DATABASE_MIN_ITEMS 256
+    #define PROJECTED_DATABASE_MIN_PATHS 64
+
+    /**
+     * The conditional (projected) database for an item: the prefix paths of
+     * that item, stored as weighted paths in a single flat buffer of ItemIDs.
+     * It holds the same prefix paths as the conditional FP-tree for that item,
+     * but without merging their common prefixes into nodes.
+     *
+     * The support counts of the items in the prefix paths are counted while
+     * the prefix paths are collected, after which the items that don't meet
+     * the minimum support are removed. The remaining items are listed by
+     * getItemIDs() in exactly the same order as FPTree::getItemIDs() would
+     * list them for the conditional FP-tree.
+     *
+     * The buffers are kept by each projection, so that a single projected
+     * database can be reused for many projections without reallocating.
+     */
+    class ProjectedDatabase {
+    public:
+        ProjectedDatabase();
+
+        void projectTree(const FPTree * tree, ItemID itemID, SupportCount minSupportAbsolute);
+        void projectDatabase(const ProjectedDatabase & database, ItemID itemID, SupportCount minSupportAbsolute);
+        void buildTree(FPTree * tree) const;
+
+        // Accessors.
+        bool isEmpty() const { return this->numPaths == 0; }
+        int getNumPaths() const { return this->numPaths; }
+        int getNumItems() const { return this->numItems; }
+        ItemIDList getItemIDs() const { return this->supportCounts.keys(); }
+        SupportCount getItemSupport(ItemID itemID) const { return this->supportCounts.value(itemID); }
+        const QHash<ItemID, SupportCount> & getSupportCounts() const { return this->supportCounts; }
+
+    protected:
+        struct WeightedPath {
+            int offset;
+            int length;
+            SupportCount weight;
+        };
+
+        void clear();
+        void appendItem(ItemID itemID, SupportCount weight) {
+            if (this->numItems == this->items.size())
+                this->items.resize(2 * this->items.size());
+            this->items[this->numItems++] = itemID;
+
+            if (itemID >= (ItemID) this->itemCounts.size())
+                this->itemCounts.resize(itemID + 1);
+            this->itemCounts[itemID] += weight;
+        }
+        void appendPath(int offset, SupportCount weight);
+        void removeInfrequentItems(SupportCount minSupportAbsolute);
+
+        // The prefix paths: numPaths paths, whose items are stored in the
+        // first numItems ItemIDs of the items buffer.
+        QVector<ItemID> items;
+        int numItems;
+        QVector<WeightedPath> paths;
+        int numPaths;
+
+        // The support counts of the items that meet the minimum support,
+        // inserted in the order in which the items occur in the paths.
+        QHash<ItemID, SupportCount> supportCounts;
+
+        // The support counts of all items in the paths, indexed by ItemID,
+        // while they are being counted. Reset to zero afterwards.
+        QVector<SupportCount> itemCounts;
+    };
+
+}
+
+#endif // PROJECTEDDATABASE_H
@@ -1,5 +1,75 @@
 #include "TestFPGrowth.h"
 
+/**
+ * Generate transactions that resemble a batch of page views: a few items
+ * occur in most transactions, most items occur rarely.
+ */
+static QList<QStringList> generateTransactions(int numTransactions, uint seed) {
+    QList<QStringList> transactions;
+    QStringList transaction;
+    QString item;
+
+    qsrand(seed);
+    for (int i = 0; i < numTransactions; i++) {
+        transaction.clear();
+        int size = 3 + qrand() % 8;
+        while (transaction.size() < size) {
+            item = QString("item%1").arg((qrand() % 300) * (qrand() % 300) / 300);
+            if (!transaction.contains(item))
+                transaction.append(item);
+        }
+        transactions.append(transaction);
+    }
+
+    return transactions;
+}
+
+static QList<FrequentItemset> mineWithCore(const QList<QStringList> & transactions, double minSupport, FPGrowthMiningCore miningCore, const Constraints & constraints, int numThreads = 1) {
+    ItemIDNameHash itemIDNameHash;
+    ItemNameIDHash itemNameIDHash;
+    ItemIDList sortedFrequentItemIDs;
+    FPGrowth * fpgrowth = new FPGrowth(transactions, minSupport * transactions.size(), &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+    fpgrowth->setMiningCore(miningCore);
+    fpgrowth->setNumThreads(numThreads);
+    fpgrowth->setConstraints(constraints);
+    QList<FrequentItemset> frequentItemsets = fpgrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+    delete fpgrowth;
+    return frequentItemsets;
+}
+
+static QList<FrequentItemset> mineWithEngine(const QList<QStringList> & transactions, double minSupport, MiningEngine miningEngine, const Constraints & constraints, MiningEngine * usedMiningEngine = NULL) {
+    ItemIDNameHash itemIDNameHash;
+    ItemNameIDHash itemNameIDHash;
+    ItemIDList sortedFrequentItemIDs;
+    FPGrowth * fpgrowth = new FPGrowth(transactions, minSupport * transactions.size(), &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+    fpgrowth->setMiningEngine(miningEngine);
+    fpgrowth->setConstraints(constraints);
+    QList<FrequentItemset> frequentItemsets = fpgrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+    if (usedMiningEngine != NULL)
+        *usedMiningEngine = fpgrowth->getMiningEngine();
+    delete fpgrowth;
+    return frequentItemsets;
+}
+
+static bool frequentItemsetLessThan(const FrequentItemset & a, const FrequentItemset & b) {
+    if (a.itemset.size() != b.itemset.size())
+        return a.itemset.size() < b.itemset.size();
+    for (int i = 0; i < a.itemset.size(); i++) {
+        if (a.itemset[i] != b.itemset[i])
+            return a.itemset[i] < b.itemset[i];
+    }
+    return false;
+}
+
+/**
+ * Mining engines yield the same frequent itemsets, but not necessarily in
+ * the same order.
+ */
+static QList<FrequentItemset> sortFrequentItemsets(QList<FrequentItemset> frequentItemsets) {
+    qSort(frequentItemsets.begin(), frequentItemsets.end(), frequentItemsetLessThan);
+    return frequentItemsets;
+}
+
 void TestFPGrowth::basic() {
     QList<QStringList> transactions;
     transactions.append(QStringList() << "A" << "B" << "C" << "D");
@@ -100,3 +170,267 @@ void TestFPGrowth::withConstraints() {
 
     delete fpgrowth;
 }
+
+void TestFPGrowth::weightedTransactions() {
+    QList<QStringList> transactions;
+    transactions.append(QStringList() << "A" << "B" << "C" << "D");
+    transactions.append(QStringList() << "A" << "B");
+    transactions.append(QStringList() << "A" << "C");
+    transactions.append(QStringList() << "A" << "B" << "C");
+    transactions.append(QStringList() << "A" << "D");
+    transactions.append(QStringList() << "A" << "C" << "D");
+    transactions.append(QStringList() << "C" << "B");
+    transactions.append(QStringList() << "B" << "C");
+    transactions.append(QStringList() << "C" << "D");
+    transactions.append(QStringList() << "C" << "E");
+    // Each transaction occurs twice.
+    transactions.append(transactions);
+
+    FPNode<SupportCount>::resetLastNodeID();
+    ItemIDNameHash itemIDNameHash;
+    ItemNameIDHash itemNameIDHash;
+    ItemIDList sortedFrequentItemIDs;
+    FPGrowth * fpgrowth = new FPGrowth(transactions, 0.4 * transactions.size(), &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+    QList<FrequentItemset> frequentItemsets = fpgrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+
+    // {C, B} and {B, C} are identical transactions, hence the 20
+    // transactions are collapsed into 9 weighted transactions.
+    QCOMPARE(fpgrowth->getNumTransactions(), 20);
+    QCOMPARE(fpgrowth->getNumDistinctTransactions(), 9);
+    QCOMPARE(fpgrowth->getTransactionReductionRatio(), 0.55);
+
+    // Identical to the results of basic(), with doubled support.
+    QCOMPARE(frequentItemsets, QList<FrequentItemset>() << FrequentItemset(ItemIDList() << 0     , 12)
+                                                        << FrequentItemset(ItemIDList() << 2 << 0,  8)
+                                                        << FrequentItemset(ItemIDList() << 1     , 10)
+                                                        << FrequentItemset(ItemIDList() << 2 << 1,  8)
+                                                        << FrequentItemset(ItemIDList() << 2     , 16)
+                                                        << FrequentItemset(ItemIDList() << 3     ,  8)
+    );
+
+    delete fpgrowth;
+}
+
+void TestFPGrowth::transactionWeight() {
+    QList<QStringList> transactions;
+    transactions.append(QStringList() << "A" << "B" << "C" << "D");
+    transactions.append(QStringList() << "A" << "B");
+    transactions.append(QStringList() << "A" << "C");
+    transactions.append(QStringList() << "A" << "B" << "C");
+    transactions.append(QStringList() << "A" << "D");
+    transactions.append(QStringList() << "A" << "C" << "D");
+    transactions.append(QStringList() << "C" << "B");
+    transactions.append(QStringList() << "B" << "C");
+    transactions.append(QStringList() << "C" << "D");
+    transactions.append(QStringList() << "C" << "E");
+
+    // A sample of half of the transactions, each of which counts twice.
+    FPNode<SupportCount>::resetLastNodeID();
+    ItemIDNameHash itemIDNameHash;
+    ItemNameIDHash itemNameIDHash;
+    ItemIDList sortedFrequentItemIDs;
+    FPGrowth * fpgrowth = new FPGrowth(transactions, 0.4 * transactions.size() * 2, &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+    fpgrowth->setTransactionWeight(2);
+    QList<FrequentItemset> frequentItemsets = fpgrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+
+    QCOMPARE(fpgrowth->getNumTransactions(), 10);
+    QCOMPARE(fpgrowth->getNumDistinctTransactions(), 9);
+
+    // Identical to the results of weightedTransactions().
+    QCOMPARE(frequentItemsets, QList<FrequentItemset>() << FrequentItemset(ItemIDList() << 0     , 12)
+                                                        << FrequentItemset(ItemIDList() << 2 << 0,  8)
+                                                        << FrequentItemset(ItemIDList() << 1     , 10)
+                                                        << FrequentItemset(ItemIDList() << 2 << 1,  8)
+                                                        << FrequentItemset(ItemIDList() << 2     , 16)
+                                                        << FrequentItemset(ItemIDList() << 3     ,  8)
+    );
+    QCOMPARE(fpgrowth->calculateSupportCount(ItemIDList() << 2 << 0), (SupportCount) 8);
+
+    delete fpgrowth;
+}
+
+void TestFPGrowth::projectedDatabases() {
+    QList<QStringList> transactions = generateTransactions(4000, 42);
+    QList<FrequentItemset> expected, frequentItemsets;
+
+    // With this many transactions, the largest projected databases are
+    // turned into conditional FP-trees, the others are mined directly.
+    // Identical frequent itemsets, in the same order.
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, Constraints());
+    frequentItemsets = mineWithCore(transactions, 0.005, FPGROWTH_PROJECTED_DATABASES, Constraints());
+    QVERIFY(expected.size() > 100);
+    QCOMPARE(frequentItemsets, expected);
+
+    // Also when the search space is pruned by constraints.
+    Constraints constraints;
+    constraints.addItemConstraint("item1", Analytics::CONSTRAINT_POSITIVE_MATCH_ANY);
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, constraints);
+    frequentItemsets = mineWithCore(transactions, 0.005, FPGROWTH_PROJECTED_DATABASES, constraints);
+    QVERIFY(expected.size() > 0);
+    QCOMPARE(frequentItemsets, expected);
+}
+
+void TestFPGrowth::parallelMining() {
+    QList<QStringList> transactions = generateTransactions(4000, 42);
+    QList<FrequentItemset> expected, frequentItemsets;
+
+    // Identical frequent itemsets, in the same order, regardless of the
+    // number of threads.
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, Constraints());
+    for (int numThreads = 2; numThreads <= 8; numThreads *= 2) {
+        frequentItemsets = mineWithCore(transactions, 0.005, FPGROWTH_PROJECTED_DATABASES, Constraints(), numThreads);
+        QCOMPARE(frequentItemsets, expected);
+    }
+
+    // Also when the search space is pruned by constraints.
+    Constraints constraints;
+    constraints.addItemConstraint("item1", Analytics::CONSTRAINT_POSITIVE_MATCH_ANY);
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, constraints);
+    frequentItemsets = mineWithCore(transactions, 0.005, FPGROWTH_PROJECTED_DATABASES, constraints, 4);
+    QCOMPARE(frequentItemsets, expected);
+}
+
+void TestFPGrowth::benchmarkMiningCores_data() {
+    QTest::addColumn<bool>("projectedDatabases");
+    QTest::addColumn<int>("numThreads");
+    QTest::addColumn<int>("numTransactions");
+
+    int idealThreadCount = qMax(1, QThread::idealThreadCount());
+    for (int numTransactions = 1000; numTransactions <= 16000; numTransactions *= 4) {
+        QTest::newRow(qPrintable(QString("conditional FP-trees, %1 transactions").arg(numTransactions))) << false << 1 << numTransactions;
+        QTest::newRow(qPrintable(QString("projected databases, 1 thread, %1 transactions").arg(numTransactions))) << true << 1 << numTransactions;
+        if (idealThreadCount > 1)
+            QTest::newRow(qPrintable(QString("projected databases, %1 threads, %2 transactions").arg(idealThreadCount).arg(numTransactions))) << true << idealThreadCount << numTransactions;
+    }
+}
+
+/**
+ * Measure synchronous mining with both mining cores (and with the projected
+ * databases core on all cores), for batches of sizes around the parser's
+ * chunk size.
+ */
+void TestFPGrowth::benchmarkMiningCores() {
+    QFETCH(bool, projectedDatabases);
+    QFETCH(int, numThreads);
+    QFETCH(int, numTransactions);
+
+    QList<QStringList> transactions = generateTransactions(numTransactions, 42);
+    FPGrowthMiningCore miningCore = (projectedDatabases) ? FPGROWTH_PROJECTED_DATABASES : FPGROWTH_CONDITIONAL_TREES;
+
+    QBENCHMARK {
+        mineWithCore(transactions, 0.005, miningCore, Constraints(), numThreads);
+    }
+}
+
+void TestFPGrowth::tidBitset() {
+    QVector<quint64> a(37), b(37), result(37);
+    quint64 expected = 0;
+
+    qsrand(42);
+    for (int i = 0; i < a.size(); i++) {
+        a[i] = (((quint64) qrand()) << 48) ^ (((quint64) qrand()) << 24) ^ qrand();
+        b[i] = (((quint64) qrand()) << 48) ^ (((quint64) qrand()) << 24) ^ qrand();
+        for (int bit = 0; bit < 64; bit++)
+            expected += ((a[i] & b[i]) >> bit) & 1;
+    }
+
+    // Every supported implementation intersects and counts identically,
+    // also for sizes that aren't a multiple of the SIMD width.
+    TidBitsetImplementation original = TidBitset::getImplementation();
+    for (int i = TID_BITSET_SCALAR; i <= TID_BITSET_AVX2; i++) {
+        TidBitsetImplementation implementation = (TidBitsetImplementation) i;
+        if (!TidBitset::isSupported(implementation))
+            continue;
+        QVERIFY(TidBitset::setImplementation(implementation));
+
+        result.fill(0);
+        QCOMPARE(TidBitset::intersect(a.constData(), b.constData(), result.data(), a.size()), expected);
+        for (int w = 0; w < a.size(); w++)
+            QCOMPARE(result[w], a[w] & b[w]);
+        QCOMPARE(TidBitset::intersect(a.constData(), b.constData(), result.data(), 5), TidBitset::intersect(a.constData(), b.constData(), result.data(), 4) + TidBitset::intersect(a.constData() + 4, b.constData() + 4, result.data() + 4, 1));
+    }
+    TidBitset::setImplementation(original);
+
+    QCOMPARE(TidBitset::lowestBit(Q_UINT64_C(1) << 63), 63);
+    QCOMPARE(TidBitset::lowestBit(12), 2);
+}
+
+void TestFPGrowth::eclat() {
+    QList<QStringList> transactions = generateTransactions(4000, 42);
+    QList<FrequentItemset> expected, frequentItemsets;
+
+    // The same frequent itemsets as FP-growth, with their items in the same
+    // order.
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, Constraints());
+    frequentItemsets = mineWithEngine(transactions, 0.005, MINING_ENGINE_ECLAT, Constraints());
+    QVERIFY(expected.size() > 100);
+    QCOMPARE(sortFrequentItemsets(frequentItemsets), sortFrequentItemsets(expected));
+
+    // Also when the search space is pruned by constraints.
+    Constraints constraints;
+    constraints.addItemConstraint("item1", Analytics::CONSTRAINT_POSITIVE_MATCH_ANY);
+    expected = mineWithCore(transactions, 0.005, FPGROWTH_CONDITIONAL_TREES, constraints);
+    frequentItemsets = mineWithEngine(transactions, 0.005, MINING_ENGINE_ECLAT, constraints);
+    QVERIFY(expected.size() > 0);
+    QCOMPARE(sortFrequentItemsets(frequentItemsets), sortFrequentItemsets(expected));
+
+    // Support counts of weighted transactions, for frequent itemsets and for
+    // exact support queries (in any order).
+    ItemIDNameHash itemIDNameHash;
+    ItemNameIDHash itemNameIDHash;
+    ItemIDList sortedFrequentItemIDs;
+    transactions = generateTransactions(2000, 7);
+    transactions.append(transactions.mid(0, 1000));
+    FPGrowth * fpgrowth = new FPGrowth(transactions, 0.005 * transactions.size() * 3, &itemIDNameHash, &itemNameIDHash, &sortedFrequentItemIDs);
+    fpgrowth->setTransactionWeight(3);
+    fpgrowth->setMiningEngine(MINING_ENGINE_ECLAT);
+    frequentItemsets = fpgrowth->mineFrequentItemsets(FPGROWTH_SYNC);
+    QVERIFY(frequentItemsets.size() > 100);
+    QVERIFY(fpgrowth->getNumDistinctTransactions() < fpgrowth->getNumTransactions());
+    foreach (const FrequentItemset & frequentItemset, frequentItemsets) {
+        ItemIDList reversed;
+        foreach (ItemID itemID, frequentItemset.itemset)
+            reversed.prepend(itemID);
+        QCOMPARE(fpgrowth->calculateSupportCount(frequentItemset.itemset), frequentItemset.support);
+        QCOMPARE(fpgrowth->calculateSupportCount(reversed), frequentItemset.support);
+    }
+    delete fpgrowth;
+}
+
+void TestFPGrowth::fastestMiningEngine() {
+    QList<QStringList> transactions = generateTransactions(4000, 42);
+    MiningEngine usedMiningEngine = MINING_ENGINE_FASTEST;
+
+    // Either engine may be selected, but the frequent itemsets are the same.
+    QList<FrequentItemset> expected = mineWithEngine(transactions, 0.005, MINING_ENGINE_FPGROWTH, Constraints());
+    QList<FrequentItemset> frequentItemsets = mineWithEngine(transactions, 0.005, MINING_ENGINE_FASTEST, Constraints(), &usedMiningEngine);
+    QVERIFY(usedMiningEngine == MINING_ENGINE_FPGROWTH || usedMiningEngine == MINING_ENGINE_ECLAT);
+    QCOMPARE(sortFrequentItemsets(frequentItemsets), sortFrequentItemsets(expected));
+}
+
+void TestFPGrowth::benchmarkMiningEngines_data() {
+    QTest::addColumn<int>("miningEngine");
+    QTest::addColumn<int>("numTransactions");
+
+    for (int numTransactions = 1000; numTransactions <= 16000; numTransactions *= 4) {
+        QTest::newRow(qPrintable(QString("FP-growth, %1 transactions").arg(numTransactions))) << (int) MINING_ENGINE_FPGROWTH << numTransactions;
+        QTest::newRow(qPrintable(QString("Eclat, %1 transactions").arg(numTransactions))) << (int) MINING_ENGINE_ECLAT << numTransactions;
+        QTest::newRow(qPrintable(QString("fastest, %1 transactions").arg(numTransactions))) << (int) MINING_ENGINE_FASTEST << numTransactions;
+    }
+}
+
+/**
+ * Measure synchronous mining with each mining engine, and with the engine
+ * that is selected by benchmarking both on a sample of the batch (which
+ * includes the time spent on selecting it).
+ */
+void TestFPGrowth::benchmarkMiningEngines() {
+    QFETCH(int, miningEngine);
+    QFETCH(int, numTransactions);
+
+    QList<QStringList> transactions = generateTransactions(numTransactions, 42);
+
+    QBENCHMARK {
+        mineWithEngine(transactions, 0.005, (MiningEngine) miningEngine, Constraints());
+    }
+}
@@ -17,6 +17,17 @@ private slots:
 //    void cleanup();
     void basic();
     void withConstraints();
+    void weightedTransactions();
+    void transactionWeight();
+    void projectedDatabases();
+    void parallelMining();
+    void benchmarkMiningCores_data();
+    void benchmarkMiningCores();
+    void tidBitset();
+    void eclat();
+    void fastestMiningEngine();
+    void benchmarkMiningEngines_data();
+    void benchmarkMiningEngines();
 };
 
 #endif // TESTFPGROWTH_H
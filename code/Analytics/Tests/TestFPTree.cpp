@@ -112,5 +112,132 @@ void TestFPTree::basic() {
     QCOMPARE(node->getValue(), (SupportCount) 1);
     QCOMPARE(node->getNodeID(), (unsigned int) 4);
 
+    // Verify the node-links: they link the nodes in the item path.
+    FPTreeNode * linkedNode = tree->getFirstNodeForItem(3);
+    QVERIFY(linkedNode != NULL);
+    QCOMPARE(linkedNode->getNodeID(), (unsigned int) 4);
+    QVERIFY(tree->itemPathContains(3, linkedNode));
+    linkedNode = linkedNode->getNextSameItem();
+    QVERIFY(linkedNode != NULL);
+    QCOMPARE(linkedNode->getNodeID(), (unsigned int) 5);
+    QVERIFY(linkedNode->getNextSameItem() == NULL);
+    QVERIFY(!tree->itemPathContains(3, root->getChild(1)));
+    QVERIFY(tree->getFirstNodeForItem(5) == NULL);
+    QCOMPARE(tree->getItemSupport(5), (SupportCount) 0);
+
     delete tree;
 }
+
+void TestFPTree::arena() {
+    // Allocations are aligned and don't overlap, also when they span
+    // multiple blocks.
+    NodeArena * arena = new NodeArena();
+    char * previous = NULL;
+    for (int i = 0; i < 1000; i++) {
+        char * memory = (char *) arena->allocate(13);
+        QVERIFY(((quintptr) memory) % NODE_ARENA_ALIGNMENT == 0);
+        if (previous != NULL && memory > previous)
+            QVERIFY(memory - previous >= 16);
+        previous = memory;
+    }
+    QCOMPARE(arena->getBytesUsed(), (quint64) 16000);
+    int numBlocks = arena->getNumBlocks();
+    QVERIFY(numBlocks > 1);
+
+    // An allocation larger than the largest block size gets its own block.
+    QVERIFY(arena->allocate(NODE_ARENA_MAX_BLOCK_SIZE + 1) != NULL);
+    QCOMPARE(arena->getNumBlocks(), numBlocks + 1);
+
+    // Resetting keeps the blocks and starts over at the first one.
+    void * first = NULL;
+    arena->reset();
+    QCOMPARE(arena->getBytesUsed(), (quint64) 0);
+    QCOMPARE(arena->getNumBlocks(), numBlocks + 1);
+    first = arena->allocate(8);
+    arena->reset();
+    QCOMPARE(arena->allocate(8), first);
+    delete arena;
+
+    // Trees that use an arena pool reuse the arenas of deleted trees.
+    NodeArenaPool pool;
+    Transaction t1, t2;
+    t1 << Item(3) << Item(1) << Item(2);
+    t2 << Item(2) << Item(1);
+
+    FPTree * tree = new FPTree(&pool);
+    const NodeArena * treeArena = tree->getArena();
+    tree->addTransaction(t1);
+    tree->addTransaction(t2);
+    QCOMPARE(tree->getItemSupport(1), (SupportCount) 2);
+    QCOMPARE(tree->getItemSupport(2), (SupportCount) 2);
+    QCOMPARE(tree->getItemSupport(3), (SupportCount) 1);
+
+    // The root's children are sorted by ItemID.
+    FPNode<SupportCount> * root = tree->getRoot();
+    QCOMPARE(root->numChildren(), (unsigned int) 2);
+    QCOMPARE(root->getChildAt(0)->getItemID(), (ItemID) 2);
+    QCOMPARE(root->getChildAt(1)->getItemID(), (ItemID) 3);
+    QVERIFY(root->getChild(1) == NULL);
+    QCOMPARE(root->getNumDescendants(), (unsigned int) 5);
+
+    // A conditional tree that is built while the tree is still in use
+    // gets a new arena.
+    FPTree * ctree = new FPTree(&pool);
+    QVERIFY(ctree->getArena() != treeArena);
+    delete ctree;
+    delete tree;
+    QCOMPARE(pool.getNumArenasCreated(), 2);
+    QCOMPARE(pool.getNumFreeArenas(), 2);
+
+    // The most recently released arena is reused, and is empty.
+    tree = new FPTree(&pool);
+    QVERIFY(tree->getArena() == treeArena);
+    QCOMPARE(tree->getRoot()->numChildren(), (unsigned int) 0);
+    QCOMPARE(pool.getNumArenasCreated(), 2);
+    delete tree;
+}
+
+void TestFPTree::childStorage() {
+    // Add children in a scrambled order, so that the child storage goes
+    // through all of its representations: inline, sorted and hash-indexed.
+    FPNode<SupportCount> * node = new FPNode<SupportCount>(ROOT_ITEMID, 0);
+    FPNode<SupportCount> * child;
+    NodeArena arena;
+    FPNode<SupportCount> * arenaNode = FPNode<SupportCount>::create(&arena, ROOT_ITEMID, 0);
+    const ItemID numChildren = 300;
+    for (ItemID i = 0; i < numChildren; i++) {
+        // 7 is coprime with numChildren: each ItemID is added once.
+        ItemID itemID = (i * 7) % numChildren * 1000;
+        child = new FPNode<SupportCount>(itemID, 1);
+        child->setParent(node);
+        child = FPNode<SupportCount>::create(&arena, itemID, 1);
+        child->setParent(arenaNode, &arena);
+
+        QCOMPARE(node->numChildren(), i + 1);
+        QVERIFY(node->getChild(itemID) != NULL);
+        QVERIFY(arenaNode->getChild(itemID) == child);
+        QVERIFY(!node->hasChild(itemID + 1));
+    }
+
+    // The children are sorted by ItemID.
+    QCOMPARE(node->getNumDescendants(), (unsigned int) numChildren);
+    QCOMPARE(arenaNode->getNumDescendants(), (unsigned int) numChildren);
+    for (ItemID i = 0; i < numChildren; i++) {
+        QCOMPARE(node->getChildAt(i)->getItemID(), i * 1000);
+        QCOMPARE(arenaNode->getChildAt(i)->getItemID(), i * 1000);
+        QVERIFY(node->hasChild(i * 1000));
+    }
+    QVERIFY(node->getMemoryUsage() >= (numChildren + 1) * sizeof(FPNode<SupportCount>));
+
+    // Deleting a child removes it from its parent.
+    for (ItemID i = 0; i < numChildren; i += 2)
+        delete node->getChild(i * 1000);
+    QCOMPARE(node->numChildren(), (unsigned int) numChildren / 2);
+    for (ItemID i = 0; i < numChildren; i++) {
+        QCOMPARE(node->hasChild(i * 1000), i % 2 == 1);
+        if (i % 2 == 1)
+            QCOMPARE(node->getChildAt(i / 2)->getItemID(), i * 1000);
+    }
+
+    delete node;
+}
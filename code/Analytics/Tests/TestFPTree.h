@@ -12,6 +12,8 @@ class TestFPTree: public QObject {
 
 private slots:
     void basic();
+    void arena();
+    void childStorage();
 };
 
 #endif // TESTFPTREE_H
@@ -143,3 +143,31 @@ void TestPatternTree::additionsRemainInSync() {
     QVector<SupportCount> referenceBuckets = QVector<SupportCount>() << 2 << 0;
     QCOMPARE(node->getValue().getBuckets(2), referenceBuckets);
 }
+
+void TestPatternTree::memoryUsage() {
+    PatternTree * patternTree = new PatternTree();
+    const ItemID numItems = 400;
+
+    // All single items and all pairs of items: a wide root, wide nodes at
+    // the first level and mostly leaves, like a production pattern tree.
+    for (ItemID i = 0; i < numItems; i++) {
+        patternTree->addPattern(FrequentItemset(ItemIDList() << i, 1, NULL), 0);
+        for (ItemID j = i + 1; j < numItems; j++)
+            patternTree->addPattern(FrequentItemset(ItemIDList() << i << j, 1, NULL), 0);
+    }
+    unsigned int numNodes = numItems + numItems * (numItems - 1) / 2;
+    QCOMPARE(patternTree->getNodeCount(), numNodes);
+    QVERIFY(patternTree->getPatternSupport(ItemIDList() << 3 << 250) != NULL);
+    QVERIFY(patternTree->getPatternSupport(ItemIDList() << 250 << 3) == NULL);
+
+    // Besides its TiltedTimeWindow, each node needs its own fields (28 bytes
+    // on 64-bit platforms) and a slot in its parent's child storage: a node
+    // pointer, an item ID and, in nodes with many children, two hash slots,
+    // with at most twice the capacity that is used. This amounts to about
+    // 69 bytes per node for this tree.
+    quint64 bytes = patternTree->getRoot()->getMemoryUsage();
+    QVERIFY(bytes >= (numNodes + 1) * sizeof(FPNode<TiltedTimeWindow>));
+    QVERIFY(bytes <= numNodes * (sizeof(TiltedTimeWindow) + 80));
+
+    delete patternTree;
+}
@@ -12,6 +12,7 @@ class TestPatternTree : public QObject {
 private slots:
     void basic();
     void additionsRemainInSync();
+    void memoryUsage();
 };
 
 #endif // TESTPATTERNTREE_H
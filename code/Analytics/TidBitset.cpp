@@ -0,0 +1,188 @@
+#include "TidBitset.h"
+
+#ifdef TID_BITSET_X86
+#include <immintrin.h>
+#endif
+
+namespace Analytics {
+
+    // The implementations, indexed by TidBitsetImplementation.
+    TidBitset::Kernel TidBitset::kernels[] = {
+        { TID_BITSET_SCALAR, &TidBitset::intersectScalar },
+#ifdef TID_BITSET_X86
+        { TID_BITSET_POPCNT, &TidBitset::intersectPOPCNT },
+        { TID_BITSET_AVX2, &TidBitset::intersectAVX2 }
+#endif
+    };
+
+    // The implementation is selected by the first call to intersect(),
+    // unless one is set explicitly before that. Like in DelimiterIndex, all
+    // of this is initialized statically and the kernel is swapped
+    // atomically, since mining threads may call intersect() for the first
+    // time concurrently.
+    TidBitset::Kernel TidBitset::detectKernel = { TID_BITSET_SCALAR, &TidBitset::intersectDetect };
+    QBasicAtomicPointer<TidBitset::Kernel> TidBitset::kernel = Q_BASIC_ATOMIC_INITIALIZER(&TidBitset::detectKernel);
+
+    //---------------------------------------------------------------------------
+    // Public static methods.
+
+    /**
+     * Get the implementation that intersect() uses.
+     */
+    TidBitsetImplementation TidBitset::getImplementation() {
+        TidBitset::kernel.testAndSetOrdered(&TidBitset::detectKernel, TidBitset::selectKernel(TID_BITSET_AVX2));
+        return TidBitset::kernel->implementation;
+    }
+
+    /**
+     * Select the implementation that intersect() uses. When the requested
+     * implementation is not supported by the CPU, the fastest supported
+     * implementation that is slower than the requested one is selected.
+     *
+     * This is intended for tests and benchmarks. It is thread-safe, but
+     * concurrent calls to intersect() may still use the previous
+     * implementation.
+     *
+     * @param implementation
+     *   The requested implementation.
+     * @return
+     *   true when the requested implementation was selected, false when a
+     *   fallback was selected instead.
+     */
+    bool TidBitset::setImplementation(TidBitsetImplementation implementation) {
+        Kernel * selected = TidBitset::selectKernel(implementation);
+
+        TidBitset::kernel.fetchAndStoreOrdered(selected);
+
+        return selected->implementation == implementation;
+    }
+
+    /**
+     * Check whether the CPU supports the given implementation.
+     */
+    bool TidBitset::isSupported(TidBitsetImplementation implementation) {
+        switch (implementation) {
+        case TID_BITSET_SCALAR:
+            return true;
+#ifdef TID_BITSET_X86
+        case TID_BITSET_POPCNT:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("popcnt");
+        case TID_BITSET_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+        default:
+            return false;
+        }
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected static methods.
+
+    /**
+     * @return
+     *   The requested implementation, or the fastest supported one that is
+     *   slower, when the CPU doesn't support it.
+     */
+    TidBitset::Kernel * TidBitset::selectKernel(TidBitsetImplementation implementation) {
+        while (!TidBitset::isSupported(implementation))
+            implementation = (TidBitsetImplementation) (implementation - 1);
+        return &TidBitset::kernels[implementation];
+    }
+
+    /**
+     * Select the fastest implementation that the CPU supports, unless one
+     * has been selected in the mean time, then intersect.
+     */
+    quint64 TidBitset::intersectDetect(const quint64 * a, const quint64 * b, quint64 * result, int numWords) {
+        TidBitset::kernel.testAndSetOrdered(&TidBitset::detectKernel, TidBitset::selectKernel(TID_BITSET_AVX2));
+        return TidBitset::kernel->intersect(a, b, result, numWords);
+    }
+
+    /**
+     * Count the bits of each word in parallel: first within pairs of bits,
+     * then within nibbles, then sum the nibbles' counts with a multiplication.
+     */
+    quint64 TidBitset::intersectScalar(const quint64 * a, const quint64 * b, quint64 * result, int numWords) {
+        quint64 count = 0;
+        quint64 word;
+
+        for (int i = 0; i < numWords; i++) {
+            word = a[i] & b[i];
+            result[i] = word;
+
+            word = word - ((word >> 1) & Q_UINT64_C(0x5555555555555555));
+            word = (word & Q_UINT64_C(0x3333333333333333)) + ((word >> 2) & Q_UINT64_C(0x3333333333333333));
+            word = (word + (word >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+            count += (word * Q_UINT64_C(0x0101010101010101)) >> 56;
+        }
+
+        return count;
+    }
+
+#ifdef TID_BITSET_X86
+    /**
+     * Count the bits of each word with a single POPCNT instruction.
+     */
+    __attribute__((target("popcnt")))
+    quint64 TidBitset::intersectPOPCNT(const quint64 * a, const quint64 * b, quint64 * result, int numWords) {
+        quint64 count = 0;
+        quint64 word;
+
+        for (int i = 0; i < numWords; i++) {
+            word = a[i] & b[i];
+            result[i] = word;
+            count += __builtin_popcountll(word);
+        }
+
+        return count;
+    }
+
+    /**
+     * Intersect 4 words at a time and count their bits per nibble, by looking
+     * up the count of each nibble in a 16-entry table with a shuffle. The
+     * nibbles' counts are summed per word with a sum of absolute differences,
+     * into 4 running totals. The remaining words are counted with POPCNT.
+     */
+    __attribute__((target("avx2,popcnt")))
+    quint64 TidBitset::intersectAVX2(const quint64 * a, const quint64 * b, quint64 * result, int numWords) {
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i totals = _mm256_setzero_si256();
+        __m256i words, counts;
+        quint64 count = 0;
+        quint64 word;
+        int i;
+
+        for (i = 0; i + 4 <= numWords; i += 4) {
+            words = _mm256_and_si256(
+                _mm256_loadu_si256((const __m256i *) (a + i)),
+                _mm256_loadu_si256((const __m256i *) (b + i))
+            );
+            _mm256_storeu_si256((__m256i *) (result + i), words);
+
+            counts = _mm256_add_epi8(
+                _mm256_shuffle_epi8(lookup, _mm256_and_si256(words, lowNibbles)),
+                _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(words, 4), lowNibbles))
+            );
+            totals = _mm256_add_epi64(totals, _mm256_sad_epu8(counts, zero));
+        }
+
+        quint64 total[4];
+        _mm256_storeu_si256((__m256i *) total, totals);
+        count = total[0] + total[1] + total[2] + total[3];
+
+        for (; i < numWords; i++) {
+            word = a[i] & b[i];
+            result[i] = word;
+            count += __builtin_popcountll(word);
+        }
+
+        return count;
+    }
+#endif
+}
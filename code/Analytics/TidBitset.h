@@ -0,0 +1,99 @@
+#ifndef TIDBITSET_H
+#define TIDBITSET_H
+
+#include <QtGlobal>
+#include <QAtomicPointer>
+
+
+namespace Analytics {
+
+    // POPCNT and AVX2 implementations are available when building with GCC
+    // (or a compatible compiler) for x86; elsewhere, only the scalar one is.
+    #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define TID_BITSET_X86 1
+    #endif
+
+    enum TidBitsetImplementation {
+        TID_BITSET_SCALAR,
+        TID_BITSET_POPCNT,
+        TID_BITSET_AVX2
+    };
+
+    /**
+     * Operations on tidset bitsets: the set of (distinct) transactions that
+     * contain an item or itemset, with one bit per transaction, stored in
+     * 64-bit words. Eclat uses them to calculate the support of itemsets.
+     *
+     * On x86, the POPCNT instruction counts the bits of a word at once, and
+     * AVX2 intersects and counts 4 words at once. The fastest implementation
+     * that the CPU supports is chosen at runtime. Elsewhere, the bits are
+     * counted in parallel within each word.
+     */
+    class TidBitset {
+    public:
+        static quint64 intersect(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+        static int lowestBit(quint64 word);
+
+        static TidBitsetImplementation getImplementation();
+        static bool setImplementation(TidBitsetImplementation implementation);
+        static bool isSupported(TidBitsetImplementation implementation);
+
+    protected:
+        typedef quint64 (*IntersectFunction)(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+
+        struct Kernel {
+            TidBitsetImplementation implementation;
+            IntersectFunction intersect;
+        };
+
+        static Kernel * selectKernel(TidBitsetImplementation implementation);
+        static quint64 intersectDetect(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+        static quint64 intersectScalar(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+#ifdef TID_BITSET_X86
+        static quint64 intersectPOPCNT(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+        static quint64 intersectAVX2(const quint64 * a, const quint64 * b, quint64 * result, int numWords);
+#endif
+
+        static Kernel kernels[];
+        static Kernel detectKernel;
+        static QBasicAtomicPointer<Kernel> kernel;
+    };
+
+    /**
+     * Intersect two bitsets and count the bits in the intersection.
+     *
+     * @param a
+     *   The first bitset.
+     * @param b
+     *   The second bitset.
+     * @param result
+     *   The intersection of both bitsets. May be identical to a or b.
+     * @param numWords
+     *   The size of the bitsets, in words.
+     * @return
+     *   The number of bits that are set in the intersection.
+     */
+    inline quint64 TidBitset::intersect(const quint64 * a, const quint64 * b, quint64 * result, int numWords) {
+        return TidBitset::kernel->intersect(a, b, result, numWords);
+    }
+
+    /**
+     * @param word
+     *   A word that is not zero.
+     * @return
+     *   The index of the lowest bit that is set.
+     */
+    inline int TidBitset::lowestBit(quint64 word) {
+#ifdef __GNUC__
+        return __builtin_ctzll(word);
+#else
+        int bit = 0;
+        for (; (word & 1) == 0; word >>= 1)
+            bit++;
+        return bit;
+#endif
+    }
+
+}
+
+#endif // TIDBITSET_H
@@ -0,0 +1,139 @@
+#include "WorkStealingPool.h"
+
+namespace Analytics {
+
+    //------------------------------------------------------------------------
+    // Public methods.
+
+    /**
+     * @param numThreads
+     *   The number of workers, including the thread that calls run().
+     */
+    WorkStealingPool::WorkStealingPool(int numThreads) {
+        for (int i = 0; i < qMax(1, numThreads); i++)
+            this->deques.append(new Deque());
+        this->numIdleWorkers = 0;
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        qDeleteAll(this->deques);
+    }
+
+    /**
+     * Submit a task to a worker. Submitting is allowed both before run() is
+     * called and from within running tasks.
+     *
+     * @param task
+     *   The task to run.
+     * @param worker
+     *   The worker whose deque the task should be added to: the worker that
+     *   runs the task that submits it.
+     */
+    void WorkStealingPool::submit(WorkStealingTask * task, int worker) {
+        this->numPendingTasks.ref();
+
+        Deque * deque = this->deques[worker % this->deques.size()];
+        deque->mutex.lock();
+        deque->tasks.append(task);
+        deque->mutex.unlock();
+
+        this->numSubmittedTasks.ref();
+        QMutexLocker locker(&this->idleMutex);
+        if (this->numIdleWorkers > 0)
+            this->taskSubmitted.wakeOne();
+    }
+
+    /**
+     * Run all submitted tasks (and the tasks they submit) on all workers.
+     * Blocks until all of them have been run.
+     */
+    void WorkStealingPool::run() {
+        QList<Worker *> workers;
+
+        for (int i = 1; i < this->deques.size(); i++) {
+            workers.append(new Worker(this, i));
+            workers.last()->start();
+        }
+
+        this->work(0);
+
+        foreach (Worker * worker, workers) {
+            worker->wait();
+            delete worker;
+        }
+    }
+
+
+    //------------------------------------------------------------------------
+    // Protected methods.
+
+    /**
+     * @param worker
+     *   A worker.
+     * @return
+     *   The most recently submitted task of the given worker, or when it has
+     *   none, the oldest task of another worker, or NULL when there are no
+     *   tasks at all.
+     */
+    WorkStealingTask * WorkStealingPool::take(int worker) {
+        Deque * deque = this->deques[worker];
+        int numWorkers = this->deques.size();
+
+        {
+            QMutexLocker locker(&deque->mutex);
+            if (!deque->tasks.isEmpty())
+                return deque->tasks.takeLast();
+        }
+
+        for (int i = 1; i < numWorkers; i++) {
+            deque = this->deques[(worker + i) % numWorkers];
+            QMutexLocker locker(&deque->mutex);
+            if (!deque->tasks.isEmpty()) {
+                this->numStolenTasks.ref();
+                return deque->tasks.takeFirst();
+            }
+        }
+
+        return NULL;
+    }
+
+    /**
+     * Run tasks until all tasks have been run.
+     *
+     * @param worker
+     *   The worker that runs the tasks.
+     */
+    void WorkStealingPool::work(int worker) {
+        WorkStealingTask * task;
+        int numSubmittedTasks;
+
+        forever {
+            numSubmittedTasks = this->numSubmittedTasks;
+            task = this->take(worker);
+
+            if (task != NULL) {
+                task->run(worker);
+
+                // Wake up the idle workers after the last task, so that they
+                // can return.
+                if (!this->numPendingTasks.deref()) {
+                    QMutexLocker locker(&this->idleMutex);
+                    this->taskSubmitted.wakeAll();
+                }
+                continue;
+            }
+
+            // There are no tasks to run right now. Wait for new tasks, unless
+            // some were submitted since we looked for them.
+            QMutexLocker locker(&this->idleMutex);
+            if (this->numPendingTasks == 0)
+                return;
+            if (this->numSubmittedTasks == numSubmittedTasks) {
+                this->numIdleWorkers++;
+                this->taskSubmitted.wait(&this->idleMutex);
+                this->numIdleWorkers--;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,87 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QList>
+#include <QVector>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+
+namespace Analytics {
+
+    /**
+     * A task that can be run by a WorkStealingPool.
+     */
+    class WorkStealingTask {
+    public:
+        virtual ~WorkStealingTask() {}
+
+        /**
+         * @param worker
+         *   The index of the worker that runs this task. Tasks that this
+         *   task creates should be submitted to the same worker.
+         */
+        virtual void run(int worker) = 0;
+    };
+
+    /**
+     * A thread pool for tasks that create more tasks, such as the recursive
+     * mining of frequent itemsets. Each worker has its own deque of tasks:
+     * it runs its own tasks in LIFO order (the most recently submitted task
+     * first, whose data is most likely still in the cache), and only when it
+     * has none left, it steals the oldest task of another worker (which is
+     * likely to be the largest one).
+     * The thread that calls run() is worker 0. run() returns once all tasks
+     * have been run, including those that were submitted while running.
+     * Tasks are not deleted by the pool.
+     */
+    class WorkStealingPool {
+    public:
+        WorkStealingPool(int numThreads);
+        ~WorkStealingPool();
+
+        void submit(WorkStealingTask * task, int worker = 0);
+        void run();
+
+        // Stats.
+        int getNumThreads() const { return this->deques.size(); }
+        int getNumStolenTasks() const { return this->numStolenTasks; }
+
+    protected:
+        class Worker : public QThread {
+        public:
+            Worker(WorkStealingPool * pool, int worker) : pool(pool), worker(worker) {}
+
+        protected:
+            void run() { this->pool->work(this->worker); }
+
+            WorkStealingPool * pool;
+            int worker;
+        };
+
+        struct Deque {
+            QMutex mutex;
+            QList<WorkStealingTask *> tasks;
+        };
+
+        WorkStealingTask * take(int worker);
+        void work(int worker);
+
+        QVector<Deque *> deques;
+        QAtomicInt numPendingTasks;
+        QAtomicInt numSubmittedTasks;
+        QAtomicInt numStolenTasks;
+
+        // Workers that have no tasks to run wait until a task is submitted,
+        // or until all tasks have been run.
+        QMutex idleMutex;
+        QWaitCondition taskSubmitted;
+        int numIdleWorkers;
+    };
+
+}
+
+#endif // WORKSTEALINGPOOL_H
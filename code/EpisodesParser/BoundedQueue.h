@@ -0,0 +1,135 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QQueue>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+
+namespace EpisodesParser {
+
+    /**
+     * Thread-safe FIFO queue with a maximum capacity, to connect a producer
+     * thread with a consumer thread. The producer blocks while the queue is
+     * full (i.e. backpressure), the consumer blocks while it is empty.
+     */
+    template <typename T>
+    class BoundedQueue {
+    public:
+        BoundedQueue(int capacity);
+
+        bool put(const T & item);
+        bool take(T & item);
+        void close();
+        void abort();
+        void reset();
+
+        int size() const;
+        int getCapacity() const { return this->capacity; }
+
+    protected:
+        mutable QMutex mutex;
+        QWaitCondition notEmpty;
+        QWaitCondition notFull;
+        QQueue<T> items;
+        int capacity;
+        bool closed;
+        bool aborted;
+    };
+
+
+    //---------------------------------------------------------------------------
+    // Public methods.
+
+    template <typename T>
+    BoundedQueue<T>::BoundedQueue(int capacity) {
+        this->capacity = capacity;
+        this->closed = false;
+        this->aborted = false;
+    }
+
+    /**
+     * Append an item, waiting while the queue is full.
+     *
+     * @return
+     *   false if the queue was aborted, in which case the item is dropped.
+     */
+    template <typename T>
+    bool BoundedQueue<T>::put(const T & item) {
+        QMutexLocker locker(&this->mutex);
+
+        while (this->items.size() >= this->capacity && !this->aborted)
+            this->notFull.wait(&this->mutex);
+        if (this->aborted)
+            return false;
+
+        this->items.enqueue(item);
+        this->notEmpty.wakeOne();
+        return true;
+    }
+
+    /**
+     * Remove the first item, waiting while the queue is empty.
+     *
+     * @return
+     *   false if no more items will become available, i.e. when the queue is
+     *   empty and closed, or when it was aborted.
+     */
+    template <typename T>
+    bool BoundedQueue<T>::take(T & item) {
+        QMutexLocker locker(&this->mutex);
+
+        while (this->items.isEmpty() && !this->closed && !this->aborted)
+            this->notEmpty.wait(&this->mutex);
+        if (this->aborted || this->items.isEmpty())
+            return false;
+
+        item = this->items.dequeue();
+        this->notFull.wakeOne();
+        return true;
+    }
+
+    /**
+     * Indicate that the producer won't put any more items. The consumer can
+     * still take the remaining items.
+     */
+    template <typename T>
+    void BoundedQueue<T>::close() {
+        QMutexLocker locker(&this->mutex);
+        this->closed = true;
+        this->notEmpty.wakeAll();
+    }
+
+    /**
+     * Wake up both the producer and the consumer and drop all items.
+     */
+    template <typename T>
+    void BoundedQueue<T>::abort() {
+        QMutexLocker locker(&this->mutex);
+        this->aborted = true;
+        this->items.clear();
+        this->notEmpty.wakeAll();
+        this->notFull.wakeAll();
+    }
+
+    /**
+     * Make an aborted or closed queue usable again.
+     */
+    template <typename T>
+    void BoundedQueue<T>::reset() {
+        QMutexLocker locker(&this->mutex);
+        this->items.clear();
+        this->closed = false;
+        this->aborted = false;
+    }
+
+    template <typename T>
+    int BoundedQueue<T>::size() const {
+        QMutexLocker locker(&this->mutex);
+        return this->items.size();
+    }
+
+}
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,550 @@
+#include "CompressedLogReader.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace EpisodesParser {
+
+    // Size of the fixed part of a gzip member header.
+    #define GZIP_HEADER_SIZE 12
+    // Size of a gzip member trailer: CRC32 and ISIZE.
+    #define GZIP_TRAILER_SIZE 8
+    // gzip header flag that indicates the presence of an extra field.
+    #define GZIP_FLAG_EXTRA 0x04
+    // The maximum size of the uncompressed data of a BGZF block.
+    #define BGZF_MAX_BLOCK_SIZE 65536
+
+    static quint16 readLittleEndian16(const char * data) {
+        return ((quint8) data[0]) | (((quint8) data[1]) << 8);
+    }
+
+    static quint32 readLittleEndian32(const char * data) {
+        return ((quint32) readLittleEndian16(data)) | (((quint32) readLittleEndian16(data + 2)) << 16);
+    }
+
+    /**
+     * Find the BSIZE (total block size - 1) in the extra field of a gzip
+     * member header.
+     *
+     * @return
+     *   true if the extra field contains a BGZF subfield, false otherwise.
+     */
+    static bool findBGZFBlockSize(const char * extra, int length, quint16 & blockSize) {
+        int position = 0;
+        quint16 subfieldLength;
+
+        while (position + 4 <= length) {
+            subfieldLength = readLittleEndian16(extra + position + 2);
+            if (extra[position] == 'B' && extra[position + 1] == 'C' && subfieldLength == 2 && position + 6 <= length) {
+                blockSize = readLittleEndian16(extra + position + 4);
+                return true;
+            }
+            position += 4 + subfieldLength;
+        }
+
+        return false;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Decompressor public methods.
+
+    Decompressor::Decompressor(BoundedQueue<QByteArray> * queue) {
+        this->queue = queue;
+        this->format = COMPRESSION_NONE;
+        this->stopRequested = 0;
+        this->failed = false;
+    }
+
+    bool Decompressor::open(const QString & fileName, CompressionFormat format) {
+        this->file.setFileName(fileName);
+        this->format = format;
+        this->stopRequested = 0;
+        this->failed = false;
+        return this->file.open(QIODevice::ReadOnly);
+    }
+
+    /**
+     * Stop decompressing and wait for the thread to finish. Any queued
+     * decompressed data is dropped.
+     */
+    void Decompressor::stop() {
+        this->stopRequested.fetchAndStoreOrdered(1);
+        this->queue->abort();
+        this->wait();
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Decompressor protected methods.
+
+    void Decompressor::run() {
+        bool success = false;
+
+        switch (this->format) {
+        case COMPRESSION_GZIP:
+            success = this->decompressGzip();
+            break;
+        case COMPRESSION_BGZF:
+            success = this->decompressBGZF();
+            break;
+        case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+            success = this->decompressZstd();
+#endif
+            break;
+        case COMPRESSION_NONE:
+            break;
+        }
+
+        this->failed = !success;
+        this->file.close();
+        this->queue->close();
+    }
+
+    /**
+     * Streaming gzip decompression. Concatenated gzip members are
+     * decompressed one after the other.
+     */
+    bool Decompressor::decompressGzip() {
+        z_stream stream;
+        QByteArray input;
+        QByteArray output;
+        qint64 numRead;
+        int produced;
+        int result = Z_OK;
+        bool outputFull = false;
+        bool memberEnded = false;
+
+        memset(&stream, 0, sizeof(stream));
+        // 15 + 32: maximum window size, automatic gzip/zlib header detection.
+        if (inflateInit2(&stream, 15 + 32) != Z_OK)
+            return false;
+
+        input.resize(DECOMPRESSOR_INPUT_SIZE);
+        while (this->stopRequested == 0) {
+            // Only read more input when inflate() has flushed all output
+            // for the input it has already received.
+            if (stream.avail_in == 0 && !outputFull) {
+                numRead = this->file.read(input.data(), DECOMPRESSOR_INPUT_SIZE);
+                if (numRead <= 0)
+                    break;
+                stream.next_in = (Bytef *) input.data();
+                stream.avail_in = numRead;
+            }
+
+            // Another gzip member follows the one that just ended.
+            if (memberEnded) {
+                inflateReset(&stream);
+                memberEnded = false;
+            }
+
+            // The previous output block is owned by the queue now.
+            output = QByteArray();
+            output.resize(DECOMPRESSOR_OUTPUT_SIZE);
+            stream.next_out = (Bytef *) output.data();
+            stream.avail_out = DECOMPRESSOR_OUTPUT_SIZE;
+
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                qWarning("Could not decompress '%s': %s.", qPrintable(this->file.fileName()), stream.msg ? stream.msg : "corrupt data");
+                inflateEnd(&stream);
+                return false;
+            }
+            memberEnded = (result == Z_STREAM_END);
+
+            produced = DECOMPRESSOR_OUTPUT_SIZE - stream.avail_out;
+            outputFull = (stream.avail_out == 0 && !memberEnded);
+            if (produced > 0) {
+                output.resize(produced);
+                if (!this->queue->put(output))
+                    break;
+            }
+        }
+
+        inflateEnd(&stream);
+
+        if (this->stopRequested == 0 && !memberEnded) {
+            qWarning("Could not decompress '%s': the file is truncated.", qPrintable(this->file.fileName()));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Block-parallel BGZF decompression: batches of BGZF blocks are read and
+     * decompressed concurrently (by using QtConcurrent), after which their
+     * contents are queued in file order.
+     */
+    bool Decompressor::decompressBGZF() {
+        QList<BGZFBlock> batch;
+        BGZFBlock block;
+        QByteArray output;
+        int size;
+        bool endOfFile = false;
+
+        while (!endOfFile && this->stopRequested == 0) {
+            batch.clear();
+            while (batch.size() < DECOMPRESSOR_BGZF_BATCH_SIZE && !endOfFile) {
+                if (!this->readBGZFBlock(block.compressed))
+                    return false;
+                if (block.compressed.isEmpty())
+                    endOfFile = true;
+                else
+                    batch.append(block);
+            }
+
+            QtConcurrent::blockingMap(batch, Decompressor::inflateBGZFBlock);
+
+            size = 0;
+            foreach (const BGZFBlock & inflated, batch) {
+                if (!inflated.valid) {
+                    qWarning("Could not decompress '%s': corrupt BGZF block.", qPrintable(this->file.fileName()));
+                    return false;
+                }
+                size += inflated.data.size();
+            }
+
+            output = QByteArray();
+            output.reserve(size);
+            foreach (const BGZFBlock & inflated, batch)
+                output.append(inflated.data);
+
+            if (!output.isEmpty() && !this->queue->put(output))
+                break;
+        }
+
+        return true;
+    }
+
+#ifdef HAVE_ZSTD
+    /**
+     * Streaming zstd decompression. Multiple frames are handled transparently
+     * by the zstd streaming API.
+     */
+    bool Decompressor::decompressZstd() {
+        ZSTD_DStream * stream;
+        ZSTD_inBuffer in;
+        ZSTD_outBuffer out;
+        QByteArray input;
+        QByteArray output;
+        qint64 numRead;
+        size_t result = 0;
+
+        stream = ZSTD_createDStream();
+        if (stream == NULL)
+            return false;
+        ZSTD_initDStream(stream);
+
+        input.resize(DECOMPRESSOR_INPUT_SIZE);
+        while (this->stopRequested == 0) {
+            numRead = this->file.read(input.data(), DECOMPRESSOR_INPUT_SIZE);
+            if (numRead <= 0)
+                break;
+            in.src = input.constData();
+            in.size = numRead;
+            in.pos = 0;
+
+            // Keep calling ZSTD_decompressStream() as long as there is input
+            // left, or as long as it fills the entire output block.
+            do {
+                output = QByteArray();
+                output.resize(DECOMPRESSOR_OUTPUT_SIZE);
+                out.dst = output.data();
+                out.size = DECOMPRESSOR_OUTPUT_SIZE;
+                out.pos = 0;
+
+                result = ZSTD_decompressStream(stream, &out, &in);
+                if (ZSTD_isError(result)) {
+                    qWarning("Could not decompress '%s': %s.", qPrintable(this->file.fileName()), ZSTD_getErrorName(result));
+                    ZSTD_freeDStream(stream);
+                    return false;
+                }
+
+                if (out.pos > 0) {
+                    output.resize(out.pos);
+                    if (!this->queue->put(output))
+                        break;
+                }
+            } while ((in.pos < in.size || out.pos == out.size) && this->stopRequested == 0);
+        }
+
+        ZSTD_freeDStream(stream);
+
+        // A result of 0 means that the last frame was completely decoded.
+        if (this->stopRequested == 0 && result != 0) {
+            qWarning("Could not decompress '%s': the file is truncated.", qPrintable(this->file.fileName()));
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    /**
+     * Read the next BGZF block.
+     *
+     * @param block
+     *   The complete block (i.e. gzip member), or an empty byte array when
+     *   the end of the file has been reached.
+     * @return
+     *   false if the block is invalid or truncated, true otherwise.
+     */
+    bool Decompressor::readBGZFBlock(QByteArray & block) {
+        quint16 extraLength;
+        quint16 blockSize;
+        int remaining;
+
+        block = this->file.read(GZIP_HEADER_SIZE);
+        if (block.isEmpty())
+            return true;
+
+        if (block.size() < GZIP_HEADER_SIZE
+            || (quint8) block[0] != 0x1f || (quint8) block[1] != 0x8b
+            || !(block[3] & GZIP_FLAG_EXTRA))
+        {
+            qWarning("Could not decompress '%s': invalid BGZF block header.", qPrintable(this->file.fileName()));
+            return false;
+        }
+
+        extraLength = readLittleEndian16(block.constData() + 10);
+        block.append(this->file.read(extraLength));
+        if (block.size() != GZIP_HEADER_SIZE + extraLength
+            || !findBGZFBlockSize(block.constData() + GZIP_HEADER_SIZE, extraLength, blockSize))
+        {
+            qWarning("Could not decompress '%s': invalid BGZF block header.", qPrintable(this->file.fileName()));
+            return false;
+        }
+
+        remaining = (int) blockSize + 1 - block.size();
+        if (remaining < GZIP_TRAILER_SIZE) {
+            qWarning("Could not decompress '%s': invalid BGZF block size.", qPrintable(this->file.fileName()));
+            return false;
+        }
+        block.append(this->file.read(remaining));
+        if (block.size() != (int) blockSize + 1) {
+            qWarning("Could not decompress '%s': the file is truncated.", qPrintable(this->file.fileName()));
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Decompress a single BGZF block and verify its CRC32.
+     */
+    void Decompressor::inflateBGZFBlock(BGZFBlock & block) {
+        const char * compressed = block.compressed.constData();
+        int extraLength = readLittleEndian16(compressed + 10);
+        int payloadOffset = GZIP_HEADER_SIZE + extraLength;
+        int payloadSize = block.compressed.size() - payloadOffset - GZIP_TRAILER_SIZE;
+        quint32 crc = readLittleEndian32(compressed + block.compressed.size() - GZIP_TRAILER_SIZE);
+        quint32 size = readLittleEndian32(compressed + block.compressed.size() - 4);
+        z_stream stream;
+        int result;
+
+        block.valid = false;
+
+        // Don't trust ISIZE before allocating: a corrupt block could
+        // otherwise make us allocate (or, once converted to an int,
+        // overflow) a huge buffer.
+        if (size > BGZF_MAX_BLOCK_SIZE) {
+            block.compressed = QByteArray();
+            return;
+        }
+        block.data.resize(size);
+
+        memset(&stream, 0, sizeof(stream));
+        // Negative window size: raw deflate data, without a header.
+        if (inflateInit2(&stream, -15) != Z_OK)
+            return;
+        stream.next_in = (Bytef *) compressed + payloadOffset;
+        stream.avail_in = payloadSize;
+        stream.next_out = (Bytef *) block.data.data();
+        stream.avail_out = size;
+        result = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+
+        block.valid = (result == Z_STREAM_END)
+                      && stream.total_out == size
+                      && crc32(0, (const Bytef *) block.data.constData(), size) == crc;
+        block.compressed = QByteArray();
+    }
+
+
+    //---------------------------------------------------------------------------
+    // CompressedLogReader public methods.
+
+    CompressedLogReader::CompressedLogReader() : queue(DECOMPRESSOR_QUEUE_CAPACITY) {
+        this->decompressor     = NULL;
+        this->position         = 0;
+        this->numBufferedLines = 0;
+        this->endOfStream      = true;
+    }
+
+    CompressedLogReader::~CompressedLogReader() {
+        this->close();
+    }
+
+    /**
+     * Detect the compression format of a file, based on its magic bytes
+     * rather than on its extension.
+     */
+    CompressionFormat CompressedLogReader::detectFormat(const QString & fileName) {
+        QFile file(fileName);
+        QByteArray header;
+        quint16 blockSize;
+
+        if (!file.open(QIODevice::ReadOnly))
+            return COMPRESSION_NONE;
+        header = file.read(GZIP_HEADER_SIZE + 6);
+        file.close();
+
+        if (header.size() >= 4
+            && (quint8) header[0] == 0x28 && (quint8) header[1] == 0xb5
+            && (quint8) header[2] == 0x2f && (quint8) header[3] == 0xfd)
+            return COMPRESSION_ZSTD;
+
+        if (header.size() >= 2 && (quint8) header[0] == 0x1f && (quint8) header[1] == 0x8b) {
+            if (header.size() == GZIP_HEADER_SIZE + 6
+                && (header[3] & GZIP_FLAG_EXTRA)
+                && findBGZFBlockSize(header.constData() + GZIP_HEADER_SIZE, 6, blockSize))
+                return COMPRESSION_BGZF;
+            return COMPRESSION_GZIP;
+        }
+
+        return COMPRESSION_NONE;
+    }
+
+    /**
+     * Open a compressed Episodes log file and start decompressing it on a
+     * separate thread.
+     *
+     * @param fileName
+     *   The full path to a compressed Episodes log file.
+     * @return
+     *   true if the file could be opened and its compression format is
+     *   supported, false otherwise.
+     */
+    bool CompressedLogReader::open(const QString & fileName) {
+        CompressionFormat format;
+
+        this->close();
+
+        format = CompressedLogReader::detectFormat(fileName);
+        if (format == COMPRESSION_NONE)
+            return false;
+#ifndef HAVE_ZSTD
+        if (format == COMPRESSION_ZSTD) {
+            qWarning("Cannot read '%s': built without zstd support.", qPrintable(fileName));
+            return false;
+        }
+#endif
+
+        this->queue.reset();
+        this->decompressor = new Decompressor(&this->queue);
+        if (!this->decompressor->open(fileName, format)) {
+            delete this->decompressor;
+            this->decompressor = NULL;
+            return false;
+        }
+
+        this->buffer.clear();
+        this->position = 0;
+        this->numBufferedLines = 0;
+        this->endOfStream = false;
+        this->decompressor->start();
+
+        return true;
+    }
+
+    void CompressedLogReader::close() {
+        if (this->decompressor != NULL) {
+            this->decompressor->stop();
+            delete this->decompressor;
+            this->decompressor = NULL;
+        }
+
+        this->buffer.clear();
+        this->position         = 0;
+        this->numBufferedLines = 0;
+        this->endOfStream      = true;
+    }
+
+    /**
+     * Read the next chunk of lines.
+     *
+     * Each RawLine points into an internal buffer of decompressed data,
+     * which remains valid until the next call to readChunk() or close().
+     * Line terminators ("\n" or "\r\n") are not included, which matches the
+     * behavior of QTextStream::readLine().
+     *
+     * @param chunk
+     *   The chunk to fill. It is cleared first.
+     * @param maxLines
+     *   The maximum number of lines to read.
+     * @return
+     *   The number of lines that were read.
+     */
+    int CompressedLogReader::readChunk(RawLineChunk & chunk, int maxLines) {
+        QByteArray block;
+        const char * start;
+        const char * end;
+        const char * eol;
+        int length;
+
+        chunk.clear();
+        chunk.reserve(maxLines);
+
+        // Drop the lines that were handed out by the previous call.
+        if (this->position > 0) {
+            this->buffer.remove(0, this->position);
+            this->position = 0;
+        }
+
+        // Buffer enough decompressed data to fill the chunk. Blocks must be
+        // appended before any lines are handed out, since appending may
+        // reallocate the buffer.
+        while (this->numBufferedLines < maxLines && !this->endOfStream) {
+            if (!this->queue.take(block)) {
+                this->endOfStream = true;
+                break;
+            }
+
+            start = block.constData();
+            end = start + block.size();
+            while ((start = (const char *) memchr(start, '\n', end - start)) != NULL) {
+                this->numBufferedLines++;
+                start++;
+            }
+            this->buffer.append(block);
+        }
+
+        end = this->buffer.constData() + this->buffer.size();
+        while (chunk.size() < maxLines && this->position < this->buffer.size()) {
+            start = this->buffer.constData() + this->position;
+            eol = (const char *) memchr(start, '\n', end - start);
+            if (eol == NULL) {
+                // Only the last line of the file may lack a line terminator.
+                if (!this->endOfStream)
+                    break;
+                eol = end;
+            }
+            else
+                this->numBufferedLines--;
+
+            length = eol - start;
+            this->position = qMin(this->position + length + 1, this->buffer.size());
+
+            if (length > 0 && start[length - 1] == '\r')
+                length--;
+
+            chunk.append(RawLine(start, length));
+        }
+
+        return chunk.size();
+    }
+}
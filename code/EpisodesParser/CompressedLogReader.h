@@ -0,0 +1,113 @@
+#ifndef COMPRESSEDLOGREADER_H
+#define COMPRESSEDLOGREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QThread>
+#include <QAtomicInt>
+#include <QtConcurrentMap>
+
+#include "BoundedQueue.h"
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Size of the blocks of compressed data that are read from disk.
+    #define DECOMPRESSOR_INPUT_SIZE (256 * 1024)
+    // Size of the blocks of decompressed data handed over to the parser.
+    #define DECOMPRESSOR_OUTPUT_SIZE (1024 * 1024)
+    // Maximum number of decompressed blocks that may be queued, i.e. how far
+    // decompression may run ahead of parsing.
+    #define DECOMPRESSOR_QUEUE_CAPACITY 8
+    // Number of BGZF blocks (each at most 64 KiB) decompressed in parallel.
+    #define DECOMPRESSOR_BGZF_BATCH_SIZE 64
+
+    enum CompressionFormat {
+        COMPRESSION_NONE,
+        COMPRESSION_GZIP,
+        COMPRESSION_BGZF,
+        COMPRESSION_ZSTD
+    };
+
+    // A single BGZF block, i.e. a complete gzip member.
+    struct BGZFBlock {
+        QByteArray compressed;
+        QByteArray data;
+        bool valid;
+    };
+
+    /**
+     * Decompresses a file on its own thread and puts the decompressed data
+     * in a bounded queue. The queue is closed when the end of the file is
+     * reached or when an error occurs.
+     */
+    class Decompressor : public QThread {
+    public:
+        Decompressor(BoundedQueue<QByteArray> * queue);
+
+        bool open(const QString & fileName, CompressionFormat format);
+        void stop();
+        bool hasFailed() const { return this->failed; }
+
+    protected:
+        void run();
+        bool decompressGzip();
+        bool decompressBGZF();
+#ifdef HAVE_ZSTD
+        bool decompressZstd();
+#endif
+        bool readBGZFBlock(QByteArray & block);
+        static void inflateBGZFBlock(BGZFBlock & block);
+
+        BoundedQueue<QByteArray> * queue;
+        QFile file;
+        CompressionFormat format;
+        QAtomicInt stopRequested;
+        bool failed;
+    };
+
+    /**
+     * Reads lines from a compressed Episodes log file. Offers the same
+     * interface as MappedLogReader, so that Parser can use either one.
+     *
+     * Supported formats:
+     * - gzip, including concatenated gzip members (as produced by e.g.
+     *   "cat a.gz b.gz")
+     * - BGZF (blocked gzip, as produced by bgzip), which is a gzip-compatible
+     *   format that stores the size of each member, so that multiple members
+     *   can be decompressed in parallel
+     * - zstd, when built with CONFIG += zstd
+     */
+    class CompressedLogReader {
+    public:
+        CompressedLogReader();
+        ~CompressedLogReader();
+
+        static CompressionFormat detectFormat(const QString & fileName);
+        static bool isCompressed(const QString & fileName) { return CompressedLogReader::detectFormat(fileName) != COMPRESSION_NONE; }
+
+        bool open(const QString & fileName);
+        void close();
+
+        // Accessors.
+        bool isOpen() const { return this->decompressor != NULL; }
+        bool atEnd() const { return this->endOfStream && this->position >= this->buffer.size(); }
+        bool hasFailed() const { return this->decompressor != NULL && this->decompressor->hasFailed(); }
+
+        int readChunk(RawLineChunk & chunk, int maxLines);
+
+    protected:
+        BoundedQueue<QByteArray> queue;
+        Decompressor * decompressor;
+        QByteArray buffer;
+        int position;
+        int numBufferedLines;
+        bool endOfStream;
+    };
+
+}
+
+#endif // COMPRESSEDLOGREADER_H
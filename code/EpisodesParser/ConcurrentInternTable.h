@@ -0,0 +1,339 @@
+#ifndef CONCURRENTINTERNTABLE_H
+#define CONCURRENTINTERNTABLE_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QHash>
+#include <QString>
+
+#include <limits>
+
+
+namespace EpisodesParser {
+
+    // Keys are stored in segments of doubling sizes: 64, 128, 256, ... 27
+    // segments are sufficient to store 2^32 keys.
+    #define INTERN_TABLE_FIRST_SEGMENT_SIZE 64
+    #define INTERN_TABLE_NUM_SEGMENTS 27
+    #define INTERN_TABLE_INITIAL_CAPACITY 64
+
+    /**
+     * How a ConcurrentInternTable hashes its keys: qHash() by default.
+     */
+    template <typename Key>
+    struct InternTableKeyTraits {
+        static uint hash(const Key & key) { return qHash(key); }
+    };
+
+    /**
+     * QString keys are hashed by the intern table itself (FNV-1a over the
+     * UTF-16 code units) rather than by qHash(), so that the hash of a
+     * Latin-1 byte sequence matches the hash of the equivalent QString.
+     * This allows keys to be looked up without converting them to a QString
+     * first.
+     */
+    template <>
+    struct InternTableKeyTraits<QString> {
+        static uint hash(const QString & key) {
+            const QChar * c = key.unicode();
+            uint h = 2166136261u;
+            for (int i = 0; i < key.length(); i++)
+                h = (h ^ c[i].unicode()) * 16777619u;
+            return h;
+        }
+
+        static uint hash(const char * data, int length) {
+            uint h = 2166136261u;
+            for (int i = 0; i < length; i++)
+                h = (h ^ (uchar) data[i]) * 16777619u;
+            return h;
+        }
+
+        static bool equals(const QString & key, const char * data, int length) {
+            const QChar * c = key.unicode();
+            if (key.length() != length)
+                return false;
+            for (int i = 0; i < length; i++)
+                if (c[i].unicode() != (uchar) data[i])
+                    return false;
+            return true;
+        }
+
+        static QString fromRaw(const char * data, int length) { return QString::fromLatin1(data, length); }
+    };
+
+    /**
+     * Concurrent interning table: maps keys to dense IDs (0, 1, 2, ...) and
+     * IDs back to keys.
+     *
+     * - Looking up an existing key is wait-free: it only probes an open
+     *   addressing hash table, no locks are acquired.
+     * - Mapping an ID back to its key is wait-free as well. Keys are stored
+     *   in segments that never move once allocated, hence references
+     *   returned by value() remain valid for the lifetime of the table.
+     * - Inserting a new key is serialized by a mutex, which is acceptable
+     *   because this happens only once per distinct key.
+     *
+     * A key is always stored before its ID is published in the hash table,
+     * hence any ID that a lookup returns can be mapped back to its key.
+     * When the hash table becomes half full, a new table with twice the
+     * capacity is published. Old tables are only freed when the intern table
+     * itself is destroyed, since concurrent lookups may still be probing
+     * them; this at most doubles the memory used by the hash tables.
+     */
+    template <typename Key, typename ID>
+    class ConcurrentInternTable {
+    public:
+        ConcurrentInternTable();
+        ~ConcurrentInternTable();
+
+        bool lookup(const Key & key, ID & id) const;
+        ID intern(const Key & key);
+        const Key & value(ID id) const;
+
+        // Raw lookups, for keys whose traits can hash and compare them as
+        // bytes: for QString keys, the bytes are Latin-1.
+        bool lookup(const char * data, int length, ID & id) const;
+        ID intern(const char * data, int length);
+
+        bool contains(const Key & key) const { ID id; return this->lookup(key, id); }
+        int size() const { return this->count; }
+
+    protected:
+        // Open addressing hash table with linear probing. Each slot stores
+        // ID + 1, or 0 when it is empty.
+        struct Table {
+            Table(uint capacity) : capacity(capacity), mask(capacity - 1), slots(new QAtomicInt[capacity]) {}
+            ~Table() { delete[] this->slots; }
+
+            uint capacity;
+            uint mask;
+            QAtomicInt * slots;
+        };
+
+        ID insert(const Key & key);
+        static void insertIntoTable(Table * table, uint hash, ID id);
+        static void locate(ID id, int & segment, uint & offset);
+
+        QAtomicPointer<Table> table;
+        QAtomicPointer<Key> segments[INTERN_TABLE_NUM_SEGMENTS];
+        QAtomicInt count;
+        QMutex insertMutex;
+        QList<Table *> retiredTables;
+
+    private:
+        Q_DISABLE_COPY(ConcurrentInternTable)
+    };
+
+
+    //---------------------------------------------------------------------------
+    // Public methods.
+
+    template <typename Key, typename ID>
+    ConcurrentInternTable<Key, ID>::ConcurrentInternTable() {
+        this->table = new Table(INTERN_TABLE_INITIAL_CAPACITY);
+        for (int i = 0; i < INTERN_TABLE_NUM_SEGMENTS; i++)
+            this->segments[i] = NULL;
+        this->count = 0;
+    }
+
+    template <typename Key, typename ID>
+    ConcurrentInternTable<Key, ID>::~ConcurrentInternTable() {
+        delete (Table *) this->table;
+        qDeleteAll(this->retiredTables);
+        for (int i = 0; i < INTERN_TABLE_NUM_SEGMENTS; i++)
+            delete[] (Key *) this->segments[i];
+    }
+
+    /**
+     * Look up the ID of a key. Wait-free.
+     *
+     * @param key
+     *   The key to look up.
+     * @param id
+     *   The ID of the key, only set when true is returned.
+     * @return
+     *   true when the key was found, false otherwise.
+     */
+    template <typename Key, typename ID>
+    bool ConcurrentInternTable<Key, ID>::lookup(const Key & key, ID & id) const {
+        const Table * table = this->table;
+        int slot;
+
+        for (uint i = InternTableKeyTraits<Key>::hash(key) & table->mask; ; i = (i + 1) & table->mask) {
+            slot = table->slots[i];
+            // The load factor never exceeds 0.5, so this always terminates.
+            if (slot == 0)
+                return false;
+            if (this->value((ID) (slot - 1)) == key) {
+                id = (ID) (slot - 1);
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Map a key to its ID. Generate a new ID when necessary.
+     *
+     * @param key
+     *   The key to intern.
+     * @return
+     *   The corresponding ID.
+     */
+    template <typename Key, typename ID>
+    ID ConcurrentInternTable<Key, ID>::intern(const Key & key) {
+        ID id;
+
+        if (this->lookup(key, id))
+            return id;
+
+        return this->insert(key);
+    }
+
+    /**
+     * Look up the ID of a key, given as raw bytes. Wait-free.
+     *
+     * @param data
+     *   The bytes of the key to look up.
+     * @param length
+     *   The number of bytes.
+     * @param id
+     *   The ID of the key, only set when true is returned.
+     * @return
+     *   true when the key was found, false otherwise.
+     */
+    template <typename Key, typename ID>
+    bool ConcurrentInternTable<Key, ID>::lookup(const char * data, int length, ID & id) const {
+        const Table * table = this->table;
+        int slot;
+
+        for (uint i = InternTableKeyTraits<Key>::hash(data, length) & table->mask; ; i = (i + 1) & table->mask) {
+            slot = table->slots[i];
+            if (slot == 0)
+                return false;
+            if (InternTableKeyTraits<Key>::equals(this->value((ID) (slot - 1)), data, length)) {
+                id = (ID) (slot - 1);
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Map a key, given as raw bytes, to its ID. Generate a new ID when
+     * necessary. The key is only converted when it must be inserted.
+     *
+     * @param data
+     *   The bytes of the key to intern.
+     * @param length
+     *   The number of bytes.
+     * @return
+     *   The corresponding ID.
+     */
+    template <typename Key, typename ID>
+    ID ConcurrentInternTable<Key, ID>::intern(const char * data, int length) {
+        ID id;
+
+        if (this->lookup(data, length, id))
+            return id;
+
+        return this->insert(InternTableKeyTraits<Key>::fromRaw(data, length));
+    }
+
+    /**
+     * Map an ID back to its key. Wait-free.
+     *
+     * @param id
+     *   An ID that was returned by lookup() or intern().
+     * @return
+     *   The corresponding key.
+     */
+    template <typename Key, typename ID>
+    const Key & ConcurrentInternTable<Key, ID>::value(ID id) const {
+        int segment;
+        uint offset;
+
+        ConcurrentInternTable<Key, ID>::locate(id, segment, offset);
+        return ((const Key *) this->segments[segment])[offset];
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected methods.
+
+    template <typename Key, typename ID>
+    ID ConcurrentInternTable<Key, ID>::insert(const Key & key) {
+        QMutexLocker locker(&this->insertMutex);
+        Table * table;
+        Table * grownTable;
+        Key * keys;
+        int segment;
+        uint offset;
+        int n;
+        ID id;
+
+        // Another thread may have inserted it in the mean time.
+        if (this->lookup(key, id))
+            return id;
+
+        n = this->count;
+        if ((quint64) n > (quint64) std::numeric_limits<ID>::max())
+            qFatal("Intern table is full: at most %llu distinct keys can be stored.", (quint64) std::numeric_limits<ID>::max() + 1);
+        id = (ID) n;
+
+        // Store the key before its ID is published.
+        ConcurrentInternTable<Key, ID>::locate(id, segment, offset);
+        keys = this->segments[segment];
+        if (keys == NULL) {
+            keys = new Key[INTERN_TABLE_FIRST_SEGMENT_SIZE << segment];
+            this->segments[segment].fetchAndStoreOrdered(keys);
+        }
+        keys[offset] = key;
+
+        // Grow the hash table when it would become more than half full. The
+        // grown table is completely filled before it is published.
+        table = this->table;
+        if (2 * (uint) (n + 1) > table->capacity) {
+            grownTable = new Table(2 * table->capacity);
+            for (int i = 0; i < n; i++)
+                ConcurrentInternTable<Key, ID>::insertIntoTable(grownTable, InternTableKeyTraits<Key>::hash(this->value((ID) i)), (ID) i);
+            this->table.fetchAndStoreOrdered(grownTable);
+            this->retiredTables.append(table);
+            table = grownTable;
+        }
+
+        this->count.fetchAndStoreOrdered(n + 1);
+        ConcurrentInternTable<Key, ID>::insertIntoTable(table, InternTableKeyTraits<Key>::hash(key), id);
+
+        return id;
+    }
+
+    template <typename Key, typename ID>
+    void ConcurrentInternTable<Key, ID>::insertIntoTable(Table * table, uint hash, ID id) {
+        uint i = hash & table->mask;
+        while (table->slots[i] != 0)
+            i = (i + 1) & table->mask;
+        table->slots[i].fetchAndStoreOrdered((int) id + 1);
+    }
+
+    /**
+     * Find the segment and the offset within that segment of an ID.
+     */
+    template <typename Key, typename ID>
+    void ConcurrentInternTable<Key, ID>::locate(ID id, int & segment, uint & offset) {
+        quint64 n = (quint64) id / INTERN_TABLE_FIRST_SEGMENT_SIZE + 1;
+
+        // segment = floor(log2(n))
+        segment = 0;
+        while (n >>= 1)
+            segment++;
+
+        offset = (quint64) id - (quint64) INTERN_TABLE_FIRST_SEGMENT_SIZE * ((Q_UINT64_C(1) << segment) - 1);
+    }
+
+}
+
+#endif // CONCURRENTINTERNTABLE_H
@@ -0,0 +1,237 @@
+#include "DelimiterIndex.h"
+
+#ifdef DELIMITER_INDEX_X86
+#include <immintrin.h>
+#endif
+
+namespace EpisodesParser {
+
+    // Newline, double quote, square brackets, comma and colon.
+    #define DELIMITER_INDEX_IS_DELIMITER(c) ((c) == '\n' || (c) == '"' || (c) == '[' || (c) == ']' || (c) == ',' || (c) == ':')
+
+    // The implementations, indexed by DelimiterIndexImplementation.
+    DelimiterIndex::Kernel DelimiterIndex::kernels[] = {
+        { DELIMITER_INDEX_SCALAR, &DelimiterIndex::buildScalar },
+#ifdef DELIMITER_INDEX_X86
+        { DELIMITER_INDEX_SSE2, &DelimiterIndex::buildSSE2 },
+        { DELIMITER_INDEX_AVX2, &DelimiterIndex::buildAVX2 }
+#endif
+    };
+
+    // The implementation is selected by the first call to build(), unless
+    // one is set explicitly before that. All of this is initialized
+    // statically, hence it doesn't depend on the order of static
+    // initialization. Parser threads may call build() for the first time
+    // concurrently: the kernel is therefore swapped atomically, and only
+    // once by those calls.
+    DelimiterIndex::Kernel DelimiterIndex::detectKernel = { DELIMITER_INDEX_SCALAR, &DelimiterIndex::buildDetect };
+    QBasicAtomicPointer<DelimiterIndex::Kernel> DelimiterIndex::kernel = Q_BASIC_ATOMIC_INITIALIZER(&DelimiterIndex::detectKernel);
+
+    #define D(c) DELIMITER_INDEX_IS_DELIMITER(c)
+    #define D4(c) D(c), D(c + 1), D(c + 2), D(c + 3)
+    #define D16(c) D4(c), D4(c + 4), D4(c + 8), D4(c + 12)
+    const bool DelimiterIndex::delimiterTable[256] = {
+        D16(0),   D16(16),  D16(32),  D16(48),
+        D16(64),  D16(80),  D16(96),  D16(112),
+        D16(128), D16(144), D16(160), D16(176),
+        D16(192), D16(208), D16(224), D16(240)
+    };
+    #undef D16
+    #undef D4
+    #undef D
+
+    //---------------------------------------------------------------------------
+    // Public static methods.
+
+    /**
+     * Get the implementation that build() uses.
+     */
+    DelimiterIndexImplementation DelimiterIndex::getImplementation() {
+        DelimiterIndex::kernel.testAndSetOrdered(&DelimiterIndex::detectKernel, DelimiterIndex::selectKernel(DELIMITER_INDEX_AVX2));
+        return DelimiterIndex::kernel->implementation;
+    }
+
+    /**
+     * Select the implementation that build() uses. When the requested
+     * implementation is not supported by the CPU, the fastest supported
+     * implementation that is slower than the requested one is selected.
+     *
+     * This is intended for tests and benchmarks. It is thread-safe, but
+     * concurrent calls to build() may still use the previous
+     * implementation.
+     *
+     * @param implementation
+     *   The requested implementation.
+     * @return
+     *   true when the requested implementation was selected, false when a
+     *   fallback was selected instead.
+     */
+    bool DelimiterIndex::setImplementation(DelimiterIndexImplementation implementation) {
+        Kernel * selected = DelimiterIndex::selectKernel(implementation);
+
+        DelimiterIndex::kernel.fetchAndStoreOrdered(selected);
+
+        return selected->implementation == implementation;
+    }
+
+    /**
+     * Check whether the CPU supports the given implementation.
+     */
+    bool DelimiterIndex::isSupported(DelimiterIndexImplementation implementation) {
+        switch (implementation) {
+        case DELIMITER_INDEX_SCALAR:
+            return true;
+#ifdef DELIMITER_INDEX_X86
+        case DELIMITER_INDEX_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case DELIMITER_INDEX_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected static methods.
+
+    /**
+     * @return
+     *   The requested implementation, or the fastest supported one that is
+     *   slower, when the CPU doesn't support it.
+     */
+    DelimiterIndex::Kernel * DelimiterIndex::selectKernel(DelimiterIndexImplementation implementation) {
+        while (!DelimiterIndex::isSupported(implementation))
+            implementation = (DelimiterIndexImplementation) (implementation - 1);
+        return &DelimiterIndex::kernels[implementation];
+    }
+
+    /**
+     * Select the fastest implementation that the CPU supports, unless one
+     * has been selected in the mean time, then build.
+     */
+    int DelimiterIndex::buildDetect(const char * data, int length, quint32 * positions, int maxPositions) {
+        DelimiterIndex::kernel.testAndSetOrdered(&DelimiterIndex::detectKernel, DelimiterIndex::selectKernel(DELIMITER_INDEX_AVX2));
+        return DelimiterIndex::kernel->build(data, length, positions, maxPositions);
+    }
+
+    int DelimiterIndex::buildScalar(const char * data, int length, quint32 * positions, int maxPositions) {
+        return DelimiterIndex::buildScalarRange(data, 0, length, positions, 0, maxPositions);
+    }
+
+    /**
+     * Append the positions of the delimiters in data[from, to) to positions,
+     * which already contains count positions.
+     *
+     * @return
+     *   The updated count.
+     */
+    int DelimiterIndex::buildScalarRange(const char * data, int from, int to, quint32 * positions, int count, int maxPositions) {
+        for (int i = from; i < to; i++) {
+            if (DelimiterIndex::delimiterTable[(uchar) data[i]]) {
+                if (count < maxPositions)
+                    positions[count] = i;
+                count++;
+            }
+        }
+        return count;
+    }
+
+#ifdef DELIMITER_INDEX_X86
+    /**
+     * Append the positions of the set bits in mask, relative to offset, to
+     * positions, which already contains count positions.
+     *
+     * @return
+     *   The updated count.
+     */
+    inline int DelimiterIndex::appendPositions(int offset, unsigned int mask, quint32 * positions, int count, int maxPositions) {
+        if (count + DELIMITER_INDEX_MAX_BLOCK_SIZE <= maxPositions) {
+            while (mask != 0) {
+                positions[count++] = offset + __builtin_ctz(mask);
+                mask &= mask - 1;
+            }
+        }
+        else {
+            while (mask != 0) {
+                if (count < maxPositions)
+                    positions[count] = offset + __builtin_ctz(mask);
+                count++;
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Compare 16 bytes at a time against all delimiters and walk the set bits
+     * of the resulting mask.
+     */
+    __attribute__((target("sse2")))
+    int DelimiterIndex::buildSSE2(const char * data, int length, quint32 * positions, int maxPositions) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i quote   = _mm_set1_epi8('"');
+        const __m128i open    = _mm_set1_epi8('[');
+        const __m128i close   = _mm_set1_epi8(']');
+        const __m128i comma   = _mm_set1_epi8(',');
+        const __m128i colon   = _mm_set1_epi8(':');
+        int count = 0;
+        int i;
+        __m128i block, matches;
+        unsigned int mask;
+
+        for (i = 0; i + 16 <= length; i += 16) {
+            block = _mm_loadu_si128((const __m128i *) (data + i));
+            matches = _mm_or_si128(
+                _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, quote)),
+                    _mm_or_si128(_mm_cmpeq_epi8(block, open), _mm_cmpeq_epi8(block, close))
+                ),
+                _mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, colon))
+            );
+            mask = _mm_movemask_epi8(matches);
+
+            count = DelimiterIndex::appendPositions(i, mask, positions, count, maxPositions);
+        }
+
+        return DelimiterIndex::buildScalarRange(data, i, length, positions, count, maxPositions);
+    }
+
+    /**
+     * Compare 32 bytes at a time against all delimiters and walk the set bits
+     * of the resulting mask.
+     */
+    __attribute__((target("avx2")))
+    int DelimiterIndex::buildAVX2(const char * data, int length, quint32 * positions, int maxPositions) {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i quote   = _mm256_set1_epi8('"');
+        const __m256i open    = _mm256_set1_epi8('[');
+        const __m256i close   = _mm256_set1_epi8(']');
+        const __m256i comma   = _mm256_set1_epi8(',');
+        const __m256i colon   = _mm256_set1_epi8(':');
+        int count = 0;
+        int i;
+        __m256i block, matches;
+        unsigned int mask;
+
+        for (i = 0; i + 32 <= length; i += 32) {
+            block = _mm256_loadu_si256((const __m256i *) (data + i));
+            matches = _mm256_or_si256(
+                _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(block, newline), _mm256_cmpeq_epi8(block, quote)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(block, open), _mm256_cmpeq_epi8(block, close))
+                ),
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, comma), _mm256_cmpeq_epi8(block, colon))
+            );
+            mask = (unsigned int) _mm256_movemask_epi8(matches);
+
+            count = DelimiterIndex::appendPositions(i, mask, positions, count, maxPositions);
+        }
+
+        return DelimiterIndex::buildScalarRange(data, i, length, positions, count, maxPositions);
+    }
+#endif
+}
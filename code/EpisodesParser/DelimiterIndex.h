@@ -0,0 +1,89 @@
+#ifndef DELIMITERINDEX_H
+#define DELIMITERINDEX_H
+
+#include <QtGlobal>
+#include <QAtomicPointer>
+
+
+namespace EpisodesParser {
+
+    // SSE2 and AVX2 implementations are available when building with GCC (or
+    // a compatible compiler) for x86; elsewhere, only the scalar one is.
+    #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define DELIMITER_INDEX_X86 1
+    #endif
+
+    // The largest number of bytes that is compared at once (AVX2).
+    #define DELIMITER_INDEX_MAX_BLOCK_SIZE 32
+
+    enum DelimiterIndexImplementation {
+        DELIMITER_INDEX_SCALAR,
+        DELIMITER_INDEX_SSE2,
+        DELIMITER_INDEX_AVX2
+    };
+
+    /**
+     * Finds the positions of all delimiters in a block of Episodes log
+     * bytes in a single pass: newlines, double quotes, square brackets,
+     * commas and colons.
+     *
+     * On x86, 16 (SSE2) or 32 (AVX2) bytes are compared against all
+     * delimiters at once. The fastest implementation that the CPU supports is
+     * chosen at runtime. Elsewhere, a scalar lookup table is used.
+     */
+    class DelimiterIndex {
+    public:
+        static int build(const char * data, int length, quint32 * positions, int maxPositions);
+
+        static DelimiterIndexImplementation getImplementation();
+        static bool setImplementation(DelimiterIndexImplementation implementation);
+        static bool isSupported(DelimiterIndexImplementation implementation);
+        static bool isDelimiter(char c) { return DelimiterIndex::delimiterTable[(uchar) c]; }
+
+    protected:
+        typedef int (*BuildFunction)(const char * data, int length, quint32 * positions, int maxPositions);
+
+        struct Kernel {
+            DelimiterIndexImplementation implementation;
+            BuildFunction build;
+        };
+
+        static Kernel * selectKernel(DelimiterIndexImplementation implementation);
+        static int buildDetect(const char * data, int length, quint32 * positions, int maxPositions);
+        static int buildScalar(const char * data, int length, quint32 * positions, int maxPositions);
+        static int buildScalarRange(const char * data, int from, int to, quint32 * positions, int count, int maxPositions);
+#ifdef DELIMITER_INDEX_X86
+        static int appendPositions(int offset, unsigned int mask, quint32 * positions, int count, int maxPositions);
+        static int buildSSE2(const char * data, int length, quint32 * positions, int maxPositions);
+        static int buildAVX2(const char * data, int length, quint32 * positions, int maxPositions);
+#endif
+
+        static const bool delimiterTable[256];
+        static Kernel kernels[];
+        static Kernel detectKernel;
+        static QBasicAtomicPointer<Kernel> kernel;
+    };
+
+    /**
+     * Find the positions of all delimiters in a block of bytes.
+     *
+     * @param data
+     *   Pointer to the first byte of the block.
+     * @param length
+     *   Length of the block, in bytes.
+     * @param positions
+     *   The offsets (relative to data) of the delimiters, in ascending
+     *   order. Only the first maxPositions are stored.
+     * @param maxPositions
+     *   The capacity of positions.
+     * @return
+     *   The number of delimiters in the block, which may exceed
+     *   maxPositions.
+     */
+    inline int DelimiterIndex::build(const char * data, int length, quint32 * positions, int maxPositions) {
+        return DelimiterIndex::kernel->build(data, length, positions, maxPositions);
+    }
+
+}
+
+#endif // DELIMITERINDEX_H
@@ -4,6 +4,14 @@ namespace EpisodesParser {
     EpisodeDurationDiscretizer::EpisodeDurationDiscretizer() {
     }
 
+    /**
+     * Parse the CSV file that defines the speeds of each episode, and
+     * compile it to threshold arrays.
+     *
+     * Each line has the format
+     *   episodeName,speed1,maxDuration1,speed2,maxDuration2,...,speedN
+     * where the last speed applies to all durations above maxDuration(N-1).
+     */
     bool EpisodeDurationDiscretizer::parseCsvFile(const QString & csvFile) {
         this->csvFile = csvFile;
 
@@ -18,37 +26,111 @@ namespace EpisodesParser {
             EpisodeName episodeName;
             EpisodeSpeed episodeSpeed;
             EpisodeDuration maxDuration;
+            QMap<EpisodeName, QMap<EpisodeDuration, EpisodeSpeed> > speedsPerEpisode;
 
             while (!in.atEnd()) {
                 parts = in.readLine().split(',');
                 episodeName = parts[0];
 
                 // Build the hierarchical map:
-                // EpisodeName -> EpisodeSpeed -> max duration for this speed.
+                // EpisodeName -> max duration for this speed -> EpisodeSpeed.
                 QMap<EpisodeDuration, EpisodeSpeed> map;
-                this->thresholds.insert(episodeName, map);
+                speedsPerEpisode.insert(episodeName, map);
                 for (int i = 1; i < parts.length(); i += 2) {
                     episodeSpeed = parts[i];
                     if (i < parts.length() - 1)
                         maxDuration = parts[i+1].toInt();
                     else
                         maxDuration = -1; // This will automatically map to the highest value supported, right now that is 65535.
-                    this->thresholds[episodeName].insert(maxDuration, episodeSpeed);
+                    speedsPerEpisode[episodeName].insert(maxDuration, episodeSpeed);
+                    if (!this->speeds.contains(episodeSpeed)) {
+                        if (this->speeds.size() == EPISODE_SPEED_UNKNOWN)
+                            qFatal("At most %d distinct episode speeds are supported.", EPISODE_SPEED_UNKNOWN);
+                        this->speeds.append(episodeSpeed);
+                        this->durationItems.append(QString("duration:") + episodeSpeed);
+                    }
                 }
             }
 
+            // Compile the map into one array of (sorted) thresholds per
+            // episode.
+            QMap<EpisodeName, QMap<EpisodeDuration, EpisodeSpeed> >::const_iterator episode;
+            QMap<EpisodeDuration, EpisodeSpeed>::const_iterator threshold;
+            for (episode = speedsPerEpisode.constBegin(); episode != speedsPerEpisode.constEnd(); ++episode) {
+                Thresholds t;
+                for (threshold = episode.value().constBegin(); threshold != episode.value().constEnd(); ++threshold) {
+                    t.maxDurations.append(threshold.key());
+                    t.speeds.append((EpisodeSpeedID) this->speeds.indexOf(threshold.value()));
+                }
+                this->episodeIndices.insert(episode.key(), this->thresholds.size());
+                this->thresholds.append(t);
+            }
+
             return true;
         }
     }
 
+    /**
+     * Map an episode duration to a speed.
+     *
+     * @param name
+     *   Episode name.
+     * @param duration
+     *   Episode duration.
+     * @return
+     *   The corresponding speed, or EPISODE_SPEED_UNKNOWN if it could not be
+     *   determined.
+     */
+    EpisodeSpeedID EpisodeDurationDiscretizer::mapToSpeedID(const EpisodeName & name, EpisodeDuration duration) const {
+        EpisodeSpeedID speed = this->mapToSpeedID(this->getEpisodeIndex(name), duration);
+
+        if (speed == EPISODE_SPEED_UNKNOWN)
+            qCritical("The duration %d for the Episode '%s' could not be mapped to a discretized speed.", duration, qPrintable(name));
+
+        return speed;
+    }
+
+    /**
+     * @return
+     *   The name of a speed, or "unknown" for EPISODE_SPEED_UNKNOWN.
+     */
+    const EpisodeSpeed & EpisodeDurationDiscretizer::getSpeed(EpisodeSpeedID speed) const {
+        static const EpisodeSpeed unknown("unknown");
+
+        if (speed >= this->speeds.size())
+            return unknown;
+        return this->speeds.at(speed);
+    }
+
+    /**
+     * @return
+     *   The "duration:<speed>" association rule item of a speed. The items
+     *   are rendered once, when the CSV file is parsed.
+     */
+    const QString & EpisodeDurationDiscretizer::getDurationItem(EpisodeSpeedID speed) const {
+        static const QString unknown("duration:unknown");
+
+        if (speed >= this->durationItems.size())
+            return unknown;
+        return this->durationItems.at(speed);
+    }
+
     EpisodeSpeed EpisodeDurationDiscretizer::mapToSpeed(const EpisodeName & name, const EpisodeDuration & duration) const {
-        EpisodeDuration maxDuration;
-        foreach (maxDuration, this->thresholds[name].keys()) {
-            if (duration <= maxDuration)
-                return this->thresholds[name][maxDuration];
-        }
+        return this->getSpeed(this->mapToSpeedID(name, duration));
+    }
 
-        qCritical("The duration %d for the Episode '%s' could not be mapped to a discretized speed.", duration, qPrintable(name));
-        return "satisfy the compiler";
+    /**
+     * Map an episode duration to its "duration:<speed>" association rule
+     * item.
+     *
+     * @param name
+     *   Episode name.
+     * @param duration
+     *   Episode duration.
+     * @return
+     *   The corresponding association rule item.
+     */
+    QString EpisodeDurationDiscretizer::mapToDurationItem(const EpisodeName & name, const EpisodeDuration & duration) const {
+        return this->getDurationItem(this->mapToSpeedID(name, duration));
     }
 }
@@ -2,23 +2,78 @@
 #define EPISODEDURATIONDISCRETIZER_H
 
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 #include <QFile>
 #include <QTextStream>
 #include "typedefs.h"
 
 namespace EpisodesParser {
+
+    // Returned for episodes that are not listed in the CSV file.
+    #define EPISODE_SPEED_UNKNOWN 255
+
     class EpisodeDurationDiscretizer {
     public:
         EpisodeDurationDiscretizer();
         bool parseCsvFile(const QString & csvFile);
+
+        int getEpisodeIndex(const EpisodeName & name) const { return this->episodeIndices.value(name, -1); }
+        inline EpisodeSpeedID mapToSpeedID(int episodeIndex, EpisodeDuration duration) const;
+        EpisodeSpeedID mapToSpeedID(const EpisodeName & name, EpisodeDuration duration) const;
+        const EpisodeSpeed & getSpeed(EpisodeSpeedID speed) const;
+        const QString & getDurationItem(EpisodeSpeedID speed) const;
+
         EpisodeSpeed mapToSpeed(const EpisodeName & name, const EpisodeDuration & duration) const;
+        QString mapToDurationItem(const EpisodeName & name, const EpisodeDuration & duration) const;
 
     private:
+        // The thresholds of a single episode, sorted by ascending duration:
+        // a duration maps to the speed of the first threshold it does not
+        // exceed.
+        struct Thresholds {
+            QVector<EpisodeDuration> maxDurations;
+            QVector<EpisodeSpeedID> speeds;
+        };
+
         QString csvFile;
-        QMap<EpisodeName, QMap<EpisodeDuration, EpisodeSpeed> > thresholds;
+        QHash<EpisodeName, int> episodeIndices;
+        QVector<Thresholds> thresholds;
+        QStringList speeds;
+        // Pre-rendered "duration:<speed>" association rule items, one per
+        // speed.
+        QStringList durationItems;
     };
+
+    /**
+     * Map an episode duration to a speed. This is the fast path: no strings
+     * are involved.
+     *
+     * @param episodeIndex
+     *   The index of the episode, as returned by getEpisodeIndex().
+     * @param duration
+     *   Episode duration.
+     * @return
+     *   The corresponding speed, or EPISODE_SPEED_UNKNOWN if the episode is
+     *   unknown.
+     */
+    inline EpisodeSpeedID EpisodeDurationDiscretizer::mapToSpeedID(int episodeIndex, EpisodeDuration duration) const {
+        if (episodeIndex < 0)
+            return EPISODE_SPEED_UNKNOWN;
+
+        const Thresholds & t = this->thresholds.at(episodeIndex);
+        const EpisodeDuration * maxDurations = t.maxDurations.constData();
+        int numThresholds = t.maxDurations.size();
+        for (int i = 0; i < numThresholds; i++) {
+            if (duration <= maxDurations[i])
+                return t.speeds.at(i);
+        }
+
+        return EPISODE_SPEED_UNKNOWN;
+    }
 }
 
 #endif // EPISODEDURATIONDISCRETIZER_H
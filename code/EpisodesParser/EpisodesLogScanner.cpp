@@ -0,0 +1,237 @@
+#include "EpisodesLogScanner.h"
+
+#include <string.h>
+
+namespace EpisodesParser {
+
+    //---------------------------------------------------------------------------
+    // Public static methods.
+
+    /**
+     * Scan a raw Episodes log line into its fields.
+     *
+     * This accepts exactly the lines that were accepted by the regular
+     * expression that was used before:
+     * ((?:\d{1,3}\.){3}\d{1,3}) \[\w+, ([^\]]+)\] "\?ets=([^"]+)" (\d{3}) "([^"]+)" "([^"]+)" "([^"]+)"
+     * with the additional requirements that each IP address octet is <= 255
+     * and that the ets field consists of name:duration pairs only. Anything
+     * following the domain field is ignored.
+     *
+     * @param line
+     *   Pointer to the first byte of the line.
+     * @param length
+     *   Length of the line, in bytes.
+     * @param scanned
+     *   The scanned fields. Only valid when true is returned.
+     * @return
+     *   true when the line is a well-formed Episodes log line, false
+     *   otherwise.
+     */
+    bool EpisodesLogScanner::scan(const char * line, int length, ScannedEpisodesLogLine & scanned) {
+        const char * cursor = line;
+        const char * end = line + length;
+        RawField weekday;
+
+        // IP address.
+        if (!EpisodesLogScanner::scanIPv4(&cursor, end, scanned.ip))
+            return false;
+
+        // Date and time, preceded by the day of the week.
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " ["))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, ',', weekday))
+            return false;
+        for (int i = 0; i < weekday.length; i++) {
+            char c = weekday.data[i];
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+                return false;
+        }
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " "))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, ']', scanned.dateTime))
+            return false;
+
+        // Episodes.
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " \"?ets="))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, '"', scanned.ets))
+            return false;
+        if (!EpisodesLogScanner::scanEpisodes(scanned.ets))
+            return false;
+
+        // HTTP status code: exactly three digits.
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " "))
+            return false;
+        if (end - cursor < 3)
+            return false;
+        scanned.status = 0;
+        for (int i = 0; i < 3; i++, cursor++) {
+            if (*cursor < '0' || *cursor > '9')
+                return false;
+            scanned.status = scanned.status * 10 + (*cursor - '0');
+        }
+
+        // URL, User-Agent and domain name.
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " \""))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, '"', scanned.url))
+            return false;
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " \""))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, '"', scanned.ua))
+            return false;
+        if (!EpisodesLogScanner::scanLiteral(&cursor, end, " \""))
+            return false;
+        if (!EpisodesLogScanner::scanUntil(&cursor, end, '"', scanned.domain))
+            return false;
+
+        return true;
+    }
+
+    /**
+     * Iterate over the episodes in an ets field that was validated by scan().
+     *
+     * @param cursor
+     *   Position in the ets field. Initially the start of the ets field, it
+     *   is advanced past the returned episode.
+     * @param end
+     *   The end of the ets field.
+     * @param name
+     *   The episode name.
+     * @param duration
+     *   The episode duration.
+     * @return
+     *   false when there are no more episodes.
+     */
+    bool EpisodesLogScanner::nextEpisode(const char ** cursor, const char * end, RawField & name, EpisodeDuration & duration) {
+        const char * c = *cursor;
+
+        if (c >= end)
+            return false;
+
+        name.data = c;
+        while (*c != ':')
+            c++;
+        name.length = c - name.data;
+        c++;
+
+        duration = 0;
+        while (c < end && *c != ',') {
+            duration = duration * 10 + (*c - '0');
+            c++;
+        }
+
+        // Skip the comma.
+        *cursor = c + 1;
+
+        return true;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected static methods.
+
+    /**
+     * Scan an IPv4 address in dotted decimal notation.
+     */
+    bool EpisodesLogScanner::scanIPv4(const char ** cursor, const char * end, quint32 & ip) {
+        const char * c = *cursor;
+        uint octet;
+        int digits;
+
+        ip = 0;
+        for (int i = 0; i < 4; i++) {
+            if (i > 0) {
+                if (c >= end || *c != '.')
+                    return false;
+                c++;
+            }
+
+            octet = 0;
+            for (digits = 0; digits < 3 && c < end && *c >= '0' && *c <= '9'; digits++, c++)
+                octet = octet * 10 + (*c - '0');
+            if (digits == 0 || octet > 255)
+                return false;
+
+            ip = (ip << 8) | octet;
+        }
+
+        *cursor = c;
+        return true;
+    }
+
+    /**
+     * Scan a non-empty field up to (but excluding) the given delimiter. The
+     * cursor is advanced past the delimiter.
+     */
+    bool EpisodesLogScanner::scanUntil(const char ** cursor, const char * end, char delimiter, RawField & field) {
+        const char * c = *cursor;
+        const char * d = (const char *) memchr(c, delimiter, end - c);
+
+        if (d == NULL || d == c)
+            return false;
+
+        field.data   = c;
+        field.length = d - c;
+        *cursor = d + 1;
+        return true;
+    }
+
+    /**
+     * Scan a literal string. The cursor is advanced past the literal.
+     */
+    bool EpisodesLogScanner::scanLiteral(const char ** cursor, const char * end, const char * literal) {
+        const char * c = *cursor;
+
+        while (*literal != '\0') {
+            if (c >= end || *c != *literal)
+                return false;
+            c++;
+            literal++;
+        }
+
+        *cursor = c;
+        return true;
+    }
+
+    /**
+     * Validate an ets field: one or more comma-separated name:duration pairs
+     * with non-empty names and durations consisting of digits only.
+     */
+    bool EpisodesLogScanner::scanEpisodes(const RawField & ets) {
+        const char * c = ets.data;
+        const char * end = ets.data + ets.length;
+        const char * start;
+
+        if (c == end)
+            return false;
+
+        while (c < end) {
+            // Name.
+            start = c;
+            while (c < end && *c != ':' && *c != ',')
+                c++;
+            if (c == start || c == end || *c != ':')
+                return false;
+            c++;
+
+            // Duration.
+            start = c;
+            while (c < end && *c >= '0' && *c <= '9')
+                c++;
+            if (c == start || c - start > 9)
+                return false;
+
+            if (c < end) {
+                if (*c != ',')
+                    return false;
+                c++;
+                // Don't allow a trailing comma.
+                if (c == end)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -15,13 +15,46 @@ DEPENDPATH += \
 include("QBrowsCap/QBrowsCap.pri")
 include("QGeoIP/QGeoIP.pri")
 
+# zlib is necessary to read gzip-compressed Episodes log files. zstd support
+# is optional: enable it with CONFIG += zstd.
+LIBS += -lz
+zstd {
+    DEFINES += HAVE_ZSTD
+    LIBS += -lzstd
+}
+
 SOURCES += \
     $${PWD}/Parser.cpp \
+    $${PWD}/ParserContext.cpp \
+    $${PWD}/MappedLogReader.cpp \
+    $${PWD}/CompressedLogReader.cpp \
+    $${PWD}/FollowingLogReader.cpp \
+    $${PWD}/MergedLogReader.cpp \
+    $${PWD}/QuarterReorderBuffer.cpp \
+    $${PWD}/LoadShedder.cpp \
+    $${PWD}/EpisodesLogScanner.cpp \
+    $${PWD}/DelimiterIndex.cpp \
+    $${PWD}/TimestampDecoder.cpp \
+    $${PWD}/EventArchive.cpp \
     $${PWD}/typedefs.cpp \
     EpisodesParser/EpisodeDurationDiscretizer.cpp
 
 HEADERS += \
     $${PWD}/Parser.h \
+    $${PWD}/ParserContext.h \
+    $${PWD}/MappedLogReader.h \
+    $${PWD}/CompressedLogReader.h \
+    $${PWD}/FollowingLogReader.h \
+    $${PWD}/MergedLogReader.h \
+    $${PWD}/QuarterReorderBuffer.h \
+    $${PWD}/LoadShedder.h \
+    $${PWD}/BoundedQueue.h \
+    $${PWD}/EpisodesLogScanner.h \
+    $${PWD}/DelimiterIndex.h \
+    $${PWD}/TimestampDecoder.h \
+    $${PWD}/ConcurrentInternTable.h \
+    $${PWD}/ShardedCache.h \
+    $${PWD}/EventArchive.h \
     $${PWD}/typedefs.h \
     $${PWD}/QCachingLocale/QCachingLocale.h \
     EpisodesParser/EpisodeDurationDiscretizer.h
@@ -0,0 +1,422 @@
+#include "EventArchive.h"
+
+namespace EpisodesParser {
+
+    // Size of the trailer: the footer offset (qint64) plus the magic.
+    #define EVENT_ARCHIVE_TRAILER_SIZE 12
+
+    static quint8 hostByteOrder() {
+        return (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) ? 1 : 0;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // EventArchiveWriter public methods.
+
+    EventArchiveWriter::EventArchiveWriter() {
+        this->footerOffset = -1;
+    }
+
+    EventArchiveWriter::~EventArchiveWriter() {
+        if (this->file.isOpen())
+            this->file.close();
+    }
+
+    /**
+     * Create an event archive.
+     *
+     * @param fileName
+     *   The full path to the archive. An existing file is overwritten.
+     * @return
+     *   true if the file could be created, false otherwise.
+     */
+    bool EventArchiveWriter::open(const QString & fileName) {
+        this->file.setFileName(fileName);
+        if (!this->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+
+        this->stream.setDevice(&this->file);
+        this->stream.setVersion(QDataStream::Qt_4_7);
+        this->stream << (quint32) EVENT_ARCHIVE_MAGIC << (quint32) EVENT_ARCHIVE_VERSION << hostByteOrder();
+
+        this->footerOffset = -1;
+        this->blocks.clear();
+        this->urlIDs.clear();
+        this->urls.clear();
+
+        return this->stream.status() == QDataStream::Ok;
+    }
+
+    /**
+     * Append a block of events, typically a single batch (quarter).
+     *
+     * @param lines
+     *   The events to archive.
+     * @param samplingRate
+     *   The fraction of the batch's events that was kept by load shedding,
+     *   i.e. that lines is a sample of.
+     * @return
+     *   true if the block was written successfully, false otherwise.
+     */
+    bool EventArchiveWriter::writeBlock(const QList<ExpandedEpisodesLogLine> & lines, double samplingRate) {
+        EventArchiveBlock block;
+        EventArchiveBlockData data;
+        quint32 urlID;
+
+        if (lines.isEmpty())
+            return true;
+
+        // Overwrite the footer written by flush(), if any.
+        if (this->footerOffset != -1) {
+            if (!this->file.seek(this->footerOffset))
+                return false;
+            this->footerOffset = -1;
+        }
+
+        block.offset = this->file.pos();
+        block.start = lines.first().time;
+        block.end = lines.first().time;
+        block.numEvents = lines.size();
+
+        data.times.reserve(lines.size());
+        data.locations.reserve(lines.size());
+        data.uas.reserve(lines.size());
+        data.urls.reserve(lines.size());
+        data.statuses.reserve(lines.size());
+        data.numEpisodes.reserve(lines.size());
+        foreach (const ExpandedEpisodesLogLine & line, lines) {
+            block.start = qMin(block.start, line.time);
+            block.end = qMax(block.end, line.time);
+
+            if (!this->urlIDs.contains(line.url)) {
+                urlID = this->urls.size();
+                this->urlIDs.insert(line.url, urlID);
+                this->urls.append(line.url);
+            }
+            else
+                urlID = this->urlIDs.value(line.url);
+
+            data.times.append(line.time);
+            data.locations.append(line.location);
+            data.uas.append(line.ua);
+            data.urls.append(urlID);
+            data.statuses.append(line.status);
+            data.numEpisodes.append(line.episodes.size());
+            foreach (const Episode & episode, line.episodes) {
+                data.episodeIDs.append(episode.id);
+                data.durations.append(episode.duration);
+            }
+        }
+
+        this->stream << block.numEvents << samplingRate;
+        this->writeColumn(data.times);
+        this->writeColumn(data.locations);
+        this->writeColumn(data.uas);
+        this->writeColumn(data.urls);
+        this->writeColumn(data.statuses);
+        this->writeColumn(data.numEpisodes);
+        this->writeColumn(data.episodeIDs);
+        this->writeColumn(data.durations);
+
+        this->blocks.append(block);
+
+        return this->stream.status() == QDataStream::Ok;
+    }
+
+    /**
+     * Write the footer, without closing the archive: it can be read as soon
+     * as this returns, yet more blocks can still be appended, which will
+     * overwrite this footer.
+     *
+     * The dictionaries are passed in at this point (rather than when the
+     * archive is opened) because they grow while parsing.
+     *
+     * @return
+     *   true if the footer was written successfully, false otherwise.
+     */
+    bool EventArchiveWriter::flush(const EpisodeDictionary & episodeDictionary,
+                                   const LocationDictionary & locationDictionary,
+                                   const UAHierarchyDictionary & uaHierarchyDictionary)
+    {
+        if (!this->file.isOpen())
+            return false;
+
+        if (this->footerOffset != -1 && !this->file.seek(this->footerOffset))
+            return false;
+        this->footerOffset = this->file.pos();
+
+        // Dictionaries.
+        this->stream << (quint32) episodeDictionary.size();
+        for (int id = 0; id < episodeDictionary.size(); id++)
+            this->stream << episodeDictionary.value((EpisodeID) id);
+
+        this->stream << (quint32) locationDictionary.size();
+        for (int id = 0; id < locationDictionary.size(); id++) {
+            const Location & location = locationDictionary.value((LocationID) id);
+            this->stream << location.continent << location.country << location.region << location.city << location.isp;
+        }
+
+        this->stream << (quint32) uaHierarchyDictionary.size();
+        for (int id = 0; id < uaHierarchyDictionary.size(); id++) {
+            const UAHierarchyDetails & ua = uaHierarchyDictionary.value((UAHierarchyID) id);
+            this->stream << ua.platform << ua.browser_name << ua.browser_version
+                         << ua.browser_version_major << ua.browser_version_minor << ua.is_mobile;
+        }
+
+        this->stream << this->urls;
+
+        // Block index.
+        this->stream << (quint32) this->blocks.size();
+        foreach (const EventArchiveBlock & block, this->blocks)
+            this->stream << block.offset << block.start << block.end << block.numEvents;
+
+        // Trailer.
+        this->stream << this->footerOffset << (quint32) EVENT_ARCHIVE_MAGIC;
+
+        // A previous footer may have been longer.
+        if (!this->file.resize(this->file.pos()))
+            return false;
+
+        return this->stream.status() == QDataStream::Ok && this->file.flush();
+    }
+
+    /**
+     * Finish the archive by writing the footer and close it.
+     *
+     * @see flush()
+     *
+     * @return
+     *   true if the footer was written successfully, false otherwise.
+     */
+    bool EventArchiveWriter::close(const EpisodeDictionary & episodeDictionary,
+                                   const LocationDictionary & locationDictionary,
+                                   const UAHierarchyDictionary & uaHierarchyDictionary)
+    {
+        bool success;
+
+        if (!this->file.isOpen())
+            return false;
+
+        success = this->flush(episodeDictionary, locationDictionary, uaHierarchyDictionary);
+        this->stream.setDevice(NULL);
+        this->file.close();
+        this->footerOffset = -1;
+
+        return success;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // EventArchiveWriter protected methods.
+
+    template <typename T>
+    void EventArchiveWriter::writeColumn(const QVector<T> & column) {
+        this->stream << (quint32) column.size();
+        this->stream.writeRawData((const char *) column.constData(), column.size() * sizeof(T));
+    }
+
+
+    //---------------------------------------------------------------------------
+    // EventArchiveReader public methods.
+
+    EventArchiveReader::EventArchiveReader() {
+    }
+
+    /**
+     * Open an event archive: read its dictionaries and block index.
+     *
+     * @param fileName
+     *   The full path to the archive.
+     * @return
+     *   true if the archive is valid, false otherwise (e.g. when the archive
+     *   was never closed properly, or was written on a host with a different
+     *   byte order).
+     */
+    bool EventArchiveReader::open(const QString & fileName) {
+        quint32 magic, version, count;
+        quint8 byteOrder;
+        qint64 footerOffset;
+
+        this->close();
+
+        this->file.setFileName(fileName);
+        if (!this->file.open(QIODevice::ReadOnly))
+            return false;
+        this->stream.setDevice(&this->file);
+        this->stream.setVersion(QDataStream::Qt_4_7);
+
+        // Header.
+        this->stream >> magic >> version >> byteOrder;
+        if (magic != EVENT_ARCHIVE_MAGIC || version != EVENT_ARCHIVE_VERSION || byteOrder != hostByteOrder()) {
+            this->close();
+            return false;
+        }
+
+        // Trailer.
+        if (this->file.size() < EVENT_ARCHIVE_TRAILER_SIZE || !this->file.seek(this->file.size() - EVENT_ARCHIVE_TRAILER_SIZE)) {
+            this->close();
+            return false;
+        }
+        this->stream >> footerOffset >> magic;
+        if (magic != EVENT_ARCHIVE_MAGIC || !this->file.seek(footerOffset)) {
+            this->close();
+            return false;
+        }
+
+        // Dictionaries.
+        this->stream >> count;
+        for (quint32 i = 0; i < count && this->stream.status() == QDataStream::Ok; i++) {
+            EpisodeName name;
+            this->stream >> name;
+            this->episodeNames.append(name);
+        }
+
+        this->stream >> count;
+        for (quint32 i = 0; i < count && this->stream.status() == QDataStream::Ok; i++) {
+            Location location;
+            this->stream >> location.continent >> location.country >> location.region >> location.city >> location.isp;
+            this->locations.append(location);
+        }
+
+        this->stream >> count;
+        for (quint32 i = 0; i < count && this->stream.status() == QDataStream::Ok; i++) {
+            UAHierarchyDetails ua;
+            this->stream >> ua.platform >> ua.browser_name >> ua.browser_version
+                         >> ua.browser_version_major >> ua.browser_version_minor >> ua.is_mobile;
+            this->uaHierarchies.append(ua);
+        }
+
+        this->stream >> this->urls;
+
+        // Block index.
+        this->stream >> count;
+        for (quint32 i = 0; i < count && this->stream.status() == QDataStream::Ok; i++) {
+            EventArchiveBlock block;
+            this->stream >> block.offset >> block.start >> block.end >> block.numEvents;
+            this->blocks.append(block);
+        }
+
+        if (this->stream.status() != QDataStream::Ok) {
+            this->close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void EventArchiveReader::close() {
+        this->stream.setDevice(NULL);
+        if (this->file.isOpen())
+            this->file.close();
+
+        this->blocks.clear();
+        this->episodeNames.clear();
+        this->locations.clear();
+        this->uaHierarchies.clear();
+        this->urls.clear();
+    }
+
+    /**
+     * Get the blocks that contain events within a time range. Only these
+     * blocks need to be read.
+     *
+     * @param from
+     *   Start of the time range (inclusive).
+     * @param to
+     *   End of the time range (inclusive).
+     * @return
+     *   The blocks that overlap with the time range, in archive order.
+     */
+    QList<EventArchiveBlock> EventArchiveReader::getBlocks(Time from, Time to) const {
+        QList<EventArchiveBlock> blocks;
+
+        foreach (const EventArchiveBlock & block, this->blocks) {
+            if (block.end >= from && block.start <= to)
+                blocks.append(block);
+        }
+
+        return blocks;
+    }
+
+    /**
+     * Read the columns of a block.
+     *
+     * @param block
+     *   A block, as returned by getBlocks().
+     * @param data
+     *   The columns of the block.
+     * @return
+     *   true if the block was read successfully, false otherwise.
+     */
+    bool EventArchiveReader::readBlock(const EventArchiveBlock & block, EventArchiveBlockData & data) {
+        quint32 numEvents;
+
+        if (!this->file.isOpen() || !this->file.seek(block.offset))
+            return false;
+
+        this->stream >> numEvents >> data.samplingRate;
+        if (numEvents != block.numEvents || !(data.samplingRate > 0.0 && data.samplingRate <= 1.0))
+            return false;
+
+        if (!this->readColumn(data.times)
+            || !this->readColumn(data.locations)
+            || !this->readColumn(data.uas)
+            || !this->readColumn(data.urls)
+            || !this->readColumn(data.statuses)
+            || !this->readColumn(data.numEpisodes)
+            || !this->readColumn(data.episodeIDs)
+            || !this->readColumn(data.durations))
+            return false;
+
+        // Validate the columns, so that callers can index the dictionaries
+        // and the flattened episodes without further checks.
+        if ((quint32) data.times.size() != numEvents
+            || data.locations.size() != data.times.size()
+            || data.uas.size() != data.times.size()
+            || data.urls.size() != data.times.size()
+            || data.statuses.size() != data.times.size()
+            || data.numEpisodes.size() != data.times.size()
+            || data.episodeIDs.size() != data.durations.size())
+            return false;
+
+        quint64 numEpisodes = 0;
+        for (int i = 0; i < data.times.size(); i++) {
+            if (data.locations[i] >= (quint32) this->locations.size()
+                || data.uas[i] >= (quint32) this->uaHierarchies.size()
+                || data.urls[i] >= (quint32) this->urls.size())
+                return false;
+            numEpisodes += data.numEpisodes[i];
+        }
+        if (numEpisodes != (quint64) data.episodeIDs.size())
+            return false;
+        foreach (EpisodeID id, data.episodeIDs) {
+            if (id >= (quint32) this->episodeNames.size())
+                return false;
+        }
+
+        return true;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // EventArchiveReader protected methods.
+
+    template <typename T>
+    bool EventArchiveReader::readColumn(QVector<T> & column) {
+        quint32 size;
+        qint64 bytes;
+
+        this->stream >> size;
+        if (this->stream.status() != QDataStream::Ok)
+            return false;
+
+        // Don't trust the size before allocating: a corrupt archive could
+        // otherwise make us allocate up to 4 GiB per column.
+        bytes = (qint64) size * sizeof(T);
+        if (bytes > this->file.size() - this->file.pos() || bytes > INT_MAX)
+            return false;
+
+        column.resize(size);
+        return this->stream.readRawData((char *) column.data(), (int) bytes) == bytes;
+    }
+}
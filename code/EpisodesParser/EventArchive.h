@@ -0,0 +1,121 @@
+#ifndef EVENTARCHIVE_H
+#define EVENTARCHIVE_H
+
+#include <QFile>
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <limits.h>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    #define EVENT_ARCHIVE_MAGIC 0x45504152 // "EPAR"
+    #define EVENT_ARCHIVE_VERSION 3
+
+    /**
+     * Columnar archive of expanded Episodes log lines ("events").
+     *
+     * Layout:
+     * - header: magic, version, byte order
+     * - one block per batch (i.e. per quarter), each consisting of its
+     *   number of events and the sampling rate with which load shedding
+     *   sampled them, followed by one column per field: times, LocationIDs, UAHierarchyIDs, URL IDs,
+     *   HTTP status codes, number of episodes per event, and the flattened
+     *   EpisodeIDs and durations of all events
+     * - footer: the dictionaries (episode names, locations, UA hierarchies,
+     *   URLs) and the block index (offset and time range of each block)
+     * - trailer: the offset of the footer, and the magic again
+     *
+     * Because the dictionaries and the block index are stored in the footer,
+     * a reader can skip straight to the blocks that overlap with the time
+     * range it is interested in. Columns are stored as raw arrays in the
+     * byte order of the host that wrote the archive, so they can be read
+     * with a single read() each.
+     *
+     * The footer can be written while the archive is still open (see
+     * EventArchiveWriter::flush()): the next block then overwrites it, so
+     * that a single archive can span multiple parsing sessions.
+     */
+
+    struct EventArchiveBlock {
+        qint64 offset;
+        Time start;
+        Time end;
+        quint32 numEvents;
+    };
+
+    struct EventArchiveBlockData {
+        double samplingRate;
+        QVector<Time> times;
+        QVector<LocationID> locations;
+        QVector<UAHierarchyID> uas;
+        QVector<quint32> urls;
+        QVector<HTTPStatus> statuses;
+        QVector<quint32> numEpisodes;
+        QVector<EpisodeID> episodeIDs;
+        QVector<EpisodeDuration> durations;
+    };
+
+    class EventArchiveWriter {
+    public:
+        EventArchiveWriter();
+        ~EventArchiveWriter();
+
+        bool open(const QString & fileName);
+        bool isOpen() const { return this->file.isOpen(); }
+        bool writeBlock(const QList<ExpandedEpisodesLogLine> & lines, double samplingRate = 1.0);
+        bool flush(const EpisodeDictionary & episodeDictionary,
+                   const LocationDictionary & locationDictionary,
+                   const UAHierarchyDictionary & uaHierarchyDictionary);
+        bool close(const EpisodeDictionary & episodeDictionary,
+                   const LocationDictionary & locationDictionary,
+                   const UAHierarchyDictionary & uaHierarchyDictionary);
+
+    protected:
+        template <typename T> void writeColumn(const QVector<T> & column);
+
+        QFile file;
+        QDataStream stream;
+        qint64 footerOffset;
+        QList<EventArchiveBlock> blocks;
+        QHash<URL, quint32> urlIDs;
+        QStringList urls;
+    };
+
+    class EventArchiveReader {
+    public:
+        EventArchiveReader();
+
+        bool open(const QString & fileName);
+        void close();
+
+        QList<EventArchiveBlock> getBlocks(Time from, Time to) const;
+        bool readBlock(const EventArchiveBlock & block, EventArchiveBlockData & data);
+
+        // Dictionaries.
+        const QStringList & getEpisodeNames() const { return this->episodeNames; }
+        const QList<Location> & getLocations() const { return this->locations; }
+        const QList<UAHierarchyDetails> & getUAHierarchies() const { return this->uaHierarchies; }
+        const QStringList & getURLs() const { return this->urls; }
+
+    protected:
+        template <typename T> bool readColumn(QVector<T> & column);
+
+        QFile file;
+        QDataStream stream;
+        QList<EventArchiveBlock> blocks;
+        QStringList episodeNames;
+        QList<Location> locations;
+        QList<UAHierarchyDetails> uaHierarchies;
+        QStringList urls;
+    };
+
+}
+
+#endif // EVENTARCHIVE_H
@@ -0,0 +1,197 @@
+#include "FollowingLogReader.h"
+
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+namespace EpisodesParser {
+
+    FollowingLogReader::FollowingLogReader() {
+        this->bufferPosition   = 0;
+        this->numBufferedLines = 0;
+        this->filePosition     = 0;
+        this->device           = 0;
+        this->inode            = 0;
+    }
+
+    FollowingLogReader::~FollowingLogReader() {
+        this->close();
+    }
+
+    /**
+     * Start following an Episodes log file, from its start.
+     *
+     * @param fileName
+     *   The full path to an Episodes log file.
+     * @return
+     *   true if the file could be opened, false otherwise.
+     */
+    bool FollowingLogReader::open(const QString & fileName) {
+        this->close();
+        this->fileName = fileName;
+        return this->reopen();
+    }
+
+    /**
+     * Reopen the followed path, e.g. after it has been rotated. Lines that
+     * have been read from the previous file but not yet returned remain
+     * buffered; this includes a trailing line that is not yet complete,
+     * which is completed by the data of the new file (e.g. when the log
+     * was truncated in the middle of a line being written). Data that has
+     * not yet been read from the previous file is lost, hence it should be
+     * read first.
+     *
+     * @return
+     *   true if the file could be opened, false otherwise.
+     */
+    bool FollowingLogReader::reopen() {
+        if (this->file.isOpen())
+            this->file.close();
+
+        // Drop the lines that were handed out already.
+        this->buffer.remove(0, this->bufferPosition);
+        this->bufferPosition   = 0;
+        this->filePosition     = 0;
+        this->device           = 0;
+        this->inode            = 0;
+
+        // Unbuffered: reads must hit the file every time, to pick up data
+        // that was appended after the end of the file had been reached.
+        this->file.setFileName(this->fileName);
+        if (!this->file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+            return false;
+
+#ifdef Q_OS_UNIX
+        struct stat fileStat;
+        if (fstat(this->file.handle(), &fileStat) == 0) {
+            this->device = fileStat.st_dev;
+            this->inode  = fileStat.st_ino;
+        }
+#endif
+
+        return true;
+    }
+
+    void FollowingLogReader::close() {
+        if (this->file.isOpen())
+            this->file.close();
+
+        this->buffer.clear();
+        this->bufferPosition   = 0;
+        this->numBufferedLines = 0;
+        this->filePosition     = 0;
+    }
+
+    /**
+     * @return
+     *   true if the followed path now refers to another file, or if the file
+     *   has been truncated. false if the path currently does not exist: the
+     *   previous file may have been moved away without having been replaced
+     *   yet.
+     */
+    bool FollowingLogReader::isRotated() const {
+        if (!this->file.isOpen())
+            return false;
+
+#ifdef Q_OS_UNIX
+        struct stat pathStat;
+        if (stat(QFile::encodeName(this->fileName).constData(), &pathStat) != 0)
+            return false;
+        if ((quint64) pathStat.st_dev != this->device || (quint64) pathStat.st_ino != this->inode)
+            return true;
+        return pathStat.st_size < this->filePosition;
+#else
+        QFileInfo fileInfo(this->fileName);
+        return fileInfo.exists() && fileInfo.size() < this->filePosition;
+#endif
+    }
+
+    /**
+     * Read the next chunk of complete lines, which may be empty when no new
+     * lines have been written since the previous call.
+     *
+     * Each RawLine points into an internal buffer, which remains valid until
+     * the next call to readChunk(), reopen() or close(). Line terminators
+     * ("\n" or "\r\n") are not included.
+     *
+     * @param chunk
+     *   The chunk to fill. It is cleared first.
+     * @param maxLines
+     *   The maximum number of lines to read.
+     * @param endOfFile
+     *   Whether no more data will be appended, e.g. before closing the
+     *   reader. A trailing line that is not terminated by a newline is then
+     *   returned as well.
+     * @return
+     *   The number of lines that were read.
+     */
+    int FollowingLogReader::readChunk(RawLineChunk & chunk, int maxLines, bool endOfFile) {
+        QByteArray data;
+        const char * start;
+        const char * end;
+        const char * eol;
+        int length;
+
+        chunk.clear();
+
+        if (!this->file.isOpen())
+            return 0;
+
+        // Drop the lines that were handed out by the previous call.
+        if (this->bufferPosition > 0) {
+            this->buffer.remove(0, this->bufferPosition);
+            this->bufferPosition = 0;
+        }
+
+        // Read whatever has been appended to the file, until there's enough
+        // to fill the chunk. This must happen before any lines are handed
+        // out, since appending may reallocate the buffer.
+        while (this->numBufferedLines < maxLines) {
+            data = this->file.read(FOLLOW_READ_SIZE);
+            if (data.isEmpty())
+                break;
+            this->filePosition += data.size();
+
+            start = data.constData();
+            end = start + data.size();
+            while ((start = (const char *) memchr(start, '\n', end - start)) != NULL) {
+                this->numBufferedLines++;
+                start++;
+            }
+            this->buffer.append(data);
+        }
+
+        chunk.reserve(qMin(maxLines, this->numBufferedLines));
+        end = this->buffer.constData() + this->buffer.size();
+        while (chunk.size() < maxLines && this->numBufferedLines > 0) {
+            start = this->buffer.constData() + this->bufferPosition;
+            eol = (const char *) memchr(start, '\n', end - start);
+            this->numBufferedLines--;
+
+            length = eol - start;
+            this->bufferPosition += length + 1;
+
+            if (length > 0 && start[length - 1] == '\r')
+                length--;
+
+            chunk.append(RawLine(start, length));
+        }
+
+        // The file has ended, hence so has its trailing line.
+        if (endOfFile && chunk.size() < maxLines && this->numBufferedLines == 0 && this->bufferPosition < this->buffer.size()) {
+            start = this->buffer.constData() + this->bufferPosition;
+            length = end - start;
+            this->bufferPosition = this->buffer.size();
+
+            if (start[length - 1] == '\r')
+                length--;
+
+            chunk.append(RawLine(start, length));
+        }
+
+        return chunk.size();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FOLLOWINGLOGREADER_H
+#define FOLLOWINGLOGREADER_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QByteArray>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Maximum number of bytes read from the followed file at once.
+    #define FOLLOW_READ_SIZE (1024 * 1024)
+
+    /**
+     * Reads lines from an Episodes log file that is still being written to,
+     * similar to "tail -F". Offers the same interface as MappedLogReader.
+     *
+     * readChunk() returns only complete lines: a line that is still being
+     * written (i.e. that is not yet terminated by a newline) remains
+     * buffered, also across reopen(), and is returned by a later call once
+     * it is complete. When the file has ended for good, readChunk() can be
+     * told so, to also return such a trailing line.
+     *
+     * Log rotation is detected by isRotated(): either the path now refers to
+     * another file (a different inode, e.g. after the log was renamed and
+     * recreated), or the file was truncated (e.g. "copytruncate" rotation).
+     */
+    class FollowingLogReader {
+    public:
+        FollowingLogReader();
+        ~FollowingLogReader();
+
+        bool open(const QString & fileName);
+        bool reopen();
+        void close();
+
+        // Accessors.
+        bool isOpen() const { return this->file.isOpen(); }
+        bool isRotated() const;
+        const QString & getFileName() const { return this->fileName; }
+        qint64 getPosition() const { return qMax((qint64) 0, this->filePosition - (this->buffer.size() - this->bufferPosition)); }
+
+        int readChunk(RawLineChunk & chunk, int maxLines, bool endOfFile = false);
+
+    protected:
+        QString fileName;
+        QFile file;
+        QByteArray buffer;
+        int bufferPosition;
+        int numBufferedLines;
+        qint64 filePosition;
+        quint64 device;
+        quint64 inode;
+    };
+
+}
+
+#endif // FOLLOWINGLOGREADER_H
@@ -0,0 +1,65 @@
+#include "LoadShedder.h"
+
+namespace EpisodesParser {
+
+    LoadShedder::LoadShedder(uint maxEventsPerQuarter, quint32 seed) {
+        this->maxEventsPerQuarter = maxEventsPerQuarter;
+        // xorshift's state must not be 0.
+        this->state = (seed != 0) ? seed : LOAD_SHEDDING_SEED;
+        this->numShedLines = 0;
+        this->numSampledBatches = 0;
+    }
+
+    /**
+     * Sample a quarter's batch if it contains more page views than the
+     * maximum. The order of the lines that are kept is preserved.
+     *
+     * @param batch
+     *   The lines of a quarter. Replaced by the sample, if sampled.
+     * @return
+     *   The sampling rate: 1 if the batch was left untouched, 1/k if each
+     *   line was kept with probability 1/k.
+     */
+    double LoadShedder::shed(QList<EpisodesLogLine> & batch) {
+        uint numEvents = batch.size();
+        uint k;
+
+        if (!this->isEnabled() || numEvents <= this->maxEventsPerQuarter)
+            return 1.0;
+
+        k = (numEvents + this->maxEventsPerQuarter - 1) / this->maxEventsPerQuarter;
+
+        QList<EpisodesLogLine> sample;
+        sample.reserve(numEvents / k + 1);
+        foreach (const EpisodesLogLine & line, batch) {
+            if (this->nextRandom() % k == 0)
+                sample.append(line);
+        }
+
+        // A batch is never emptied entirely: its time range must be known.
+        // This only happens for tiny maximums and is negligible otherwise.
+        if (sample.isEmpty())
+            sample.append(batch.at(this->nextRandom() % numEvents));
+
+        this->numShedLines += numEvents - sample.size();
+        this->numSampledBatches++;
+        batch = sample;
+
+        return 1.0 / k;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected methods.
+
+    /**
+     * xorshift32: fast, and more than random enough for sampling.
+     */
+    quint32 LoadShedder::nextRandom() {
+        this->state ^= this->state << 13;
+        this->state ^= this->state >> 17;
+        this->state ^= this->state << 5;
+        return this->state;
+    }
+
+}
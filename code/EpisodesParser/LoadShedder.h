@@ -0,0 +1,52 @@
+#ifndef LOADSHEDDER_H
+#define LOADSHEDDER_H
+
+#include <QList>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Default maximum number of page views per quarter above which page
+    // views are sampled. 0 disables load shedding.
+    #define LOAD_SHEDDING_MAX_EVENTS_PER_QUARTER 0
+    // Default seed for the random number generator, which makes sampling
+    // reproducible.
+    #define LOAD_SHEDDING_SEED 2463534242U
+
+    /**
+     * Sheds load during traffic spikes: when a quarter contains more page
+     * views than can be mined within a quarter, only a Bernoulli sample of
+     * them is kept.
+     *
+     * Each page view is kept with probability 1/k, with k the smallest
+     * integer for which the expected sample size does not exceed the maximum
+     * number of page views per quarter. Because k is an integer, weighting
+     * every sampled page view k times yields unbiased (integer) supports.
+     */
+    class LoadShedder {
+    public:
+        LoadShedder(uint maxEventsPerQuarter = LOAD_SHEDDING_MAX_EVENTS_PER_QUARTER, quint32 seed = LOAD_SHEDDING_SEED);
+
+        double shed(QList<EpisodesLogLine> & batch);
+
+        // Accessors.
+        void setMaxEventsPerQuarter(uint maxEventsPerQuarter) { this->maxEventsPerQuarter = maxEventsPerQuarter; }
+        uint getMaxEventsPerQuarter() const { return this->maxEventsPerQuarter; }
+        bool isEnabled() const { return this->maxEventsPerQuarter > 0; }
+        quint64 getNumShedLines() const { return this->numShedLines; }
+        quint64 getNumSampledBatches() const { return this->numSampledBatches; }
+
+    protected:
+        quint32 nextRandom();
+
+        uint maxEventsPerQuarter;
+        quint32 state;
+        quint64 numShedLines;
+        quint64 numSampledBatches;
+    };
+
+}
+
+#endif // LOADSHEDDER_H
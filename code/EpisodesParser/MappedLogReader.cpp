@@ -0,0 +1,115 @@
+#include "MappedLogReader.h"
+
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+namespace EpisodesParser {
+
+    MappedLogReader::MappedLogReader() {
+        this->data     = NULL;
+        this->size     = 0;
+        this->position = 0;
+    }
+
+    MappedLogReader::~MappedLogReader() {
+        this->close();
+    }
+
+    /**
+     * Memory-map an Episodes log file for reading.
+     *
+     * @param fileName
+     *   The full path to an Episodes log file.
+     * @return
+     *   true if the file could be opened and mapped, false otherwise (e.g.
+     *   when the file does not exist, or when the platform does not support
+     *   mapping a file of this size into the address space). The caller
+     *   should then fall back to regular stream-based reading.
+     */
+    bool MappedLogReader::open(const QString & fileName) {
+        this->close();
+
+        this->file.setFileName(fileName);
+        if (!this->file.open(QIODevice::ReadOnly))
+            return false;
+
+        this->size = this->file.size();
+        this->position = 0;
+
+        // Mapping an empty file is impossible, but there's nothing to read
+        // anyway.
+        if (this->size == 0)
+            return true;
+
+        this->data = (const char *) this->file.map(0, this->size);
+        if (this->data == NULL) {
+            this->file.close();
+            this->size = 0;
+            return false;
+        }
+
+#ifdef Q_OS_UNIX
+        // The file is read from start to end exactly once: let the kernel
+        // read ahead aggressively and drop pages once they've been read.
+        madvise((void *) this->data, this->size, MADV_SEQUENTIAL);
+#endif
+
+        return true;
+    }
+
+    void MappedLogReader::close() {
+        if (this->data != NULL)
+            this->file.unmap((uchar *) this->data);
+        if (this->file.isOpen())
+            this->file.close();
+
+        this->data     = NULL;
+        this->size     = 0;
+        this->position = 0;
+    }
+
+    /**
+     * Read the next chunk of lines.
+     *
+     * No bytes are copied: each RawLine points into the mapped file. Line
+     * terminators ("\n" or "\r\n") are not included, which matches the
+     * behavior of QTextStream::readLine().
+     *
+     * @param chunk
+     *   The chunk to fill. It is cleared first.
+     * @param maxLines
+     *   The maximum number of lines to read.
+     * @return
+     *   The number of lines that were read.
+     */
+    int MappedLogReader::readChunk(RawLineChunk & chunk, int maxLines) {
+        const char * start;
+        const char * end;
+        const char * eol;
+        int length;
+
+        chunk.clear();
+        chunk.reserve(maxLines);
+
+        end = this->data + this->size;
+        while (chunk.size() < maxLines && this->position < this->size) {
+            start = this->data + this->position;
+            eol = (const char *) memchr(start, '\n', end - start);
+            if (eol == NULL)
+                eol = end;
+
+            length = eol - start;
+            this->position += length + 1;
+
+            if (length > 0 && start[length - 1] == '\r')
+                length--;
+
+            chunk.append(RawLine(start, length));
+        }
+
+        return chunk.size();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDLOGREADER_H
+#define MAPPEDLOGREADER_H
+
+#include <QFile>
+#include <QString>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    class MappedLogReader {
+    public:
+        MappedLogReader();
+        ~MappedLogReader();
+
+        bool open(const QString & fileName);
+        void close();
+
+        // Accessors.
+        bool isOpen() const { return this->data != NULL; }
+        bool atEnd() const { return this->position >= this->size; }
+        qint64 getSize() const { return this->size; }
+        qint64 getPosition() const { return this->position; }
+
+        int readChunk(RawLineChunk & chunk, int maxLines);
+
+    protected:
+        QFile file;
+        const char * data;
+        qint64 size;
+        qint64 position;
+    };
+
+}
+
+#endif // MAPPEDLOGREADER_H
@@ -0,0 +1,225 @@
+#include "MergedLogReader.h"
+
+#include <QFile>
+
+#include "MappedLogReader.h"
+#include "CompressedLogReader.h"
+
+namespace EpisodesParser {
+
+    //---------------------------------------------------------------------------
+    // LogFileParser public methods.
+
+    LogFileParser::LogFileParser(const QString & fileName, ParserContext * context, BoundedQueue<ParsedChunkSlice> * queue) {
+        this->fileName = fileName;
+        this->context = context;
+        this->queue = queue;
+        this->stopRequested = 0;
+        this->failed = false;
+    }
+
+    /**
+     * Stop parsing and wait for the thread to finish. Any queued chunks are
+     * dropped.
+     */
+    void LogFileParser::stop() {
+        this->stopRequested.fetchAndStoreOrdered(1);
+        this->queue->abort();
+        this->wait();
+    }
+
+
+    //---------------------------------------------------------------------------
+    // LogFileParser protected methods.
+
+    void LogFileParser::run() {
+        if (CompressedLogReader::isCompressed(this->fileName)) {
+            CompressedLogReader reader;
+            this->failed = !this->parseWith(reader) || reader.hasFailed();
+        }
+        else {
+            MappedLogReader reader;
+            this->failed = !this->parseWith(reader);
+        }
+
+        if (this->failed)
+            qWarning("Could not (fully) parse Episodes log file '%s'.", qPrintable(this->fileName));
+
+        this->queue->close();
+    }
+
+    template <typename Reader>
+    bool LogFileParser::parseWith(Reader & reader) {
+        RawLineChunk chunk;
+
+        if (!reader.open(this->fileName))
+            return false;
+
+        // Parse sequentially: files are parsed concurrently already.
+        while (this->stopRequested == 0 && reader.readChunk(chunk, MERGE_CHUNK_SIZE) > 0) {
+            if (!this->queue->put(this->context->mapRawLinesToEpisodesLogLines(chunk)))
+                break;
+        }
+        reader.close();
+
+        return true;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // MergedLogReader public methods.
+
+    MergedLogReader::MergedLogReader() {
+        this->numMalformedLines = 0;
+    }
+
+    MergedLogReader::~MergedLogReader() {
+        this->close();
+    }
+
+    /**
+     * Start parsing the given Episodes log files, each on its own thread.
+     *
+     * @param fileNames
+     *   The full paths to the Episodes log files.
+     * @param context
+     *   The context to map the lines with.
+     * @return
+     *   true if all files exist, false otherwise.
+     */
+    bool MergedLogReader::open(const QStringList & fileNames, ParserContext * context) {
+        Cursor cursor;
+
+        this->close();
+
+        foreach (const QString & fileName, fileNames) {
+            if (!QFile::exists(fileName))
+                return false;
+        }
+
+        for (int i = 0; i < fileNames.size(); i++) {
+            this->queues.append(new BoundedQueue<ParsedChunkSlice>(MERGE_QUEUE_CAPACITY));
+            this->parsers.append(new LogFileParser(fileNames[i], context, this->queues[i]));
+            this->parsers[i]->start();
+        }
+
+        // Fill the heap with the first line of each file.
+        for (int i = 0; i < fileNames.size(); i++) {
+            cursor.source = i;
+            cursor.position = 0;
+            cursor.slice = ParsedChunkSlice();
+            if (this->advance(cursor)) {
+                this->heap.append(cursor);
+                this->siftUp(this->heap.size() - 1);
+            }
+        }
+
+        return true;
+    }
+
+    void MergedLogReader::close() {
+        foreach (LogFileParser * parser, this->parsers)
+            parser->stop();
+        qDeleteAll(this->parsers);
+        qDeleteAll(this->queues);
+        this->parsers.clear();
+        this->queues.clear();
+        this->heap.clear();
+        this->numMalformedLines = 0;
+    }
+
+    /**
+     * Read the next line, in timestamp order across all files.
+     *
+     * @param line
+     *   The next line, only set when true is returned.
+     * @return
+     *   false when all lines of all files have been read.
+     */
+    bool MergedLogReader::readLine(EpisodesLogLine & line) {
+        if (this->heap.isEmpty())
+            return false;
+
+        Cursor & top = this->heap[0];
+        line = top.slice.lines[top.position];
+        top.position++;
+
+        if (top.position == top.slice.lines.size() && !this->advance(top)) {
+            // This file has been read completely.
+            this->heap[0] = this->heap.last();
+            this->heap.remove(this->heap.size() - 1);
+        }
+        if (!this->heap.isEmpty())
+            this->siftDown(0);
+
+        return true;
+    }
+
+    bool MergedLogReader::hasFailed() const {
+        foreach (const LogFileParser * parser, this->parsers) {
+            if (parser->hasFailed())
+                return true;
+        }
+        return false;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // MergedLogReader protected methods.
+
+    /**
+     * Move a cursor to the next (non-empty) chunk of its file, waiting for
+     * it to be parsed if necessary.
+     *
+     * @return
+     *   false if the file has been read completely.
+     */
+    bool MergedLogReader::advance(Cursor & cursor) {
+        do {
+            if (!this->queues[cursor.source]->take(cursor.slice))
+                return false;
+            this->numMalformedLines += cursor.slice.numMalformedLines;
+        } while (cursor.slice.lines.isEmpty());
+
+        cursor.position = 0;
+        return true;
+    }
+
+    bool MergedLogReader::isEarlier(const Cursor & a, const Cursor & b) const {
+        Time timeA = a.slice.lines[a.position].time;
+        Time timeB = b.slice.lines[b.position].time;
+
+        // Ties are broken by file order, which keeps the merge stable.
+        return timeA < timeB || (timeA == timeB && a.source < b.source);
+    }
+
+    void MergedLogReader::siftDown(int i) {
+        int size = this->heap.size();
+        int smallest;
+        int child;
+
+        forever {
+            smallest = i;
+            for (child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++) {
+                if (this->isEarlier(this->heap[child], this->heap[smallest]))
+                    smallest = child;
+            }
+            if (smallest == i)
+                return;
+            qSwap(this->heap[i], this->heap[smallest]);
+            i = smallest;
+        }
+    }
+
+    void MergedLogReader::siftUp(int i) {
+        int parent;
+
+        while (i > 0) {
+            parent = (i - 1) / 2;
+            if (!this->isEarlier(this->heap[i], this->heap[parent]))
+                return;
+            qSwap(this->heap[i], this->heap[parent]);
+            i = parent;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef MERGEDLOGREADER_H
+#define MERGEDLOGREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QThread>
+#include <QAtomicInt>
+
+#include "BoundedQueue.h"
+#include "ParserContext.h"
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Number of lines per parsed chunk that is handed over by each file's
+    // parsing thread.
+    #define MERGE_CHUNK_SIZE 1000
+    // Maximum number of parsed chunks that may be queued per file.
+    #define MERGE_QUEUE_CAPACITY 4
+
+    /**
+     * Reads and parses a single Episodes log file (compressed or not) on its
+     * own thread, and puts the parsed chunks in a bounded queue. The queue
+     * is closed when the end of the file is reached.
+     */
+    class LogFileParser : public QThread {
+    public:
+        LogFileParser(const QString & fileName, ParserContext * context, BoundedQueue<ParsedChunkSlice> * queue);
+
+        void stop();
+        bool hasFailed() const { return this->failed; }
+
+    protected:
+        void run();
+        template <typename Reader> bool parseWith(Reader & reader);
+
+        QString fileName;
+        ParserContext * context;
+        BoundedQueue<ParsedChunkSlice> * queue;
+        QAtomicInt stopRequested;
+        bool failed;
+    };
+
+    /**
+     * Parses multiple Episodes log files concurrently (one thread per file)
+     * and merges their lines by timestamp, i.e. a k-way merge. This allows
+     * for the logs of multiple (load-balanced) web servers to be parsed as a
+     * single stream, without sorting and concatenating them first.
+     *
+     * Each file must be ordered by time (as log files are); lines of
+     * different files with the same timestamp are returned in the order in
+     * which the files were specified.
+     */
+    class MergedLogReader {
+    public:
+        MergedLogReader();
+        ~MergedLogReader();
+
+        bool open(const QStringList & fileNames, ParserContext * context);
+        void close();
+
+        bool readLine(EpisodesLogLine & line);
+
+        // Accessors.
+        quint64 getNumMalformedLines() const { return this->numMalformedLines; }
+        bool hasFailed() const;
+
+    protected:
+        // The current position in the current chunk of a single file.
+        struct Cursor {
+            ParsedChunkSlice slice;
+            int position;
+            int source;
+        };
+
+        bool advance(Cursor & cursor);
+        bool isEarlier(const Cursor & a, const Cursor & b) const;
+        void siftDown(int i);
+        void siftUp(int i);
+
+        QList<BoundedQueue<ParsedChunkSlice> *> queues;
+        QList<LogFileParser *> parsers;
+        // Min-heap of cursors, ordered by the timestamp of their current line.
+        QVector<Cursor> heap;
+        quint64 numMalformedLines;
+    };
+
+}
+
+#endif // MERGEDLOGREADER_H
@@ -1,76 +1,88 @@
 #include "Parser.h"
 
 namespace EpisodesParser {
-    EpisodeNameIDHash Parser::episodeNameIDHash;
-    EpisodeIDNameHash Parser::episodeIDNameHash;
-    DomainNameIDHash Parser::domainNameIDHash;
-    DomainIDNameHash Parser::domainIDNameHash;
-    UAHierarchyDetailsIDHash Parser::uaHierarchyDetailsIDHash;
-    UAHierarchyIDDetailsHash Parser::uaHierarchyIDDetailsHash;
-    LocationToIDHash   Parser::locationToIDHash;
-    LocationFromIDHash Parser::locationFromIDHash;
-    bool Parser::parserHelpersInitialized = false;
-
-    QBrowsCap Parser::browsCap;
-    QGeoIP Parser::geoIP;
-    EpisodeDurationDiscretizer Parser::episodeDiscretizer;
-
-    QMutex Parser::parserHelpersInitMutex;
-    QMutex Parser::episodeHashMutex;
-    QMutex Parser::domainHashMutex;
-    QMutex Parser::uaHierarchyHashMutex;
-    QMutex Parser::mutex_hashAccess_location;
-    QMutex Parser::regExpMutex;
-    QMutex Parser::dateTimeMutex;
-
-    Parser::Parser() {
-        Parser::parserHelpersInitMutex.lock();
-        if (!Parser::parserHelpersInitialized)
+    /**
+     * @param context
+     *   The context to map lines with, which may be shared with other
+     *   parsers. When NULL, the parser creates its own context (which uses
+     *   the helpers that were loaded by initParserHelpers()), hence its
+     *   dictionaries are independent of those of other parsers.
+     */
+    Parser::Parser(ParserContext * context) : batchSlots(PARSER_MAX_PENDING_BATCHES) {
+        this->context = (context != NULL) ? context : new ParserContext();
+        this->ownsContext = (context == NULL);
+        this->maxPendingBatches = PARSER_MAX_PENDING_BATCHES;
+        this->totalStallDuration = 0;
+        this->ingestionMode = INGESTION_MEMORY_MAPPED;
+        this->numMalformedLines = 0;
+        this->geoIPBatchLookups = false;
+        this->followWatcher = NULL;
+        this->followPollTimer = NULL;
+        this->quarterTimer = NULL;
+        this->followBusy = false;
+
+        if (!this->context->getHelpers()->isInitialized())
             qFatal("Call Parser::initParserHelper()  before creating Parser instances.");
-        Parser::parserHelpersInitMutex.unlock();
     }
 
+    Parser::~Parser() {
+        this->closeArchive();
+        if (this->ownsContext)
+            delete this->context;
+    }
+
+    /**
+     * Set the maximum number of batches that may be pending, i.e. that have
+     * been emitted through parsedBatch() without continueParsing() having
+     * been called for them. 1 means that the parser and the receiver of its
+     * batches work in lock-step. Only call this while not parsing.
+     */
+    void Parser::setMaxPendingBatches(int maxPendingBatches) {
+        Q_ASSERT(maxPendingBatches > 0);
+
+        if (maxPendingBatches > this->maxPendingBatches)
+            this->batchSlots.release(maxPendingBatches - this->maxPendingBatches);
+        else if (maxPendingBatches < this->maxPendingBatches)
+            this->batchSlots.acquire(this->maxPendingBatches - maxPendingBatches);
+        this->maxPendingBatches = maxPendingBatches;
+    }
+
+    /**
+     * Set the event archive to write all expanded lines to. Only call this
+     * while not parsing. An archive that is being written is closed first.
+     *
+     * @param fileName
+     *   The full path to the archive, or an empty string to stop archiving.
+     */
+    void Parser::setArchiveFileName(const QString & fileName) {
+        if (fileName != this->archiveFileName)
+            this->closeArchive();
+        this->archiveFileName = fileName;
+    }
+
+    /**
+     * Load the default parser helpers, which are shared by all contexts
+     * that are not given other helpers. Only the first call has any effect.
+     */
     void Parser::initParserHelpers(const QString & browsCapCSV,
                                    const QString & browsCapIndex,
                                    const QString & geoIPCityDB,
                                    const QString & geoIPISPDB,
                                    const QString & episodeDiscretizerCSV)
     {
-        Parser::parserHelpersInitMutex.lock();
-        if (!Parser::parserHelpersInitialized) {
-            // About 1.5 MB of permanent memory consumption.
-            Parser::browsCap.setCsvFile(browsCapCSV);
-            Parser::browsCap.setIndexFile(browsCapIndex);
-            Parser::browsCap.buildIndex();
-
-            // About 25 MB of permanent memory consumption.
-            Parser::geoIP.openDatabases(geoIPCityDB, geoIPISPDB);
-
-            // No significant permanent memory consumption.
-            Parser::episodeDiscretizer.parseCsvFile(episodeDiscretizerCSV);
-
-            Parser::parserHelpersInitialized = true;
-        }
-        Parser::parserHelpersInitMutex.unlock();
+        ParserHelpers::getDefault()->init(browsCapCSV, browsCapIndex, geoIPCityDB, geoIPISPDB, episodeDiscretizerCSV);
     }
 
     /**
-     * Clear parser helpers' caches.
-     *
-     * This clears as many parser helpers' caches as possible:
-     * - QBrowsCap's in-memory cache is cleared
+     * Clear the default parser helpers' caches, i.e. QBrowsCap's in-memory
+     * cache. Each parser clears its own context's GeoIP and User-Agent
+     * lookup caches when it finishes parsing.
      *
      * Call this function whenever the Parser will not be used for long
      * periods of time.
      */
     void Parser::clearParserHelperCaches() {
-        Parser::parserHelpersInitMutex.lock();
-        if (Parser::parserHelpersInitialized) {
-            Parser::browsCap.resetCache();
-
-            Parser::parserHelpersInitialized = false;
-        }
-        Parser::parserHelpersInitMutex.unlock();
+        ParserHelpers::getDefault()->clearCaches();
     }
 
 
@@ -81,9 +93,25 @@ namespace EpisodesParser {
     /**
      * Parse the given Episodes log file.
      *
-     * Emits a signal for every chunk (with CHUNK_SIZE lines). This signal can
-     * then be used to process that chunk. This allows multiple chunks to be
-     * processed in parallel (by using QtConcurrent), if that is desired.
+     * The file is read in chunks of CHUNK_SIZE lines. Each chunk is split
+     * into slices that are mapped to EpisodesLogLines concurrently (by using
+     * QtConcurrent), after which the lines are processed in file order.
+     *
+     * By default, the file is memory-mapped and lines are handed out as
+     * RawLine views into the mapping, which avoids a UTF-16 decode and a
+     * heap allocation per line. If the file cannot be mapped (or when the
+     * ingestion mode is set to INGESTION_TEXT_STREAM), QTextStream is used.
+     *
+     * gzip (including BGZF) and zstd compressed files are read directly:
+     * they are decompressed on a separate thread, concurrently with parsing.
+     *
+     * Malformed lines are skipped; their number is available through
+     * getNumMalformedLines().
+     *
+     * If an archive file name has been set, all expanded lines are also
+     * written to an event archive, which can be replayed later on. The
+     * archive is created by the first parse, parseMerged() or follow() call
+     * of this parser; subsequent calls append to it.
      *
      * @param fileName
      *   The full path to an Episodes log file.
@@ -92,354 +120,444 @@ namespace EpisodesParser {
         // Notify the UI.
         emit parsing(true);
 
-        QFile file;
-        QStringList chunk;
-        int numLines = 0;
+        this->numMalformedLines = 0;
 
-        file.setFileName(fileName);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            // TODO: emit signal indicating parsing failure.
-            return;
-        }
-        else {
-            this->timer.start();
-            QTextStream in(&file);
-            while (!in.atEnd()) {
-                chunk.append(in.readLine());
-                numLines++;
-                if (chunk.size() == CHUNK_SIZE) {
+        this->openArchive();
+
+        MappedLogReader reader;
+        if (CompressedLogReader::isCompressed(fileName)) {
+            CompressedLogReader compressedReader;
+            RawLineChunk chunk;
+
+            if (!compressedReader.open(fileName))
+                qWarning("Could not open compressed Episodes log file '%s'.", qPrintable(fileName));
+            else {
+                this->timer.start();
+                while (compressedReader.readChunk(chunk, CHUNK_SIZE) > 0)
                     this->processParsedChunk(chunk);
-                    chunk.clear();
-                }
+                if (compressedReader.hasFailed())
+                    qWarning("Parsing of '%s' stopped early: it could not be fully decompressed.", qPrintable(fileName));
+                compressedReader.close();
             }
 
-            // Check if we have another chunk (with size < CHUNK_SIZE).
-            if (chunk.size() > 0) {
+            // Notify the UI.
+            emit parsing(false);
+        }
+        else if (this->ingestionMode == INGESTION_MEMORY_MAPPED && reader.open(fileName)) {
+            RawLineChunk chunk;
+
+            this->timer.start();
+            while (reader.readChunk(chunk, CHUNK_SIZE) > 0)
                 this->processParsedChunk(chunk);
-            }
+            reader.close();
 
             // Notify the UI.
             emit parsing(false);
         }
+        else {
+            QFile file;
+            QStringList chunk;
+            int numLines = 0;
+
+            file.setFileName(fileName);
+            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                // TODO: emit signal indicating parsing failure.
+                this->flushArchive();
+                return;
+            }
+            else {
+                this->timer.start();
+                QTextStream in(&file);
+                while (!in.atEnd()) {
+                    chunk.append(in.readLine());
+                    numLines++;
+                    if (chunk.size() == CHUNK_SIZE) {
+                        this->processParsedChunk(chunk);
+                        chunk.clear();
+                    }
+                }
 
-        Parser::clearParserHelperCaches();
-    }
-
-    void Parser::continueParsing() {
-        QMutexLocker(&this->mutex);
-        this->condition.wakeOne();
-    }
+                // Check if we have another chunk (with size < CHUNK_SIZE).
+                if (chunk.size() > 0) {
+                    this->processParsedChunk(chunk);
+                }
 
+                // Notify the UI.
+                emit parsing(false);
+            }
+        }
 
-    //---------------------------------------------------------------------------
-    // Protected methods.
+        this->flushArchive();
+        this->clearCaches();
+    }
 
     /**
-     * Map an episode name to an episode ID. Generate a new ID when necessary.
+     * Parse multiple Episodes log files as a single stream, e.g. the logs of
+     * several load-balanced web servers that cover the same time range.
      *
-     * @param name
-     *   Episode name.
-     * @return
-     *   The corresponding episode ID.
+     * Each file is read and parsed on its own thread. The resulting lines
+     * are merged by timestamp (see MergedLogReader) before they are batched
+     * per quarter, hence each batch contains the lines of all files for that
+     * quarter. Each file must be ordered by time.
      *
-     * Modifies a class variable upon some calls (i.e. when a new key must be
-     * inserted in the QHash), hence we need to use a mutex to ensure thread
-     * safety.
+     * @param fileNames
+     *   The full paths to the Episodes log files, compressed or not.
      */
-    EpisodeID Parser::mapEpisodeNameToID(EpisodeName name) {
-        if (!Parser::episodeNameIDHash.contains(name)) {
-            Parser::episodeHashMutex.lock();
+    void Parser::parseMerged(const QStringList & fileNames) {
+        MergedLogReader reader;
+        EpisodesLogLine line;
+
+        // Notify the UI.
+        emit parsing(true);
 
-            EpisodeID id = Parser::episodeNameIDHash.size();
-            Parser::episodeNameIDHash.insert(name, id);
-            Parser::episodeIDNameHash.insert(id, name);
+        this->numMalformedLines = 0;
 
-            Parser::episodeHashMutex.unlock();
+        if (!reader.open(fileNames, this->context)) {
+            qWarning("Could not open all of the Episodes log files '%s'.", qPrintable(fileNames.join("', '")));
+            emit parsing(false);
+            return;
         }
 
-        return Parser::episodeNameIDHash[name];
+        this->openArchive();
+
+        this->timer.start();
+        while (reader.readLine(line))
+            this->processParsedLine(line);
+        this->numMalformedLines = reader.getNumMalformedLines();
+        // The lines of the other files have been merged nevertheless.
+        if (reader.hasFailed())
+            qWarning("Parsing of '%s' is incomplete: not all of these files could be fully read.", qPrintable(fileNames.join("', '")));
+        reader.close();
+
+        // Notify the UI.
+        emit parsing(false);
+
+        this->flushArchive();
+        this->clearCaches();
     }
 
     /**
-     * Map a domain name to a domain ID. Generate a new ID when necessary.
+     * Replay an event archive that was written while parsing, which is much
+     * faster than parsing the original Episodes log files again: no GeoIP or
+     * browscap lookups are necessary.
      *
-     * @param name
-     *   Domain name.
-     * @return
-     *   The corresponding domain ID.
+     * Emits parsedBatch() for every archived batch, just like parse(),
+     * with the sampling rate of the batch as it was archived.
      *
-     * Modifies a class variable upon some calls (i.e. when a new key must be
-     * inserted in the QHash), hence we need to use a mutex to ensure thread
-     * safety.
+     * @param archiveFileName
+     *   The full path to an event archive.
+     * @param from
+     *   Only replay events that occurred at or after this time.
+     * @param to
+     *   Only replay events that occurred at or before this time.
      */
-    DomainID Parser::mapDomainNameToID(DomainName name) {
-        if (!Parser::domainNameIDHash.contains(name)) {
-            Parser::domainHashMutex.lock();
+    void Parser::replay(const QString & archiveFileName, uint from, uint to) {
+        EventArchiveReader reader;
+        EventArchiveBlockData data;
+        QVector<EpisodeID> episodeIDs;
+        QVector<LocationID> locationIDs;
+        QVector<UAHierarchyID> uaIDs;
+        QList<ExpandedEpisodesLogLine> lines;
+        ExpandedEpisodesLogLine line;
+        int episodeIndex;
 
-            DomainID id = Parser::domainNameIDHash.size();
-            Parser::domainNameIDHash.insert(name, id);
-#ifdef DEBUG
-            Parser::domainIDNameHash.insert(id, name);
-#endif
+        // Notify the UI.
+        emit parsing(true);
+
+        if (!reader.open(archiveFileName)) {
+            qWarning("Could not open event archive '%s'.", qPrintable(archiveFileName));
+            emit parsing(false);
+            return;
+        }
+
+        // The IDs in the archive are only meaningful within the archive:
+        // map them to IDs in the parser's dictionaries.
+        foreach (const EpisodeName & name, reader.getEpisodeNames())
+            episodeIDs.append(this->context->mapEpisodeNameToID(name));
+        foreach (const Location & location, reader.getLocations())
+            locationIDs.append(this->context->mapLocationToID(location));
+        foreach (const UAHierarchyDetails & ua, reader.getUAHierarchies())
+            uaIDs.append(this->context->mapUAHierarchyToID(ua));
+
+        line.locationFromIDHash = &this->context->getLocationDictionary();
+        line.uaHierarchyIDDetailsHash = &this->context->getUAHierarchyDictionary();
+
+        this->timer.start();
+        foreach (const EventArchiveBlock & block, reader.getBlocks(from, to)) {
+            if (!reader.readBlock(block, data)) {
+                qWarning("Event archive '%s' is corrupt.", qPrintable(archiveFileName));
+                break;
+            }
+
+            lines.clear();
+            episodeIndex = 0;
+            for (int i = 0; i < data.times.size(); i++) {
+                line.episodes.clear();
+                for (quint32 e = 0; e < data.numEpisodes[i]; e++, episodeIndex++)
+                    line.episodes.append(Episode(episodeIDs[data.episodeIDs[episodeIndex]], data.durations[episodeIndex]));
+
+                // Blocks may partially overlap with the time range.
+                if (data.times[i] < from || data.times[i] > to)
+                    continue;
+
+                line.time     = data.times[i];
+                line.location = locationIDs[data.locations[i]];
+                line.ua       = uaIDs[data.uas[i]];
+                line.url      = reader.getURLs()[data.urls[i]];
+                line.status   = data.statuses[i];
+                lines.append(line);
+            }
 
-            Parser::domainHashMutex.unlock();
+            if (!lines.isEmpty())
+                this->emitBatch(QtConcurrent::blockingMapped(lines, mapWithContext(this->context, &ParserContext::mapExpandedEpisodesLogLineToTransactions)), lines.size(), lines.first().time, lines.last().time, data.samplingRate);
         }
 
-        return Parser::domainNameIDHash[name];
+        reader.close();
+
+        // Notify the UI.
+        emit parsing(false);
     }
 
     /**
-     * Map a UA hierarchy to a UA hierarchy ID. Generate a new ID when
-     * necessary.
+     * Follow an Episodes log file that is still being written to: parse the
+     * lines it already contains, then keep parsing lines as they are
+     * appended, until stopFollowing() is called. This requires an event
+     * loop in the thread this Parser lives in.
+     *
+     * New lines are picked up as soon as the file system reports a change,
+     * and by polling every FOLLOW_POLL_INTERVAL ms as a fallback. Rotation
+     * of the log file is handled transparently. A quarter is closed (and its
+     * batch is emitted) as soon as the wall clock has passed the end of the
+     * quarter, rather than when the first line of the next quarter arrives.
+     * Lines for a quarter that has already been closed are dropped; their
+     * number is available through getNumLateLines().
      *
-     * @param ua
-     *   UA hierarchy
-     * @return
-     *   The corresponding UA hierarchy ID.
+     * parsing(true) is emitted while lines are being processed, and
+     * parsing(false) when all lines that have been written so far have been
+     * processed.
      *
-     * Modifies a class variable upon some calls (i.e. when a new key must be
-     * inserted in the QHash), hence we need to use a mutex to ensure thread
-     * safety.
+     * @param fileName
+     *   The full path to an Episodes log file.
      */
-    UAHierarchyID Parser::mapUAHierarchyToID(UAHierarchyDetails ua) {
-        if (!Parser::uaHierarchyDetailsIDHash.contains(ua)) {
-            Parser::uaHierarchyHashMutex.lock();
+    void Parser::follow(const QString & fileName) {
+        this->stopFollowing();
 
-            UAHierarchyID id = Parser::uaHierarchyDetailsIDHash.size();
-            Parser::uaHierarchyDetailsIDHash.insert(ua, id);
-            Parser::uaHierarchyIDDetailsHash.insert(id, ua);
+        if (!this->followReader.open(fileName)) {
+            qWarning("Could not open Episodes log file '%s' to follow it.", qPrintable(fileName));
+            return;
+        }
+
+        this->openArchive();
+
+        if (this->followWatcher == NULL) {
+            this->followWatcher = new QFileSystemWatcher(this);
+            connect(this->followWatcher, SIGNAL(fileChanged(QString)), SLOT(readFollowedFile()));
+            connect(this->followWatcher, SIGNAL(directoryChanged(QString)), SLOT(readFollowedFile()));
 
-            Parser::uaHierarchyHashMutex.unlock();
+            this->followPollTimer = new QTimer(this);
+            connect(this->followPollTimer, SIGNAL(timeout()), SLOT(readFollowedFile()));
+
+            this->quarterTimer = new QTimer(this);
+            this->quarterTimer->setSingleShot(true);
+            connect(this->quarterTimer, SIGNAL(timeout()), SLOT(closeQuarter()));
         }
+        // Watch the directory as well, to notice when the log is rotated.
+        this->followWatcher->addPath(fileName);
+        this->followWatcher->addPath(QFileInfo(fileName).absolutePath());
+
+        this->numMalformedLines = 0;
 
-        return Parser::uaHierarchyDetailsIDHash[ua];
+        // Parse the lines that have been written already. If the last of
+        // those belong to a quarter that has ended already, that quarter is
+        // closed immediately.
+        this->followBusy = true;
+        emit parsing(true);
+        this->closeQuarter();
+
+        this->followPollTimer->start(FOLLOW_POLL_INTERVAL);
     }
 
     /**
-     * Map a Location to a Location ID. Generate a new ID when necessary.
-     *
-     * @param location
-     *   Location.
-     * @return
-     *   The corresponding location ID.
-     *
-     * Modifies a class variable upon some calls (i.e. when a new key must be
-     * inserted in the QHash), hence we need to use a mutex to ensure thread
-     * safety.
+     * Stop following the Episodes log file that is being followed, after
+     * parsing the lines that have been written to it so far, including a
+     * last line that is not terminated by a newline.
      */
-    LocationID Parser::mapLocationToID(const Location & location) {
-        if (!Parser::locationToIDHash.contains(location)) {
-            Parser::mutex_hashAccess_location.lock();
+    void Parser::stopFollowing() {
+        RawLineChunk chunk;
 
-            LocationID id = Parser::locationToIDHash.size();
-            Parser::locationToIDHash.insert(location, id);
-            Parser::locationFromIDHash.insert(id, location);
+        if (!this->followReader.isOpen())
+            return;
 
-            Parser::mutex_hashAccess_location.unlock();
-        }
+        this->followPollTimer->stop();
+        this->quarterTimer->stop();
+        if (!this->followWatcher->files().isEmpty())
+            this->followWatcher->removePaths(this->followWatcher->files());
+        if (!this->followWatcher->directories().isEmpty())
+            this->followWatcher->removePaths(this->followWatcher->directories());
 
-        return Parser::locationToIDHash[location];
+        this->readFollowedFile();
+
+        // No more lines will be appended, hence a last line that is not
+        // terminated by a newline is complete, too.
+        while (this->followReader.readChunk(chunk, CHUNK_SIZE, true) > 0)
+            this->processParsedChunk(chunk);
+        this->followReader.close();
+
+        this->flushArchive();
+        this->clearCaches();
     }
 
     /**
-     * Map a line (raw string) to an EpisodesLogLine data structure.
-     *
-     * @param line
-     *   Raw line, as read from the episodes log file.
-     * @return
-     *   Corresponding EpisodesLogLine data structure.
+     * Must be called whenever the receiver of parsedBatch() has finished
+     * processing a batch: this frees a slot for another batch.
      */
-    EpisodesLogLine Parser::mapLineToEpisodesLogLine(const QString & line) {
-        static QDateTime timeConvertor;
-        QStringList list, episodesRaw, episodeParts;
-        QString dateTime;
-        int timezoneOffset;
-        Episode episode;
-        EpisodesLogLine parsedLine;
-
-        Parser::regExpMutex.lock();
-        QRegExp rx("((?:\\d{1,3}\\.){3}\\d{1,3}) \\[\\w+, ([^\\]]+)\\] \\\"\\?ets=([^\\\"]+)\\\" (\\d{3}) \\\"([^\\\"]+)\\\" \\\"([^\\\"]+)\\\" \\\"([^\\\"]+)\\\"");
-        rx.indexIn(line);
-        list = rx.capturedTexts();
-        Parser::regExpMutex.unlock();
-
-        // IP address.
-        parsedLine.ip.setAddress(list[1]);
-
-        // Time.
-        dateTime = list[2].left(20);
-        timezoneOffset = list[2].right(5).left(3).toInt();
-        Parser::dateTimeMutex.lock();
-        timeConvertor = QDateTime::fromString(dateTime, "dd-MMM-yyyy HH:mm:ss");
-        // Mark this QDateTime as one with a certain offset from UTC, and
-        // set that offset.
-        timeConvertor.setTimeSpec(Qt::OffsetFromUTC);
-        timeConvertor.setUtcOffset(timezoneOffset * 3600);
-        // Convert this QDateTime to UTC.
-        timeConvertor = timeConvertor.toUTC();
-        // Store the UTC timestamp.
-        parsedLine.time = timeConvertor.toTime_t();
-        Parser::dateTimeMutex.unlock();
-
-        // Episode names and durations.
-        episodesRaw = list[3].split(',');
-        foreach (QString episodeRaw, episodesRaw) {
-            episodeParts = episodeRaw.split(':');
-
-            episode.id       = Parser::mapEpisodeNameToID(episodeParts[0]);
-            episode.duration = episodeParts[1].toInt();
-#ifdef DEBUG
-            episode.IDNameHash = &Parser::episodeIDNameHash;
-#endif
-            parsedLine.episodes.append(episode);
+    void Parser::continueParsing() {
+        this->batchSlots.release();
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected slots.
+
+    void Parser::processBatch(const QList<EpisodesLogLine> completeBatch) {
+        // During traffic spikes, only a sample of the page views is mapped
+        // and mined: otherwise mining a quarter could take longer than a
+        // quarter, and the pipeline would never catch up again. Shed lines
+        // are not archived either, but the sampling rate is, so that
+        // replaying the archive weighs the sample like parsing did.
+        QList<EpisodesLogLine> batch = completeBatch;
+        double samplingRate = this->loadShedder.shed(batch);
+
+        // GeoIP lookups are serialized anyway, so optionally perform them
+        // up front, in IP address order.
+        if (this->geoIPBatchLookups)
+            this->context->prefetchLocations(batch);
+
+        // Perform the expanding of the EpisodesLogLines and the mapping to
+        // groups of transactions concurrently. The order of the batch is
+        // preserved by blockingMapped(). QGeoIP and QBrowsCap are not
+        // thread-safe, hence the context's helpers serialize access to
+        // them.
+        QList< QList<QStringList> > groupedTransactions;
+        if (this->archiveWriter.isOpen()) {
+            // The expanded lines are archived, hence keep them around.
+            QList<ExpandedEpisodesLogLine> expandedBatch = QtConcurrent::blockingMapped(batch, mapWithContext(this->context, &ParserContext::expandEpisodesLogLine));
+            if (!this->archiveWriter.writeBlock(expandedBatch, samplingRate))
+                qWarning("Could not write to event archive '%s'.", qPrintable(this->archiveFileName));
+            groupedTransactions = QtConcurrent::blockingMapped(expandedBatch, mapWithContext(this->context, &ParserContext::mapExpandedEpisodesLogLineToTransactions));
         }
+        else
+            groupedTransactions = QtConcurrent::blockingMapped(batch, mapWithContext(this->context, &ParserContext::mapEpisodesLogLineToTransactions));
 
-        // HTTP status code.
-        parsedLine.status = list[4].toShort();
+        this->emitBatch(groupedTransactions, batch.size(), completeBatch.first().time, completeBatch.last().time, samplingRate);
+    }
 
-        // URL.
-        parsedLine.url = list[5];
 
-        // User-Agent.
-        parsedLine.ua = list[6];
+    /**
+     * Parse the lines that have been appended to the followed file since it
+     * was last read.
+     */
+    void Parser::readFollowedFile() {
+        if (!this->followReader.isOpen())
+            return;
 
-        // Domain name.
-        parsedLine.domain.id = Parser::mapDomainNameToID(list[7]);
-#ifdef DEBUG
-        parsedLine.domain.IDNameHash = &domainIDNameHash;
-#endif
+        this->readFollowedLines();
 
-#ifdef DEBUG
-        /*
-        parsedLine.episodeIDNameHash = &Parser::episodeIDNameHash;
-        parsedLine.domainIDNameHash = &Parser::domainIDNameHash;
-        qDebug() << parsedLine;
-        */
-#endif
-        return parsedLine;
+        if (this->followBusy) {
+            this->followBusy = false;
+            emit parsing(false);
+        }
     }
 
     /**
-     * Expand an EpisodesLogLine data structure to an ExpandedEpisodesLogLine
-     * data structure, which contains the expanded (hierarchical) versions
-     * of the ip and User Agent values. I.e. these expanded versions provide
-     * a concept hierarchy.
-     *
-     * @param line
-     *   EpisodesLogLine data structure.
-     * return
-     *   Corresponding ExpandedEpisodesLogLine data structure.
+     * Close the current quarter if, according to the wall clock, it has
+     * ended (allowing for FOLLOW_QUARTER_GRACE seconds of lateness).
      */
-    ExpandedEpisodesLogLine Parser::expandEpisodesLogLine(const EpisodesLogLine & line) {
-        ExpandedEpisodesLogLine expandedLine;
-        QGeoIPRecord geoIPRecord;
-        QPair<bool, QBrowsCapRecord> browsCapResult;
-        Location location;
-        UAHierarchyDetails ua;
-
-        // IP address hierarchy.
-        geoIPRecord = Parser::geoIP.recordByAddr(line.ip);
-        location.continent = geoIPRecord.continentCode;
-        location.country   = geoIPRecord.country;
-        location.city      = geoIPRecord.city;
-        location.region    = geoIPRecord.region;
-        location.isp       = geoIPRecord.isp;
-
-        expandedLine.location = Parser::mapLocationToID(location);
-        expandedLine.locationFromIDHash = &Parser::locationFromIDHash;
-
-        // Time.
-        expandedLine.time = line.time;
-
-        // Episode name and durations.
-        // @TODO: discretize to fast/acceptable/slow.
-        expandedLine.episodes = line.episodes;
-
-        // HTTP status code.
-        expandedLine.status = line.status;
-
-        // URL.
-        expandedLine.url = line.url;
-
-        // User-Agent hierarchy.
-        browsCapResult = Parser::browsCap.matchUserAgent(line.ua);
-        ua.platform              = browsCapResult.second.platform;
-        ua.browser_name          = browsCapResult.second.browser_name;
-        ua.browser_version       = browsCapResult.second.browser_version;
-        ua.browser_version_major = browsCapResult.second.browser_version_major;
-        ua.browser_version_minor = browsCapResult.second.browser_version_minor;
-        ua.is_mobile             = browsCapResult.second.is_mobile;
-
-        expandedLine.ua = Parser::mapUAHierarchyToID(ua);
-        expandedLine.uaHierarchyIDDetailsHash = &Parser::uaHierarchyIDDetailsHash;
-
-        return expandedLine;
-    }
+    void Parser::closeQuarter() {
+        Time now;
 
+        if (!this->followReader.isOpen())
+            return;
 
-    ExpandedEpisodesLogLine Parser::mapAndExpandToEpisodesLogLine(const QString & line) {
-        return Parser::expandEpisodesLogLine(Parser::mapLineToEpisodesLogLine(line));
-    }
+        // Process all lines that have been written in the mean time first.
+        this->readFollowedLines();
 
-    QList<QStringList> Parser::mapExpandedEpisodesLogLineToTransactions(const ExpandedEpisodesLogLine & line) {
-        QList<QStringList> transactions;
-        QStringList itemList;
-        itemList << QString("url:") + QString(line.url)
-                 << Parser::locationFromIDHash.value(line.location).generateAssociationRuleItems()
-                 << Parser::uaHierarchyIDDetailsHash.value(line.ua).generateAssociationRuleItems();
-
-        // Only include the HTTP status code in the transaction if it's not a 200 status.
-        // TODO: improve performance of this: by simply omitting this check, the entire process becomes 5% faster!
-        if (line.status != 200)
-            itemList << QString("status:") + QString::number(line.status);
-
-        Episode episode;
-        EpisodeName episodeName;
-        QStringList transaction;
-        foreach (episode, line.episodes) {
-            episodeName = Parser::episodeIDNameHash[episode.id];
-            transaction << QString("episode:") + episodeName
-                        << QString("duration:") + Parser::episodeDiscretizer.mapToSpeed(episodeName, episode.duration)
-                        // Append the shared items.
-                        << itemList;
-            transactions << transaction;
-            transaction.clear();
+        // No more lines are expected for quarters that ended more than
+        // FOLLOW_QUARTER_GRACE seconds ago.
+        now = QDateTime::currentMSecsSinceEpoch() / 1000;
+        this->reorderBuffer.advanceWatermark(now - FOLLOW_QUARTER_GRACE);
+        this->processCompletedQuarters();
+
+        if (this->followBusy) {
+            this->followBusy = false;
+            emit parsing(false);
         }
 
-        return transactions;
+        this->scheduleQuarterClose();
     }
 
 
     //---------------------------------------------------------------------------
-    // Protected slots.
+    // Protected methods.
 
-    void Parser::processBatch(const QList<EpisodesLogLine> batch) {
-        double transactionsPerEvent;
-#ifdef DEBUG
-        uint items = 0;
-#endif
+    void Parser::processParsedChunk(const QStringList & chunk) {
+        QList<QStringList> slices;
+        for (int i = 0; i < chunk.size(); i += CHUNK_SLICE_SIZE)
+            slices << chunk.mid(i, CHUNK_SLICE_SIZE);
 
-        // This 100% concurrent approach fails, because QGeoIP still has
-        // thread-safety issues. Hence, we only do the mapping from a QString
-        // to an EpisodesLogLine concurrently for now.
-        // QtConcurrent::blockingMapped(chunk, Parser::mapAndExpandToEpisodesLogLine);
+        // Perform the mapping from strings to EpisodesLogLines concurrently.
+        this->processParsedSlices(QtConcurrent::blockingMapped(slices, mapWithContext(this->context, &ParserContext::mapStringsToEpisodesLogLines)));
+    }
 
-        // Perform the expanding of the EpisodesLogLines sequentially.
-        // Reason: see above.
-        QList<ExpandedEpisodesLogLine> expandedChunk;
-        EpisodesLogLine line;
-        foreach (line, batch) {
-            expandedChunk << Parser::expandEpisodesLogLine(line);
-        }
+    void Parser::processParsedChunk(const RawLineChunk & chunk) {
+        QList<RawLineChunk> slices;
+        for (int i = 0; i < chunk.size(); i += CHUNK_SLICE_SIZE)
+            slices << chunk.mid(i, CHUNK_SLICE_SIZE);
 
-        // Perform the mapping from ExpandedEpisodesLogLines to groups of
-        // transactions concurrently
-//        QList< QList<QStringList> > groupedTransactions = QtConcurrent::blockingMapped(expandedChunk, Parser::mapExpandedEpisodesLogLineToTransactions);
-        QList< QList<QStringList> > groupedTransactions;
-        ExpandedEpisodesLogLine expLine;
-        foreach (expLine, expandedChunk) {
-            groupedTransactions << Parser::mapExpandedEpisodesLogLineToTransactions(expLine);
+        // Perform the mapping from raw lines to EpisodesLogLines
+        // concurrently.
+        this->processParsedSlices(QtConcurrent::blockingMapped(slices, mapWithContext(this->context, &ParserContext::mapRawLinesToEpisodesLogLines)));
+    }
+
+    /**
+     * Process the slices of a chunk that were mapped concurrently.
+     *
+     * blockingMapped() returns the slices in their original order, hence the
+     * lines are processed in file order and the quarter boundaries are
+     * identical to those of sequential parsing.
+     *
+     * @param slices
+     *   The mapped slices of a chunk, in file order.
+     */
+    void Parser::processParsedSlices(const QList<ParsedChunkSlice> & slices) {
+        foreach (const ParsedChunkSlice & slice, slices) {
+            this->numMalformedLines += slice.numMalformedLines;
+            foreach (const EpisodesLogLine & line, slice.lines)
+                this->processParsedLine(line);
         }
+    }
+
+    /**
+     * Merge the transaction groups of a batch and emit them, after waiting
+     * for a free batch slot if the maximum number of batches is pending.
+     *
+     * @param groupedTransactions
+     *   The transactions of each event in the batch.
+     * @param numEvents
+     *   The number of events in the batch.
+     * @param start
+     *   The time of the first event in the batch.
+     * @param end
+     *   The time of the last event in the batch.
+     * @param samplingRate
+     *   The fraction of the batch's events that was kept by load shedding:
+     *   the receiver must weigh each transaction 1/samplingRate times.
+     */
+    void Parser::emitBatch(const QList< QList<QStringList> > & groupedTransactions, int numEvents, Time start, Time end, double samplingRate) {
+        double transactionsPerEvent;
+#ifdef DEBUG
+        uint items = 0;
+#endif
 
         // Perform the merging of transaction groups into a single list of
         // transactions sequentially (impossible to do concurrently).
@@ -453,10 +571,10 @@ namespace EpisodesParser {
 #endif
         }
 
-        transactionsPerEvent = ((double) transactions.size()) / batch.size();
+        transactionsPerEvent = ((double) transactions.size()) / numEvents;
 
         /*
-        qDebug() << "Processed batch of" << batch.size() << "lines!"
+        qDebug() << "Processed batch of" << numEvents << "lines!"
                  << "Transactions generated:" << transactions.size() << "."
                  << "(" << transactionsPerEvent << "transactions/event)"
 #ifdef DEBUG
@@ -464,55 +582,141 @@ namespace EpisodesParser {
                  << "(" << items << "items in total)"
 #endif
                  << "Events occurred between"
-                 << QDateTime::fromTime_t(batch.first().time).toString("yyyy-MM-dd hh:mm:ss").toStdString().c_str()
+                 << QDateTime::fromTime_t(start).toString("yyyy-MM-dd hh:mm:ss").toStdString().c_str()
                  << "and"
-                 << QDateTime::fromTime_t(batch.last().time).toString("yyyy-MM-dd hh:mm:ss").toStdString().c_str();
+                 << QDateTime::fromTime_t(end).toString("yyyy-MM-dd hh:mm:ss").toStdString().c_str();
     */
-        emit parsedDuration(timer.elapsed());
-        emit parsedBatch(transactions, transactionsPerEvent, batch.first().time, batch.last().time);
-
+        int duration = this->timer.elapsed();
+
+        // Pause the parsing while the maximum number of batches is pending,
+        // i.e. until the receiver has finished processing the oldest one.
+        // This allows parsing to continue while the receiver is processing,
+        // but prevents it from running arbitrarily far ahead.
+        QTime stallTimer;
+        stallTimer.start();
+        this->batchSlots.acquire();
+        int stallDuration = stallTimer.elapsed();
+        this->totalStallDuration += stallDuration;
+
+        emit parsedDuration(duration);
+        emit parsedBatch(transactions, transactionsPerEvent, start, end, samplingRate);
+        emit sampledBatch(start, end, samplingRate);
+        emit pipelineStatus(this->getNumPendingBatches(), stallDuration);
 
-        // Pause the parsing until these transactions have been processed!
-        this->mutex.lock();
-        this->condition.wait(&this->mutex);
         this->timer.start(); // Restart the timer.
-        this->mutex.unlock();
     }
 
+    /**
+     * Create the event archive, if an archive file name has been set and it
+     * has not been created yet. It remains open until this parser is
+     * destroyed or another archive file name is set, so that the events of
+     * all files parsed by this parser end up in a single archive.
+     */
+    void Parser::openArchive() {
+        if (!this->archiveFileName.isEmpty() && !this->archiveWriter.isOpen() && !this->archiveWriter.open(this->archiveFileName))
+            qWarning("Could not create event archive '%s'.", qPrintable(this->archiveFileName));
+    }
 
-    //---------------------------------------------------------------------------
-    // Protected methods.
+    /**
+     * Write the footer of the event archive, if one is being written, so
+     * that it can be replayed while it remains open. Its dictionaries are
+     * those of this parser's context.
+     */
+    void Parser::flushArchive() {
+        if (this->archiveWriter.isOpen() && !this->archiveWriter.flush(this->context->getEpisodeDictionary(), this->context->getLocationDictionary(), this->context->getUAHierarchyDictionary()))
+            qWarning("Could not write to event archive '%s'.", qPrintable(this->archiveFileName));
+    }
 
-    void Parser::processParsedChunk(const QStringList & chunk) {
-        static unsigned int quarterID = 0;
-        static QList<EpisodesLogLine> batch;
+    /**
+     * Close the event archive, if one is being written.
+     */
+    void Parser::closeArchive() {
+        if (this->archiveWriter.isOpen())
+            this->archiveWriter.close(this->context->getEpisodeDictionary(), this->context->getLocationDictionary(), this->context->getUAHierarchyDictionary());
+    }
 
+    /**
+     * Clear the caches that are only useful while parsing: the context's
+     * lookup caches and its helpers' caches.
+     */
+    void Parser::clearCaches() {
+        this->context->clearCaches();
+        this->context->getHelpers()->clearCaches();
+    }
 
-        // Perform the mapping from strings to EpisodesLogLine concurrently.
-//        QList<EpisodesLogLine> mappedChunk = QtConcurrent::blockingMapped(chunk, Parser::mapLineToEpisodesLogLine);
-        QString rawLine;
-        EpisodesLogLine line;
-        foreach (rawLine, chunk) {
-            line = Parser::mapLineToEpisodesLogLine(rawLine);
-
-            // Create a batch for each quarter (900 seconds) and process it.
-            // TRICKY: this also ensures that quarters that have already been
-            // processed are not processed again (if it is attempted to parse
-            // the same file multiple times), plus it forces the user to parse
-            // older files first.
-            // FIXME: if file A does not end with a full quarter, i.e. a file B
-            // contains the remaining episodes of a quarter, these episodes are
-            // ignored. Considering that this only affects quarters, this bug
-            // is ignored for now. It doesn't significantly influence the
-            // results of the data set used for testing this master thesis.
-            if (line.time / 900 > quarterID) {
-                quarterID = line.time / 900;
-                if (!batch.isEmpty())
-                    this->processBatch(batch);
-                batch.clear();
+    void Parser::processParsedLine(const EpisodesLogLine & line) {
+        // Create a batch for each quarter (900 seconds) and process it once
+        // the quarter is complete, i.e. once no more lines for it are
+        // expected. Lines may arrive somewhat out of order, e.g. from slow
+        // beacons, within the reorder buffer's allowed lateness.
+        // TRICKY: this also ensures that quarters that have already been
+        // processed are not processed again (if it is attempted to parse
+        // the same file multiple times), plus it forces the user to parse
+        // older files first. Lines for those quarters are dropped; their
+        // number is available through getNumLateLines().
+        // Note: if file A does not end with a full quarter, i.e. a file B
+        // contains the remaining episodes of a quarter, that quarter remains
+        // buffered until file B is parsed.
+        if (this->reorderBuffer.add(line))
+            this->processCompletedQuarters();
+    }
+
+    /**
+     * Process the batches of all quarters that are complete.
+     */
+    void Parser::processCompletedQuarters() {
+        QList<EpisodesLogLine> batch;
+
+        while (this->reorderBuffer.takeCompletedQuarter(batch)) {
+            if (this->followReader.isOpen() && !this->followBusy) {
+                this->followBusy = true;
+                emit parsing(true);
             }
 
-            batch.append(line);
+            this->processBatch(batch);
         }
     }
+
+    /**
+     * Parse all complete lines that have been appended to the followed
+     * file. When the file has been rotated, the remainder of the old file
+     * is parsed first, then the new file is parsed from its start.
+     */
+    void Parser::readFollowedLines() {
+        RawLineChunk chunk;
+        bool rotated;
+
+        // Check for rotation before reading, so that no lines that are
+        // appended to the old file in the mean time are missed.
+        rotated = this->followReader.isRotated();
+
+        this->timer.start();
+        while (this->followReader.readChunk(chunk, CHUNK_SIZE) > 0)
+            this->processParsedChunk(chunk);
+
+        if (rotated) {
+            if (!this->followReader.reopen()) {
+                qWarning("Could not reopen rotated Episodes log file '%s'.", qPrintable(this->followReader.getFileName()));
+                return;
+            }
+            // The watch on the old file may have been removed.
+            if (!this->followWatcher->files().contains(this->followReader.getFileName()))
+                this->followWatcher->addPath(this->followReader.getFileName());
+
+            while (this->followReader.readChunk(chunk, CHUNK_SIZE) > 0)
+                this->processParsedChunk(chunk);
+        }
+    }
+
+    /**
+     * Schedule closeQuarter() to be called right after the current quarter
+     * (according to the wall clock) has ended.
+     */
+    void Parser::scheduleQuarterClose() {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        qint64 quarterEnd = (((now / 1000 - FOLLOW_QUARTER_GRACE) / 900 + 1) * 900 + FOLLOW_QUARTER_GRACE) * 1000;
+
+        // A small margin, since timers are not exact.
+        this->quarterTimer->start(quarterEnd - now + 100);
+    }
 }
@@ -3,7 +3,6 @@
 
 #include <QObject>
 #include <QFile>
-#include <QRegExp>
 #include <QTextStream>
 #include <QStringList>
 #include <QDateTime>
@@ -12,23 +11,53 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QWaitCondition>
+#include <QSemaphore>
+#include <QFileSystemWatcher>
+#include <QFileInfo>
+#include <QTimer>
 #include <Qtime>
 
-#include "QBrowsCap.h"
-#include "QGeoIP.h"
-#include "EpisodeDurationDiscretizer.h"
+#include <limits.h>
+
+#include "ParserContext.h"
+#include "MappedLogReader.h"
+#include "CompressedLogReader.h"
+#include "FollowingLogReader.h"
+#include "MergedLogReader.h"
+#include "QuarterReorderBuffer.h"
+#include "LoadShedder.h"
+#include "EventArchive.h"
 #include "typedefs.h"
 
 
 namespace EpisodesParser {
 
     #define CHUNK_SIZE 4000
+    // Default maximum number of batches that may have been emitted but not
+    // yet processed by the receiver, i.e. how far parsing may run ahead.
+    #define PARSER_MAX_PENDING_BATCHES 2
+    // Each chunk is split into slices of this many lines, which are then
+    // mapped to EpisodesLogLines concurrently.
+    #define CHUNK_SLICE_SIZE 250
+    // Interval (in ms) at which a followed file is polled for new lines, as a
+    // fallback for when file system notifications are unavailable.
+    #define FOLLOW_POLL_INTERVAL 1000
+    // When following a file, a quarter is closed this many seconds after it
+    // has ended (according to the wall clock), to allow for lines that are
+    // written slightly late.
+    #define FOLLOW_QUARTER_GRACE 2
+
+    enum IngestionMode {
+        INGESTION_MEMORY_MAPPED,
+        INGESTION_TEXT_STREAM
+    };
 
     class Parser : public QObject {
         Q_OBJECT
 
     public:
-        Parser();
+        Parser(ParserContext * context = NULL);
+        ~Parser();
         static void initParserHelpers(const QString & browsCapCSV,
                                       const QString & browsCapIndex,
                                       const QString & geoIPCityDB,
@@ -36,61 +65,87 @@ namespace EpisodesParser {
                                       const QString & episodeDiscretizerCSV);
         static void clearParserHelperCaches();
 
-        // Processing logic.
-        static EpisodesLogLine mapLineToEpisodesLogLine(const QString & line);
-        static ExpandedEpisodesLogLine expandEpisodesLogLine(const EpisodesLogLine & line);
-        static ExpandedEpisodesLogLine mapAndExpandToEpisodesLogLine(const QString & line);
-        static QList<QStringList> mapExpandedEpisodesLogLineToTransactions(const ExpandedEpisodesLogLine & line);
+        ParserContext * getContext() const { return this->context; }
+        void setIngestionMode(IngestionMode mode) { this->ingestionMode = mode; }
+        IngestionMode getIngestionMode() const { return this->ingestionMode; }
+        quint64 getNumMalformedLines() const { return this->numMalformedLines; }
+        quint64 getNumLateLines() const { return this->reorderBuffer.getNumLateLines(); }
+        void setAllowedLateness(uint seconds) { this->reorderBuffer.setAllowedLateness(seconds); }
+        uint getAllowedLateness() const { return this->reorderBuffer.getAllowedLateness(); }
+        void setMaxPendingQuarters(int maxPendingQuarters) { this->reorderBuffer.setMaxPendingQuarters(maxPendingQuarters); }
+        void setLoadSheddingThreshold(uint maxEventsPerQuarter) { this->loadShedder.setMaxEventsPerQuarter(maxEventsPerQuarter); }
+        uint getLoadSheddingThreshold() const { return this->loadShedder.getMaxEventsPerQuarter(); }
+        quint64 getNumShedLines() const { return this->loadShedder.getNumShedLines(); }
+        bool isFollowing() const { return this->followReader.isOpen(); }
+        void setGeoIPBatchLookups(bool enabled) { this->geoIPBatchLookups = enabled; }
+        bool getGeoIPBatchLookups() const { return this->geoIPBatchLookups; }
+        void setArchiveFileName(const QString & fileName);
+        const QString & getArchiveFileName() const { return this->archiveFileName; }
+        void setMaxPendingBatches(int maxPendingBatches);
+        int getMaxPendingBatches() const { return this->maxPendingBatches; }
+        int getNumPendingBatches() const { return this->maxPendingBatches - this->batchSlots.available(); }
+        quint64 getTotalStallDuration() const { return this->totalStallDuration; }
 
     signals:
         void parsing(bool);
         void parsedDuration(int duration);
-        void parsedBatch(QList<QStringList> transactions, double transactionsPerEvent, Time start, Time end);
+        void parsedBatch(QList<QStringList> transactions, double transactionsPerEvent, Time start, Time end, double samplingRate);
+        void sampledBatch(Time start, Time end, double samplingRate);
+        void pipelineStatus(int numPendingBatches, int stallDuration);
 
     public slots:
         void parse(const QString & fileName);
+        void parseMerged(const QStringList & fileNames);
+        void replay(const QString & archiveFileName, uint from = 0, uint to = UINT_MAX);
+        void follow(const QString & fileName);
+        void stopFollowing();
         void continueParsing();
 
     protected slots:
-        void processBatch(const QList<EpisodesLogLine> batch);
+        void processBatch(const QList<EpisodesLogLine> completeBatch);
+        void readFollowedFile();
+        void closeQuarter();
 
     protected:
         void processParsedChunk(const QStringList & chunk);
-
-        QMutex mutex;
-        QWaitCondition condition;
+        void processParsedChunk(const RawLineChunk & chunk);
+        void processParsedSlices(const QList<ParsedChunkSlice> & slices);
+        void processParsedLine(const EpisodesLogLine & line);
+        void processCompletedQuarters();
+        void readFollowedLines();
+        void scheduleQuarterClose();
+        void emitBatch(const QList< QList<QStringList> > & groupedTransactions, int numEvents, Time start, Time end, double samplingRate = 1.0);
+        void openArchive();
+        void flushArchive();
+        void closeArchive();
+        void clearCaches();
+
+        // The dictionaries and caches this parser maps lines with.
+        ParserContext * context;
+        bool ownsContext;
+
+        IngestionMode ingestionMode;
+        quint64 numMalformedLines;
+        bool geoIPBatchLookups;
+        QString archiveFileName;
+        EventArchiveWriter archiveWriter;
+        QSemaphore batchSlots;
+        int maxPendingBatches;
+        quint64 totalStallDuration;
         QTime timer;
 
+        // Collects the lines of each quarter, until the quarter is complete.
+        QuarterReorderBuffer reorderBuffer;
+
+        // Samples the lines of quarters with too many page views.
+        LoadShedder loadShedder;
 
-        // QHashes that are used to minimize memory usage.
-        static EpisodeNameIDHash episodeNameIDHash;
-        static EpisodeIDNameHash episodeIDNameHash;
-        static DomainNameIDHash domainNameIDHash;
-        static DomainIDNameHash domainIDNameHash;
-        static UAHierarchyDetailsIDHash uaHierarchyDetailsIDHash;
-        static UAHierarchyIDDetailsHash uaHierarchyIDDetailsHash;
-        static LocationToIDHash locationToIDHash;
-        static LocationFromIDHash locationFromIDHash;
-
-        static bool parserHelpersInitialized;
-        static QBrowsCap browsCap;
-        static QGeoIP geoIP;
-        static EpisodeDurationDiscretizer episodeDiscretizer;
-
-        // Mutexes used to ensure thread-safety.
-        static QMutex parserHelpersInitMutex;
-        static QMutex episodeHashMutex;
-        static QMutex domainHashMutex;
-        static QMutex uaHierarchyHashMutex;
-        static QMutex mutex_hashAccess_location;
-        static QMutex regExpMutex;
-        static QMutex dateTimeMutex;
-
-        // Methods to actually use the above QHashes.
-        static EpisodeID mapEpisodeNameToID(EpisodeName name);
-        static DomainID mapDomainNameToID(DomainName name);
-        static UAHierarchyID mapUAHierarchyToID(UAHierarchyDetails ua);
-        static LocationID mapLocationToID(const Location & location);
+        // Follow mode.
+        FollowingLogReader followReader;
+        QFileSystemWatcher * followWatcher;
+        QTimer * followPollTimer;
+        QTimer * quarterTimer;
+        bool followBusy;
     };
 
 }
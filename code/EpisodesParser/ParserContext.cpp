@@ -0,0 +1,658 @@
+#include "ParserContext.h"
+
+namespace EpisodesParser {
+
+    ParserHelpers ParserHelpers::defaultHelpers;
+    QThreadStorage<TimestampDecoder *> ParserContext::timestampDecoders;
+
+
+    //---------------------------------------------------------------------------
+    // ParserHelpers public methods.
+
+    ParserHelpers::ParserHelpers() {
+        this->initialized = false;
+    }
+
+    /**
+     * Load the parser helpers. Only the first call has any effect.
+     */
+    void ParserHelpers::init(const QString & browsCapCSV,
+                             const QString & browsCapIndex,
+                             const QString & geoIPCityDB,
+                             const QString & geoIPISPDB,
+                             const QString & episodeDiscretizerCSV)
+    {
+        QMutexLocker locker(&this->initMutex);
+
+        if (this->initialized)
+            return;
+
+        // About 1.5 MB of permanent memory consumption.
+        this->browsCap.setCsvFile(browsCapCSV);
+        this->browsCap.setIndexFile(browsCapIndex);
+        this->browsCap.buildIndex();
+
+        // About 25 MB of permanent memory consumption.
+        this->geoIP.openDatabases(geoIPCityDB, geoIPISPDB);
+
+        // No significant permanent memory consumption.
+        this->episodeDiscretizer.parseCsvFile(episodeDiscretizerCSV);
+
+        this->initialized = true;
+    }
+
+    /**
+     * Clear QBrowsCap's in-memory cache. The helpers remain initialized.
+     */
+    void ParserHelpers::clearCaches() {
+        QMutexLocker locker(&this->browsCapMutex);
+        this->browsCap.resetCache();
+    }
+
+    bool ParserHelpers::isInitialized() const {
+        QMutexLocker locker(&this->initMutex);
+        return this->initialized;
+    }
+
+    /**
+     * Look up the GeoIP record of an IP address.
+     *
+     * Thread-safe: QGeoIP is not thread-safe, hence access to it is
+     * serialized.
+     */
+    QGeoIPRecord ParserHelpers::lookupLocation(quint32 ip) {
+        QMutexLocker locker(&this->geoIPMutex);
+        return this->geoIP.recordByAddr(QHostAddress(ip));
+    }
+
+    /**
+     * Match a raw User-Agent string against browscap.
+     *
+     * Thread-safe: QBrowsCap's cache is not thread-safe, hence access to it
+     * is serialized.
+     */
+    QPair<bool, QBrowsCapRecord> ParserHelpers::matchUserAgent(const UA & ua) {
+        QMutexLocker locker(&this->browsCapMutex);
+        return this->browsCap.matchUserAgent(ua);
+    }
+
+
+    //---------------------------------------------------------------------------
+    // ParserContext public methods.
+
+    /**
+     * @param helpers
+     *   The parser helpers to use, which may be shared with other contexts.
+     *   When NULL, the default helpers are used (see Parser::initParserHelpers()).
+     */
+    ParserContext::ParserContext(ParserHelpers * helpers)
+        : geoIPCache(GEOIP_CACHE_CAPACITY), uaCache(UA_CACHE_CAPACITY)
+    {
+        this->helpers = (helpers != NULL) ? helpers : ParserHelpers::getDefault();
+        this->geoIPCachePrefixMask = 0xFFFFFFFF;
+    }
+
+    ParserContext::~ParserContext() {
+        for (int i = 0; i < NUM_EPISODE_IDS; i++)
+            delete (QString *) this->episodeItems[i];
+    }
+
+    /**
+     * Clear the GeoIP and User-Agent lookup caches. The dictionaries are
+     * kept, hence IDs remain valid.
+     */
+    void ParserContext::clearCaches() {
+        this->geoIPCache.clear();
+        this->uaCache.clear();
+    }
+
+    /**
+     * Configure the GeoIP lookup cache, which maps IP addresses straight to
+     * LocationIDs.
+     *
+     * @param capacity
+     *   The maximum number of cached IP addresses (or prefixes).
+     * @param prefixLength
+     *   The number of leading bits of an IP address that are used as the
+     *   cache key. 32 (the default) caches exact IP addresses. Shorter
+     *   prefixes (e.g. 24) yield more cache hits, at the cost of mapping all
+     *   IP addresses in a prefix to the location of the prefix' first
+     *   address.
+     */
+    void ParserContext::setGeoIPCacheOptions(int capacity, int prefixLength) {
+        prefixLength = qBound(0, prefixLength, 32);
+
+        this->geoIPCache.clear();
+        this->geoIPCache.setCapacity(capacity);
+        this->geoIPCachePrefixMask = (prefixLength == 0) ? 0 : 0xFFFFFFFF << (32 - prefixLength);
+    }
+
+    /**
+     * Set the maximum number of entries in the User-Agent lookup cache, which
+     * maps (hashes of) raw User-Agent strings straight to UAHierarchyIDs.
+     *
+     * @param capacity
+     *   The maximum number of cached User-Agent strings.
+     */
+    void ParserContext::setUACacheCapacity(int capacity) {
+        this->uaCache.clear();
+        this->uaCache.setCapacity(capacity);
+    }
+
+    /**
+     * Map a line (raw string) to an EpisodesLogLine data structure.
+     *
+     * @param line
+     *   Raw line, as read from the episodes log file.
+     * @param ok
+     *   If not NULL, set to false when the line is malformed, true otherwise.
+     * @return
+     *   Corresponding EpisodesLogLine data structure.
+     */
+    EpisodesLogLine ParserContext::mapLineToEpisodesLogLine(const QString & line, bool * ok) {
+        const QByteArray bytes = line.toUtf8();
+        return this->mapLineToEpisodesLogLine(RawLine(bytes.constData(), bytes.size()), ok);
+    }
+
+    /**
+     * Map a raw line (e.g. a view into a memory-mapped log file) to an
+     * EpisodesLogLine data structure.
+     *
+     * The line is tokenized by EpisodesLogScanner in a single pass, without
+     * any locking. Malformed lines are rejected as a whole.
+     *
+     * @param line
+     *   Raw line, as read from the episodes log file.
+     * @param ok
+     *   If not NULL, set to false when the line is malformed, true otherwise.
+     * @return
+     *   Corresponding EpisodesLogLine data structure. Only valid when the
+     *   line is not malformed.
+     */
+    EpisodesLogLine ParserContext::mapLineToEpisodesLogLine(const RawLine & line, bool * ok) {
+        ScannedEpisodesLogLine scanned;
+        const char * cursor;
+        const char * end;
+        RawField episodeName;
+        EpisodeDuration episodeDuration;
+        Episode episode;
+        EpisodesLogLine parsedLine;
+
+        if (!EpisodesLogScanner::scan(line.data, line.length, scanned)) {
+            if (ok != NULL)
+                *ok = false;
+            return parsedLine;
+        }
+
+        // IP address.
+        parsedLine.ip.setAddress(scanned.ip);
+
+        // Time. Each thread has its own decoder, hence no locking is needed.
+        if (!ParserContext::timestampDecoders.hasLocalData())
+            ParserContext::timestampDecoders.setLocalData(new TimestampDecoder());
+        parsedLine.time = ParserContext::timestampDecoders.localData()->decode(scanned.dateTime.data, scanned.dateTime.length);
+
+        // Episode names and durations.
+        cursor = scanned.ets.data;
+        end = scanned.ets.data + scanned.ets.length;
+        while (EpisodesLogScanner::nextEpisode(&cursor, end, episodeName, episodeDuration)) {
+            episode.id       = this->mapEpisodeNameToID(episodeName.data, episodeName.length);
+            episode.duration = episodeDuration;
+#ifdef DEBUG
+            episode.IDNameHash = &this->episodeDictionary;
+#endif
+            parsedLine.episodes.append(episode);
+        }
+
+        // HTTP status code.
+        parsedLine.status = scanned.status;
+
+        // URL.
+        parsedLine.url = QString::fromUtf8(scanned.url.data, scanned.url.length);
+
+        // User-Agent.
+        parsedLine.ua = QString::fromUtf8(scanned.ua.data, scanned.ua.length);
+
+        // Domain name.
+        parsedLine.domain.id = this->mapDomainNameToID(scanned.domain.data, scanned.domain.length);
+#ifdef DEBUG
+        parsedLine.domain.IDNameHash = &this->domainDictionary;
+#endif
+
+#ifdef DEBUG
+        /*
+        parsedLine.episodeIDNameHash = &this->episodeDictionary;
+        parsedLine.domainIDNameHash = &this->domainDictionary;
+        qDebug() << parsedLine;
+        */
+#endif
+        if (ok != NULL)
+            *ok = true;
+        return parsedLine;
+    }
+
+    /**
+     * Expand an EpisodesLogLine data structure to an ExpandedEpisodesLogLine
+     * data structure, which contains the expanded (hierarchical) versions
+     * of the ip and User Agent values. I.e. these expanded versions provide
+     * a concept hierarchy.
+     *
+     * @param line
+     *   EpisodesLogLine data structure.
+     * return
+     *   Corresponding ExpandedEpisodesLogLine data structure.
+     */
+    ExpandedEpisodesLogLine ParserContext::expandEpisodesLogLine(const EpisodesLogLine & line) {
+        ExpandedEpisodesLogLine expandedLine;
+
+        // IP address hierarchy.
+        expandedLine.location = this->mapIPAddressToLocationID(line.ip.toIPv4Address());
+        expandedLine.locationFromIDHash = &this->locationDictionary;
+
+        // Time.
+        expandedLine.time = line.time;
+
+        // Episode name and durations.
+        // @TODO: discretize to fast/acceptable/slow.
+        expandedLine.episodes = line.episodes;
+
+        // HTTP status code.
+        expandedLine.status = line.status;
+
+        // URL.
+        expandedLine.url = line.url;
+
+        // User-Agent hierarchy.
+        expandedLine.ua = this->mapUserAgentToUAHierarchyID(line.ua);
+        expandedLine.uaHierarchyIDDetailsHash = &this->uaHierarchyDictionary;
+
+        return expandedLine;
+    }
+
+    ExpandedEpisodesLogLine ParserContext::mapAndExpandToEpisodesLogLine(const QString & line) {
+        return this->expandEpisodesLogLine(this->mapLineToEpisodesLogLine(line));
+    }
+
+    QList<QStringList> ParserContext::mapExpandedEpisodesLogLineToTransactions(const ExpandedEpisodesLogLine & line) {
+        const EpisodeDurationDiscretizer & episodeDiscretizer = this->helpers->getEpisodeDiscretizer();
+        QList<QStringList> transactions;
+        QStringList itemList;
+        // The location and UA hierarchy items were rendered when they were
+        // interned, hence these are merely (implicitly shared) copies.
+        itemList << QString("url:") + QString(line.url)
+                 << this->locationDictionary.value(line.location).associationRuleItems
+                 << this->uaHierarchyDictionary.value(line.ua).associationRuleItems;
+
+        // Only include the HTTP status code in the transaction if it's not a 200 status.
+        // TODO: improve performance of this: by simply omitting this check, the entire process becomes 5% faster!
+        if (line.status != 200)
+            itemList << QString("status:") + QString::number(line.status);
+
+        Episode episode;
+        QStringList transaction;
+        foreach (episode, line.episodes) {
+            transaction << this->mapEpisodeIDToItem(episode.id)
+                        << episodeDiscretizer.getDurationItem(this->mapEpisodeDurationToSpeedID(episode.id, episode.duration))
+                        // Append the shared items.
+                        << itemList;
+            transactions << transaction;
+            transaction.clear();
+        }
+
+        return transactions;
+    }
+
+    /**
+     * Expand an EpisodesLogLine and map it to transactions in one go, so that
+     * both steps can be performed concurrently for a whole batch.
+     *
+     * @param line
+     *   EpisodesLogLine data structure.
+     * @return
+     *   The transactions for this EpisodesLogLine.
+     */
+    QList<QStringList> ParserContext::mapEpisodesLogLineToTransactions(const EpisodesLogLine & line) {
+        return this->mapExpandedEpisodesLogLineToTransactions(this->expandEpisodesLogLine(line));
+    }
+
+    /**
+     * Map a slice of a chunk of raw lines to EpisodesLogLines. Malformed
+     * lines are skipped, but counted.
+     *
+     * @param slice
+     *   A slice of a chunk of raw lines.
+     * @return
+     *   The corresponding EpisodesLogLines, in the same order.
+     */
+    ParsedChunkSlice ParserContext::mapRawLinesToEpisodesLogLines(const RawLineChunk & slice) {
+        ParsedChunkSlice parsedSlice;
+        EpisodesLogLine line;
+        bool ok;
+
+        foreach (const RawLine & rawLine, slice) {
+            line = this->mapLineToEpisodesLogLine(rawLine, &ok);
+            if (ok)
+                parsedSlice.lines.append(line);
+            else
+                parsedSlice.numMalformedLines++;
+        }
+
+        return parsedSlice;
+    }
+
+    /**
+     * Map a slice of a chunk of lines to EpisodesLogLines. Malformed lines
+     * are skipped, but counted.
+     *
+     * @param slice
+     *   A slice of a chunk of lines.
+     * @return
+     *   The corresponding EpisodesLogLines, in the same order.
+     */
+    ParsedChunkSlice ParserContext::mapStringsToEpisodesLogLines(const QStringList & slice) {
+        ParsedChunkSlice parsedSlice;
+        EpisodesLogLine line;
+        bool ok;
+
+        foreach (const QString & rawLine, slice) {
+            line = this->mapLineToEpisodesLogLine(rawLine, &ok);
+            if (ok)
+                parsedSlice.lines.append(line);
+            else
+                parsedSlice.numMalformedLines++;
+        }
+
+        return parsedSlice;
+    }
+
+    /**
+     * Map an IP address to a LocationID, through the GeoIP lookup cache.
+     *
+     * On a cache hit, neither QGeoIP nor the location dictionary are
+     * consulted.
+     *
+     * @param ip
+     *   An IPv4 address.
+     * @return
+     *   The corresponding LocationID.
+     */
+    LocationID ParserContext::mapIPAddressToLocationID(quint32 ip) {
+        QGeoIPRecord geoIPRecord;
+        Location location;
+        LocationID id;
+        quint32 key = ip & this->geoIPCachePrefixMask;
+
+        if (this->geoIPCache.lookup(key, id))
+            return id;
+
+        geoIPRecord = this->helpers->lookupLocation(key);
+        location.continent = geoIPRecord.continentCode;
+        location.country   = geoIPRecord.country;
+        location.city      = geoIPRecord.city;
+        location.region    = geoIPRecord.region;
+        location.isp       = geoIPRecord.isp;
+
+        id = this->mapLocationToID(location);
+        this->geoIPCache.insert(key, id);
+
+        return id;
+    }
+
+    /**
+     * Map a raw User-Agent string to a UAHierarchyID, through the User-Agent
+     * lookup cache.
+     *
+     * On a cache hit, neither QBrowsCap nor the UA hierarchy dictionary are
+     * consulted.
+     *
+     * @param ua
+     *   A raw User-Agent string.
+     * @return
+     *   The corresponding UAHierarchyID.
+     */
+    UAHierarchyID ParserContext::mapUserAgentToUAHierarchyID(const UA & ua) {
+        QPair<bool, QBrowsCapRecord> browsCapResult;
+        UAHierarchyDetails uaHierarchyDetails;
+        UAHierarchyID id;
+        quint64 key = ParserContext::hashUserAgent(ua);
+
+        if (this->uaCache.lookup(key, id))
+            return id;
+
+        browsCapResult = this->helpers->matchUserAgent(ua);
+        uaHierarchyDetails.platform              = browsCapResult.second.platform;
+        uaHierarchyDetails.browser_name          = browsCapResult.second.browser_name;
+        uaHierarchyDetails.browser_version       = browsCapResult.second.browser_version;
+        uaHierarchyDetails.browser_version_major = browsCapResult.second.browser_version_major;
+        uaHierarchyDetails.browser_version_minor = browsCapResult.second.browser_version_minor;
+        uaHierarchyDetails.is_mobile             = browsCapResult.second.is_mobile;
+
+        id = this->mapUAHierarchyToID(uaHierarchyDetails);
+        this->uaCache.insert(key, id);
+
+        return id;
+    }
+
+    /**
+     * Resolve the locations of all distinct IP addresses (or prefixes) in a
+     * batch, in ascending order, which results in better locality in the
+     * GeoIP databases than the order in which they occur in the batch. The
+     * results end up in the GeoIP lookup cache.
+     *
+     * @param batch
+     *   A batch of EpisodesLogLines.
+     */
+    void ParserContext::prefetchLocations(const QList<EpisodesLogLine> & batch) {
+        QVector<quint32> keys;
+
+        keys.reserve(batch.size());
+        foreach (const EpisodesLogLine & line, batch)
+            keys.append(line.ip.toIPv4Address() & this->geoIPCachePrefixMask);
+        qSort(keys);
+
+        for (int i = 0; i < keys.size(); i++) {
+            if (i > 0 && keys[i] == keys[i - 1])
+                continue;
+            this->mapIPAddressToLocationID(keys[i]);
+        }
+    }
+
+    /**
+     * Map an episode name to an episode ID. Generate a new ID when necessary.
+     *
+     * @param name
+     *   Episode name.
+     * @return
+     *   The corresponding episode ID.
+     *
+     * Thread-safe: looking up an existing episode name is wait-free, see
+     * ConcurrentInternTable.
+     */
+    EpisodeID ParserContext::mapEpisodeNameToID(EpisodeName name) {
+        return this->episodeDictionary.intern(name);
+    }
+
+    /**
+     * Map a Latin-1 encoded episode name to an episode ID. Generate a new ID
+     * when necessary. A QString is only built for new episode names.
+     *
+     * @param name
+     *   Episode name, Latin-1 encoded.
+     * @param length
+     *   The length of the episode name.
+     * @return
+     *   The corresponding episode ID.
+     */
+    EpisodeID ParserContext::mapEpisodeNameToID(const char * name, int length) {
+        return this->episodeDictionary.intern(name, length);
+    }
+
+    /**
+     * Map a domain name to a domain ID. Generate a new ID when necessary.
+     *
+     * @param name
+     *   Domain name.
+     * @return
+     *   The corresponding domain ID.
+     *
+     * Thread-safe: looking up an existing domain name is wait-free, see
+     * ConcurrentInternTable.
+     */
+    DomainID ParserContext::mapDomainNameToID(DomainName name) {
+        return this->domainDictionary.intern(name);
+    }
+
+    /**
+     * Map a UTF-8 encoded domain name to a domain ID. Generate a new ID when
+     * necessary. Domain names are nearly always ASCII, which is also valid
+     * Latin-1, hence they can be looked up without building a QString.
+     *
+     * @param name
+     *   Domain name, UTF-8 encoded.
+     * @param length
+     *   The length of the domain name, in bytes.
+     * @return
+     *   The corresponding domain ID.
+     */
+    DomainID ParserContext::mapDomainNameToID(const char * name, int length) {
+        for (int i = 0; i < length; i++)
+            if ((uchar) name[i] >= 0x80)
+                return this->domainDictionary.intern(QString::fromUtf8(name, length));
+
+        return this->domainDictionary.intern(name, length);
+    }
+
+    /**
+     * Map a UA hierarchy to a UA hierarchy ID. Generate a new ID when
+     * necessary.
+     *
+     * @param ua
+     *   UA hierarchy
+     * @return
+     *   The corresponding UA hierarchy ID.
+     *
+     * Thread-safe: looking up an existing UA hierarchy is wait-free, see
+     * ConcurrentInternTable. New UA hierarchies are interned along with
+     * their association rule items.
+     */
+    UAHierarchyID ParserContext::mapUAHierarchyToID(UAHierarchyDetails ua) {
+        UAHierarchyID id;
+
+        if (this->uaHierarchyDictionary.lookup(ua, id))
+            return id;
+
+        ua.associationRuleItems = ua.generateAssociationRuleItems();
+        return this->uaHierarchyDictionary.intern(ua);
+    }
+
+    /**
+     * Map a Location to a Location ID. Generate a new ID when necessary.
+     *
+     * @param location
+     *   Location.
+     * @return
+     *   The corresponding location ID.
+     *
+     * Thread-safe: looking up an existing location is wait-free, see
+     * ConcurrentInternTable. New locations are interned along with their
+     * association rule items.
+     */
+    LocationID ParserContext::mapLocationToID(const Location & location) {
+        LocationID id;
+
+        if (this->locationDictionary.lookup(location, id))
+            return id;
+
+        Location renderedLocation = location;
+        renderedLocation.associationRuleItems = location.generateAssociationRuleItems();
+        return this->locationDictionary.intern(renderedLocation);
+    }
+
+    /**
+     * Map an episode ID to its "episode:<name>" association rule item. The
+     * item is rendered only once per episode ID.
+     *
+     * @param id
+     *   Episode ID.
+     * @return
+     *   The corresponding association rule item.
+     *
+     * Thread-safe: when multiple threads render the same item concurrently,
+     * only the first one to publish it wins.
+     */
+    const QString & ParserContext::mapEpisodeIDToItem(EpisodeID id) {
+        QString * item = this->episodeItems[id];
+
+        if (item == NULL) {
+            QString * renderedItem = new QString(QString("episode:") + this->episodeDictionary.value(id));
+            if (this->episodeItems[id].testAndSetOrdered(NULL, renderedItem))
+                item = renderedItem;
+            else {
+                delete renderedItem;
+                item = this->episodeItems[id];
+            }
+        }
+
+        return *item;
+    }
+
+    /**
+     * Map an episode duration to a speed. The episode's thresholds in the
+     * episode discretizer are looked up by name only once per episode ID.
+     *
+     * @param id
+     *   Episode ID.
+     * @param duration
+     *   Episode duration.
+     * @return
+     *   The corresponding speed.
+     *
+     * Thread-safe: concurrent threads may look up the same episode's
+     * thresholds, but they will all store the same index.
+     */
+    EpisodeSpeedID ParserContext::mapEpisodeDurationToSpeedID(EpisodeID id, EpisodeDuration duration) {
+        const EpisodeDurationDiscretizer & episodeDiscretizer = this->helpers->getEpisodeDiscretizer();
+
+        // Stores the episode discretizer index + 2, so that 0 means "not yet
+        // looked up" and 1 means "unknown episode".
+        int index = this->episodeDiscretizerIndices[id];
+
+        if (index == 0) {
+            const EpisodeName & name = this->episodeDictionary.value(id);
+            index = episodeDiscretizer.getEpisodeIndex(name) + 2;
+            if (index == 1)
+                qCritical("The Episode '%s' could not be mapped to a discretized speed: it has no speed thresholds.", qPrintable(name));
+            this->episodeDiscretizerIndices[id].fetchAndStoreOrdered(index);
+        }
+
+        return episodeDiscretizer.mapToSpeedID(index - 2, duration);
+    }
+
+
+    //---------------------------------------------------------------------------
+    // ParserContext protected methods.
+
+    /**
+     * Hash a raw User-Agent string, using 64-bit FNV-1a. With 64 bits,
+     * collisions are negligible for the number of distinct User-Agent
+     * strings in a log file, hence the hash is used as the cache key instead
+     * of the (long) string itself.
+     *
+     * @param ua
+     *   A raw User-Agent string.
+     * @return
+     *   The 64-bit FNV-1a hash of the UTF-16 representation of ua.
+     */
+    quint64 ParserContext::hashUserAgent(const UA & ua) {
+        const ushort * c = ua.utf16();
+        const ushort * end = c + ua.size();
+        quint64 hash = Q_UINT64_C(14695981039346656037);
+
+        for (; c < end; c++) {
+            hash = (hash ^ (*c & 0xFF)) * Q_UINT64_C(1099511628211);
+            hash = (hash ^ (*c >> 8)) * Q_UINT64_C(1099511628211);
+        }
+
+        return hash;
+    }
+}
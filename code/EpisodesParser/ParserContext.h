@@ -0,0 +1,186 @@
+#ifndef PARSERCONTEXT_H
+#define PARSERCONTEXT_H
+
+#include <QString>
+#include <QStringList>
+#include <QPair>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QHostAddress>
+
+#include "QBrowsCap.h"
+#include "QGeoIP.h"
+#include "EpisodeDurationDiscretizer.h"
+#include "EpisodesLogScanner.h"
+#include "TimestampDecoder.h"
+#include "ShardedCache.h"
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Default maximum number of entries in the GeoIP lookup cache.
+    #define GEOIP_CACHE_CAPACITY 65536
+    // Default maximum number of entries in the User-Agent lookup cache.
+    #define UA_CACHE_CAPACITY 16384
+    // EpisodeIDs are 8-bit.
+    #define NUM_EPISODE_IDS 256
+
+    /**
+     * The heavy parser helpers: browscap, GeoIP and the episode duration
+     * discretizer. These take a lot of memory and time to load, but do not
+     * depend on the Episodes log that is being parsed, hence a single
+     * instance can be shared by any number of ParserContexts.
+     *
+     * QBrowsCap and QGeoIP are not thread-safe, hence all access to them is
+     * serialized.
+     */
+    class ParserHelpers {
+    public:
+        ParserHelpers();
+
+        void init(const QString & browsCapCSV,
+                  const QString & browsCapIndex,
+                  const QString & geoIPCityDB,
+                  const QString & geoIPISPDB,
+                  const QString & episodeDiscretizerCSV);
+        void clearCaches();
+
+        // Accessors.
+        bool isInitialized() const;
+        const EpisodeDurationDiscretizer & getEpisodeDiscretizer() const { return this->episodeDiscretizer; }
+
+        QGeoIPRecord lookupLocation(quint32 ip);
+        QPair<bool, QBrowsCapRecord> matchUserAgent(const UA & ua);
+
+        static ParserHelpers * getDefault() { return &ParserHelpers::defaultHelpers; }
+
+    protected:
+        bool initialized;
+        QBrowsCap browsCap;
+        QGeoIP geoIP;
+        EpisodeDurationDiscretizer episodeDiscretizer;
+
+        // Mutexes used to ensure thread-safety.
+        mutable QMutex initMutex;
+        QMutex browsCapMutex;
+        QMutex geoIPMutex;
+
+        // Used by all ParserContexts that are not given other helpers.
+        static ParserHelpers defaultHelpers;
+
+    private:
+        Q_DISABLE_COPY(ParserHelpers)
+    };
+
+    /**
+     * All state that is needed to map the lines of an Episodes log to
+     * transactions: the dictionaries that map names, locations and UA
+     * hierarchies to IDs, the rendered association rule items and the GeoIP
+     * and User-Agent lookup caches.
+     *
+     * Each Parser has its own context (unless it is given one), hence
+     * multiple parsers can parse different Episodes logs (e.g. of different
+     * sites) side by side, without their IDs getting mixed up. The heavy
+     * ParserHelpers are shared.
+     *
+     * All mapping methods are thread-safe, hence they can be used with
+     * QtConcurrent through ParserContextMapper.
+     */
+    class ParserContext {
+    public:
+        ParserContext(ParserHelpers * helpers = NULL);
+        ~ParserContext();
+
+        void clearCaches();
+        void setGeoIPCacheOptions(int capacity, int prefixLength);
+        CacheStatistics getGeoIPCacheStatistics() const { return this->geoIPCache.getStatistics(); }
+        void setUACacheCapacity(int capacity);
+        CacheStatistics getUACacheStatistics() const { return this->uaCache.getStatistics(); }
+
+        // Accessors.
+        ParserHelpers * getHelpers() const { return this->helpers; }
+        EpisodeDictionary & getEpisodeDictionary() { return this->episodeDictionary; }
+        DomainDictionary & getDomainDictionary() { return this->domainDictionary; }
+        LocationDictionary & getLocationDictionary() { return this->locationDictionary; }
+        UAHierarchyDictionary & getUAHierarchyDictionary() { return this->uaHierarchyDictionary; }
+
+        // Processing logic.
+        EpisodesLogLine mapLineToEpisodesLogLine(const QString & line, bool * ok = NULL);
+        EpisodesLogLine mapLineToEpisodesLogLine(const RawLine & line, bool * ok = NULL);
+        ExpandedEpisodesLogLine expandEpisodesLogLine(const EpisodesLogLine & line);
+        ExpandedEpisodesLogLine mapAndExpandToEpisodesLogLine(const QString & line);
+        QList<QStringList> mapExpandedEpisodesLogLineToTransactions(const ExpandedEpisodesLogLine & line);
+        QList<QStringList> mapEpisodesLogLineToTransactions(const EpisodesLogLine & line);
+        ParsedChunkSlice mapRawLinesToEpisodesLogLines(const RawLineChunk & slice);
+        ParsedChunkSlice mapStringsToEpisodesLogLines(const QStringList & slice);
+        LocationID mapIPAddressToLocationID(quint32 ip);
+        UAHierarchyID mapUserAgentToUAHierarchyID(const UA & ua);
+        void prefetchLocations(const QList<EpisodesLogLine> & batch);
+
+        // Methods to actually use the dictionaries.
+        EpisodeID mapEpisodeNameToID(EpisodeName name);
+        EpisodeID mapEpisodeNameToID(const char * name, int length);
+        DomainID mapDomainNameToID(DomainName name);
+        DomainID mapDomainNameToID(const char * name, int length);
+        UAHierarchyID mapUAHierarchyToID(UAHierarchyDetails ua);
+        LocationID mapLocationToID(const Location & location);
+        const QString & mapEpisodeIDToItem(EpisodeID id);
+        EpisodeSpeedID mapEpisodeDurationToSpeedID(EpisodeID id, EpisodeDuration duration);
+
+    protected:
+        static quint64 hashUserAgent(const UA & ua);
+
+        ParserHelpers * helpers;
+
+        // Dictionaries that are used to minimize memory usage.
+        EpisodeDictionary episodeDictionary;
+        DomainDictionary domainDictionary;
+        UAHierarchyDictionary uaHierarchyDictionary;
+        LocationDictionary locationDictionary;
+        QAtomicPointer<QString> episodeItems[NUM_EPISODE_IDS];
+        QAtomicInt episodeDiscretizerIndices[NUM_EPISODE_IDS];
+
+        // Lookup caches.
+        ShardedCache<quint32, LocationID> geoIPCache;
+        quint32 geoIPCachePrefixMask;
+        ShardedCache<quint64, UAHierarchyID> uaCache;
+
+        // Timestamp decoders only cache the most recently decoded day, which
+        // does not depend on the context, hence they are shared by all
+        // contexts (one decoder per thread).
+        static QThreadStorage<TimestampDecoder *> timestampDecoders;
+
+    private:
+        Q_DISABLE_COPY(ParserContext)
+    };
+
+    /**
+     * Binds one of ParserContext's mapping methods to a context, so that it
+     * can be passed to QtConcurrent's map functions.
+     */
+    template <typename Result, typename Argument>
+    class ParserContextMapper {
+    public:
+        typedef Result result_type;
+        typedef Result (ParserContext::*Method)(const Argument &);
+
+        ParserContextMapper(ParserContext * context, Method method) : context(context), method(method) {}
+
+        Result operator()(const Argument & argument) const { return (this->context->*(this->method))(argument); }
+
+    protected:
+        ParserContext * context;
+        Method method;
+    };
+
+    template <typename Result, typename Argument>
+    ParserContextMapper<Result, Argument> mapWithContext(ParserContext * context, Result (ParserContext::*method)(const Argument &)) {
+        return ParserContextMapper<Result, Argument>(context, method);
+    }
+
+}
+
+#endif // PARSERCONTEXT_H
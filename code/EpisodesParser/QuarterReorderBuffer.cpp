@@ -0,0 +1,97 @@
+#include "QuarterReorderBuffer.h"
+
+namespace EpisodesParser {
+
+    QuarterReorderBuffer::QuarterReorderBuffer(uint allowedLateness, int maxPendingQuarters) {
+        this->allowedLateness = allowedLateness;
+        this->maxPendingQuarters = qMax(1, maxPendingQuarters);
+        this->latestTime = 0;
+        this->watermark = 0;
+        this->lastTakenQuarterID = 0;
+        this->numLateLines = 0;
+    }
+
+    /**
+     * Add a line to the batch of its quarter.
+     *
+     * @param line
+     *   An Episodes log line.
+     * @return
+     *   false if the line was dropped because its quarter has already been
+     *   taken, true otherwise.
+     */
+    bool QuarterReorderBuffer::add(const EpisodesLogLine & line) {
+        uint quarterID = line.time / QUARTER_DURATION;
+
+        if (quarterID <= this->lastTakenQuarterID) {
+            this->numLateLines++;
+            return false;
+        }
+
+        this->quarters[quarterID].append(line);
+
+        if (line.time > this->latestTime) {
+            this->latestTime = line.time;
+            if (this->latestTime > this->allowedLateness)
+                this->advanceWatermark(this->latestTime - this->allowedLateness);
+        }
+
+        return true;
+    }
+
+    /**
+     * Advance the watermark, e.g. based on the wall clock when the lines
+     * are being read as they are logged.
+     *
+     * @param time
+     *   No more lines older than this time are expected. The watermark
+     *   never moves backwards.
+     */
+    void QuarterReorderBuffer::advanceWatermark(Time time) {
+        this->watermark = qMax(this->watermark, time);
+    }
+
+    /**
+     * Take the oldest quarter if it is complete.
+     *
+     * @param batch
+     *   The lines of the quarter, sorted by time. Only set when true is
+     *   returned.
+     * @return
+     *   true if a quarter was taken, false if no quarter is complete yet.
+     */
+    bool QuarterReorderBuffer::takeCompletedQuarter(QList<EpisodesLogLine> & batch) {
+        uint quarterID;
+
+        if (this->quarters.isEmpty())
+            return false;
+
+        quarterID = this->quarters.constBegin().key();
+        if ((quarterID + 1) * QUARTER_DURATION > this->watermark && this->quarters.size() <= this->maxPendingQuarters)
+            return false;
+
+        batch = this->quarters.take(quarterID);
+        this->lastTakenQuarterID = quarterID;
+
+        // Only sort when lines actually arrived out of order.
+        for (int i = 1; i < batch.size(); i++) {
+            if (batch[i].time < batch[i - 1].time) {
+                qStableSort(batch.begin(), batch.end(), QuarterReorderBuffer::isEarlier);
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Drop all buffered lines and reset the watermark.
+     */
+    void QuarterReorderBuffer::clear() {
+        this->quarters.clear();
+        this->latestTime = 0;
+        this->watermark = 0;
+        this->lastTakenQuarterID = 0;
+        this->numLateLines = 0;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef QUARTERREORDERBUFFER_H
+#define QUARTERREORDERBUFFER_H
+
+#include <QMap>
+#include <QList>
+#include <QtAlgorithms>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Quarters are 900 seconds long.
+    #define QUARTER_DURATION 900
+    // Default number of seconds an event may arrive later than the latest
+    // event seen so far, without being considered late.
+    #define REORDER_ALLOWED_LATENESS 120
+    // Default maximum number of quarters that are buffered.
+    #define REORDER_MAX_PENDING_QUARTERS 4
+
+    /**
+     * Buffers Episodes log lines per quarter, so that lines that arrive out
+     * of order still end up in the batch of their own quarter.
+     *
+     * The watermark is the time of the latest line seen so far minus the
+     * allowed lateness: no more lines older than the watermark are expected.
+     * A quarter is complete once the watermark has passed its end. Lines for
+     * a quarter that has already been taken are dropped as too late.
+     *
+     * The number of buffered quarters is bounded: when a line for a new
+     * quarter arrives while the buffer is full, the oldest quarter is
+     * considered complete as well.
+     */
+    class QuarterReorderBuffer {
+    public:
+        QuarterReorderBuffer(uint allowedLateness = REORDER_ALLOWED_LATENESS, int maxPendingQuarters = REORDER_MAX_PENDING_QUARTERS);
+
+        bool add(const EpisodesLogLine & line);
+        void advanceWatermark(Time time);
+        bool takeCompletedQuarter(QList<EpisodesLogLine> & batch);
+        void clear();
+
+        // Accessors.
+        void setAllowedLateness(uint allowedLateness) { this->allowedLateness = allowedLateness; }
+        uint getAllowedLateness() const { return this->allowedLateness; }
+        void setMaxPendingQuarters(int maxPendingQuarters) { this->maxPendingQuarters = qMax(1, maxPendingQuarters); }
+        int getMaxPendingQuarters() const { return this->maxPendingQuarters; }
+        Time getWatermark() const { return this->watermark; }
+        int getNumPendingQuarters() const { return this->quarters.size(); }
+        quint64 getNumLateLines() const { return this->numLateLines; }
+
+    protected:
+        static bool isEarlier(const EpisodesLogLine & a, const EpisodesLogLine & b) { return a.time < b.time; }
+
+        QMap<uint, QList<EpisodesLogLine> > quarters;
+        uint allowedLateness;
+        int maxPendingQuarters;
+        Time latestTime;
+        Time watermark;
+        uint lastTakenQuarterID;
+        quint64 numLateLines;
+    };
+
+}
+
+#endif // QUARTERREORDERBUFFER_H
@@ -0,0 +1,212 @@
+#ifndef SHARDEDCACHE_H
+#define SHARDEDCACHE_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QQueue>
+#include <QMutex>
+#include <QMutexLocker>
+
+
+namespace EpisodesParser {
+
+    struct CacheStatistics {
+        CacheStatistics() : hits(0), misses(0), evictions(0) {}
+
+        double getHitRate() const { return (hits + misses == 0) ? 0.0 : ((double) hits) / (hits + misses); }
+
+        quint64 hits;
+        quint64 misses;
+        quint64 evictions;
+    };
+
+    /**
+     * Thread-safe, size-bounded cache.
+     *
+     * The cache is split in a number of shards, each with its own mutex, so
+     * that concurrent lookups rarely contend. Each shard evicts entries using
+     * the second chance (a.k.a. clock) algorithm: entries are evicted in FIFO
+     * order, unless they have been hit since they were last considered for
+     * eviction.
+     */
+    template <typename Key, typename Value>
+    class ShardedCache {
+    public:
+        ShardedCache(int capacity = 65536, int numShards = 16);
+        ~ShardedCache();
+
+        bool lookup(const Key & key, Value & value);
+        void insert(const Key & key, const Value & value);
+        void clear();
+
+        void setCapacity(int capacity);
+        int getCapacity() const { return this->capacity; }
+        CacheStatistics getStatistics() const;
+
+    protected:
+        struct Entry {
+            Value value;
+            bool referenced;
+        };
+
+        struct Shard {
+            Shard() : capacity(0) {}
+
+            mutable QMutex mutex;
+            QHash<Key, Entry> entries;
+            QQueue<Key> fifo;
+            int capacity;
+            CacheStatistics statistics;
+        };
+
+        Shard & shardFor(const Key & key) const;
+
+        int capacity;
+        int numShards;
+        Shard * shards;
+
+    private:
+        Q_DISABLE_COPY(ShardedCache)
+    };
+
+
+    //---------------------------------------------------------------------------
+    // Public methods.
+
+    /**
+     * @param capacity
+     *   The maximum number of entries in the cache.
+     * @param numShards
+     *   The number of shards; must be a power of two.
+     */
+    template <typename Key, typename Value>
+    ShardedCache<Key, Value>::ShardedCache(int capacity, int numShards) {
+        Q_ASSERT(numShards > 0 && (numShards & (numShards - 1)) == 0);
+
+        this->numShards = numShards;
+        this->shards = new Shard[numShards];
+        this->setCapacity(capacity);
+    }
+
+    template <typename Key, typename Value>
+    ShardedCache<Key, Value>::~ShardedCache() {
+        delete[] this->shards;
+    }
+
+    /**
+     * Look up a key.
+     *
+     * @param key
+     *   The key to look up.
+     * @param value
+     *   The cached value, only set when true is returned.
+     * @return
+     *   true on a cache hit, false on a cache miss.
+     */
+    template <typename Key, typename Value>
+    bool ShardedCache<Key, Value>::lookup(const Key & key, Value & value) {
+        Shard & shard = this->shardFor(key);
+        QMutexLocker locker(&shard.mutex);
+
+        typename QHash<Key, Entry>::iterator it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            shard.statistics.misses++;
+            return false;
+        }
+
+        it.value().referenced = true;
+        value = it.value().value;
+        shard.statistics.hits++;
+        return true;
+    }
+
+    /**
+     * Insert a key-value pair, evicting another entry if the cache is full.
+     */
+    template <typename Key, typename Value>
+    void ShardedCache<Key, Value>::insert(const Key & key, const Value & value) {
+        Shard & shard = this->shardFor(key);
+        QMutexLocker locker(&shard.mutex);
+        Entry entry;
+        Key candidate;
+
+        // Another thread may have inserted it in the mean time.
+        if (shard.entries.contains(key))
+            return;
+
+        // Evict entries until there's room, giving entries that have been
+        // hit a second chance.
+        while (shard.entries.size() >= shard.capacity && !shard.fifo.isEmpty()) {
+            candidate = shard.fifo.dequeue();
+            typename QHash<Key, Entry>::iterator it = shard.entries.find(candidate);
+            if (it.value().referenced) {
+                it.value().referenced = false;
+                shard.fifo.enqueue(candidate);
+            }
+            else {
+                shard.entries.erase(it);
+                shard.statistics.evictions++;
+            }
+        }
+
+        entry.value = value;
+        entry.referenced = false;
+        shard.entries.insert(key, entry);
+        shard.fifo.enqueue(key);
+    }
+
+    template <typename Key, typename Value>
+    void ShardedCache<Key, Value>::clear() {
+        for (int i = 0; i < this->numShards; i++) {
+            QMutexLocker locker(&this->shards[i].mutex);
+            this->shards[i].entries.clear();
+            this->shards[i].fifo.clear();
+        }
+    }
+
+    /**
+     * Set the maximum number of entries in the cache. Only applies to
+     * insertions that happen afterwards.
+     */
+    template <typename Key, typename Value>
+    void ShardedCache<Key, Value>::setCapacity(int capacity) {
+        this->capacity = capacity;
+        for (int i = 0; i < this->numShards; i++) {
+            QMutexLocker locker(&this->shards[i].mutex);
+            this->shards[i].capacity = qMax(1, capacity / this->numShards);
+        }
+    }
+
+    /**
+     * @return
+     *   The sum of the statistics of all shards.
+     */
+    template <typename Key, typename Value>
+    CacheStatistics ShardedCache<Key, Value>::getStatistics() const {
+        CacheStatistics statistics;
+
+        for (int i = 0; i < this->numShards; i++) {
+            QMutexLocker locker(&this->shards[i].mutex);
+            statistics.hits      += this->shards[i].statistics.hits;
+            statistics.misses    += this->shards[i].statistics.misses;
+            statistics.evictions += this->shards[i].statistics.evictions;
+        }
+
+        return statistics;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected methods.
+
+    template <typename Key, typename Value>
+    typename ShardedCache<Key, Value>::Shard & ShardedCache<Key, Value>::shardFor(const Key & key) const {
+        // Mix the hash, because qHash() of an integer is the integer itself,
+        // and consecutive keys should end up in different shards.
+        uint hash = qHash(key) * 2654435761U;
+        return this->shards[(hash >> 16) & (this->numShards - 1)];
+    }
+
+}
+
+#endif // SHARDEDCACHE_H
@@ -1,5 +1,273 @@
 #include "TestParser.h"
 
+#include <zlib.h>
+
+typedef ConcurrentInternTable<QString, quint32> TestInternTable;
+
+// Compress a file with gzip. When appending, a new gzip member is added.
+static bool gzipFile(const QString & source, const QString & destination, bool append = false) {
+    QFile file(source);
+    QByteArray data;
+    gzFile gz;
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    data = file.readAll();
+    file.close();
+
+    gz = gzopen(QFile::encodeName(destination).constData(), append ? "ab" : "wb");
+    if (gz == NULL)
+        return false;
+    if (gzwrite(gz, data.constData(), data.size()) != data.size()) {
+        gzclose(gz);
+        return false;
+    }
+    return gzclose(gz) == Z_OK;
+}
+
+// Decompress a gzip file.
+static bool gunzipFile(const QString & source, const QString & destination) {
+    QFile file(destination);
+    char buffer[65536];
+    int numRead;
+    gzFile gz;
+
+    gz = gzopen(QFile::encodeName(source).constData(), "rb");
+    if (gz == NULL)
+        return false;
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        gzclose(gz);
+        return false;
+    }
+    while ((numRead = gzread(gz, buffer, sizeof(buffer))) > 0)
+        file.write(buffer, numRead);
+    file.close();
+    gzclose(gz);
+    return numRead == 0;
+}
+
+// Compress data into a single BGZF block: a gzip member with its size in
+// an extra field. Returns an empty array on failure.
+static QByteArray bgzfBlock(const QByteArray & data) {
+    QByteArray block, compressed;
+    z_stream stream;
+    quint32 value;
+
+    // Raw deflate data, without a header.
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+    compressed.resize(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef *) data.constData();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *) compressed.data();
+    stream.avail_out = compressed.size();
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&stream);
+        return QByteArray();
+    }
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    // Header, with a BC subfield that holds the block size - 1.
+    block = QByteArray("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00" "BC\x02\x00", 16);
+    value = 16 + 2 + compressed.size() + 8 - 1;
+    block.append((char) (value & 0xff));
+    block.append((char) (value >> 8));
+    block.append(compressed);
+
+    // Trailer: CRC32 and ISIZE.
+    value = crc32(0, (const Bytef *) data.constData(), data.size());
+    for (int i = 0; i < 4; i++)
+        block.append((char) (value >> (8 * i)));
+    value = data.size();
+    for (int i = 0; i < 4; i++)
+        block.append((char) (value >> (8 * i)));
+
+    return block;
+}
+
+// Compress a file with BGZF, like bgzip: blocks of at most 64 KiB of
+// uncompressed data, followed by an empty end-of-file block.
+static bool bgzipFile(const QString & source, const QString & destination) {
+    QFile file(source);
+    QByteArray data, block;
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    data = file.readAll();
+    file.close();
+
+    file.setFileName(destination);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    for (int offset = 0; offset < data.size(); offset += 60000) {
+        block = bgzfBlock(data.mid(offset, 60000));
+        if (block.isEmpty() || file.write(block) != block.size())
+            return false;
+    }
+    block = bgzfBlock(QByteArray());
+    if (block.isEmpty() || file.write(block) != block.size())
+        return false;
+    file.close();
+
+    return true;
+}
+
+// Append data to a file, as a logging web server would.
+static void appendToFile(const QString & fileName, const QByteArray & data) {
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+    file.write(data);
+    file.close();
+}
+
+// Build a large Episodes log for benchmarks, by repeating the lines of the
+// sample Episodes log file. Returns an empty array on failure.
+static QByteArray buildBenchmarkLog(int numLines) {
+    QFile sampleFile("episodes.log");
+    QList<QByteArray> sampleLines;
+    QByteArray log;
+
+    if (!sampleFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QByteArray();
+    while (!sampleFile.atEnd()) {
+        sampleLines.append(sampleFile.readLine());
+        if (!sampleLines.last().endsWith('\n'))
+            sampleLines.last().append('\n');
+    }
+    sampleFile.close();
+    if (sampleLines.isEmpty())
+        return QByteArray();
+
+    for (int i = 0; i < numLines; i++)
+        log.append(sampleLines[i % sampleLines.size()]);
+    return log;
+}
+
+// Write a large Episodes log for benchmarks to a file.
+static bool writeBenchmarkLog(const QString & fileName, int numLines) {
+    QByteArray log = buildBenchmarkLog(numLines);
+    QFile file(fileName);
+
+    if (log.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    if (file.write(log) != log.size())
+        return false;
+    file.close();
+
+    return true;
+}
+
+// The interning approach that was used before ConcurrentInternTable: a QHash
+// pair, protected by a read-write lock. Used as the benchmark baseline.
+class LockedInternTable {
+public:
+    quint32 intern(const QString & key) {
+        quint32 id;
+
+        this->lock.lockForRead();
+        if (this->keyToID.contains(key)) {
+            id = this->keyToID.value(key);
+            this->lock.unlock();
+            return id;
+        }
+        this->lock.unlock();
+
+        this->lock.lockForWrite();
+        if (!this->keyToID.contains(key)) {
+            id = this->keyToID.size();
+            this->keyToID.insert(key, id);
+            this->idToKey.insert(id, key);
+        }
+        else
+            id = this->keyToID.value(key);
+        this->lock.unlock();
+
+        return id;
+    }
+
+protected:
+    QReadWriteLock lock;
+    QHash<QString, quint32> keyToID;
+    QHash<quint32, QString> idToKey;
+};
+
+// Simulates a parser thread: interns all keys, a number of times, starting
+// at a thread-specific offset.
+template <typename Table>
+class InternRunnable : public QRunnable {
+public:
+    InternRunnable(Table * table, const QStringList * keys, int offset, int rounds, QVector<quint32> * ids)
+        : table(table), keys(keys), offset(offset), rounds(rounds), ids(ids) {}
+
+    void run() {
+        int k;
+        for (int r = 0; r < this->rounds; r++) {
+            for (int i = 0; i < this->keys->size(); i++) {
+                k = (i + this->offset) % this->keys->size();
+                (*this->ids)[k] = this->table->intern(this->keys->at(k));
+            }
+        }
+    }
+
+protected:
+    Table * table;
+    const QStringList * keys;
+    int offset;
+    int rounds;
+    QVector<quint32> * ids;
+};
+
+template <typename Table>
+void internConcurrently(Table * table, const QStringList & keys, int numThreads, int rounds, QList< QVector<quint32> > & ids) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(numThreads);
+
+    ids.clear();
+    for (int t = 0; t < numThreads; t++)
+        ids.append(QVector<quint32>(keys.size()));
+    for (int t = 0; t < numThreads; t++)
+        pool.start(new InternRunnable<Table>(table, &keys, t * keys.size() / numThreads, rounds, &ids[t]));
+    pool.waitForDone();
+}
+
+// Exposes both validators of ets fields, to compare them.
+class EpisodesLogScannerTester : public EpisodesLogScanner {
+public:
+    using EpisodesLogScanner::scanEpisodes;
+};
+
+// Parses a file on a separate thread, like the UI does.
+class ParserThread : public QThread {
+public:
+    ParserThread(Parser * parser, const QString & fileName)
+        : parser(parser), fileName(fileName) {}
+
+protected:
+    void run() {
+        this->parser->parse(this->fileName);
+    }
+
+    Parser * parser;
+    QString fileName;
+};
+
+void TestParser::initTestCase() {
+    // Like the UI, expect the parser helpers' data files in a "config"
+    // directory next to the executable.
+    QString basePath = QCoreApplication::applicationDirPath();
+    Parser::initParserHelpers(basePath + "/config/browscap.csv",
+                              basePath + "/config/browscap-index.db",
+                              basePath + "/config/GeoIPCity.dat",
+                              basePath + "/config/GeoIPASNum.dat",
+                              basePath + "/config/EpisodesSpeeds.csv");
+
+    // To be able to spy on Parser's signals.
+    qRegisterMetaType< QList<QStringList> >("QList<QStringList>");
+    qRegisterMetaType<Time>("Time");
+}
+
 void TestParser::init() {
     QFile logFile("episodes.log");
     if (!logFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
@@ -131,7 +399,7 @@ void TestParser::mapLineToEpisodesLogLine_data() {
 }
 
 void TestParser::mapLineToEpisodesLogLine() {
-    static Parser p;
+    static ParserContext context;
     static EpisodesLogLine e;
     QFETCH(QString, line);
     QFETCH(IPAddress, ip);
@@ -140,7 +408,7 @@ void TestParser::mapLineToEpisodesLogLine() {
     QFETCH(HTTPStatus, status);
     QFETCH(DomainID, domainID);
 
-    e = p.mapLineToEpisodesLogLine(line);
+    e = context.mapLineToEpisodesLogLine(line);
 
     QCOMPARE(e.ip, ip);
     QCOMPARE(e.time, time);
@@ -148,3 +416,1063 @@ void TestParser::mapLineToEpisodesLogLine() {
     QCOMPARE(e.status, status);
     QCOMPARE(e.domain.id, domainID);
 }
+
+void TestParser::mapLineToEpisodesLogLine_malformed_data() {
+    QTest::addColumn<QString>("line");
+
+    QTest::newRow("empty line")
+      << "";
+    QTest::newRow("truncated line")
+      << "218.56.155.59 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203,headerjs:94";
+    QTest::newRow("invalid IP address")
+      << "218.56.155.590 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203\" 200 \"http://driverpacks.net/\" \"Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1; SV1)\" \"driverpacks.net\"";
+    QTest::newRow("episode without duration")
+      << "218.56.155.59 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203,headerjs\" 200 \"http://driverpacks.net/\" \"Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1; SV1)\" \"driverpacks.net\"";
+    QTest::newRow("non-numeric HTTP status code")
+      << "218.56.155.59 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203\" 2OO \"http://driverpacks.net/\" \"Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1; SV1)\" \"driverpacks.net\"";
+    QTest::newRow("empty User-Agent")
+      << "218.56.155.59 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203\" 200 \"http://driverpacks.net/\" \"\" \"driverpacks.net\"";
+}
+
+void TestParser::mapLineToEpisodesLogLine_malformed() {
+    static ParserContext context;
+    bool ok = true;
+    QFETCH(QString, line);
+
+    context.mapLineToEpisodesLogLine(line, &ok);
+
+    QVERIFY(!ok);
+}
+
+void TestParser::mapStringsToEpisodesLogLines() {
+    QStringList lines;
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly | QIODevice::Text));
+    QTextStream in(&logFile);
+    while (!in.atEnd())
+        lines.append(in.readLine());
+    logFile.close();
+    lines.insert(2, "this is not an Episodes log line");
+
+    // Map the slices concurrently, like Parser::processParsedChunk() does.
+    QList<QStringList> slices;
+    for (int i = 0; i < lines.size(); i += 2)
+        slices << lines.mid(i, 2);
+    ParserContext context;
+    QList<ParsedChunkSlice> parsedSlices = QtConcurrent::blockingMapped(slices, mapWithContext(&context, &ParserContext::mapStringsToEpisodesLogLines));
+
+    QList<EpisodesLogLine> parsedLines;
+    quint64 numMalformedLines = 0;
+    foreach (const ParsedChunkSlice & slice, parsedSlices) {
+        parsedLines.append(slice.lines);
+        numMalformedLines += slice.numMalformedLines;
+    }
+
+    // The file order must be preserved.
+    QCOMPARE(parsedLines.size(), 5);
+    QCOMPARE(numMalformedLines, (quint64) 1);
+    QCOMPARE(parsedLines[0].time, (Time) 1289712423);
+    QCOMPARE(parsedLines[1].time, (Time) 1289712426);
+    QCOMPARE(parsedLines[2].time, (Time) 1289712428);
+    QCOMPARE(parsedLines[3].time, (Time) 1289712431);
+    QCOMPARE(parsedLines[4].time, (Time) 1289712432);
+}
+
+void TestParser::parserContext() {
+    ParserContext siteA;
+    ParserContext siteB;
+    QString lineWithNewEpisodes = "76.170.154.29 [Sunday, 14-Nov-2010 06:27:11 +0100] \"?ets=backend:439,css:61\" 200 \"http://example.com/\" \"Mozilla/5.0 (Windows; U; Windows NT 6.1; en-US; rv:1.9.2.12) Gecko/20101026 Firefox/3.6.12\" \"example.com\"";
+    QString line = "218.56.155.59 [Sunday, 14-Nov-2010 06:27:03 +0100] \"?ets=css:203,headerjs:94\" 200 \"http://driverpacks.net/\" \"Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1; SV1)\" \"driverpacks.net\"";
+    EpisodesLogLine a;
+    EpisodesLogLine b;
+
+    // Each context has its own dictionaries, hence the IDs of one site do
+    // not depend on the lines of another site that have been parsed.
+    a = siteA.mapLineToEpisodesLogLine(lineWithNewEpisodes);
+    a = siteA.mapLineToEpisodesLogLine(line);
+    b = siteB.mapLineToEpisodesLogLine(line);
+    QCOMPARE(a.episodes, EpisodeList() << Episode(1, 203) << Episode(2, 94));
+    QCOMPARE(b.episodes, EpisodeList() << Episode(0, 203) << Episode(1, 94));
+    QCOMPARE(siteA.getEpisodeDictionary().size(), 3);
+    QCOMPARE(siteB.getEpisodeDictionary().size(), 2);
+    QCOMPARE(siteA.getDomainDictionary().size(), 2);
+    QCOMPARE(siteB.getDomainDictionary().size(), 1);
+    QCOMPARE(siteA.getEpisodeDictionary().value(0), QString("backend"));
+    QCOMPARE(siteB.getEpisodeDictionary().value(0), QString("css"));
+
+    // Both contexts use the default (shared) helpers.
+    QVERIFY(siteA.getHelpers() == ParserHelpers::getDefault());
+    QVERIFY(siteA.getHelpers() == siteB.getHelpers());
+}
+
+void TestParser::decodeTimestamp_data() {
+    QTest::addColumn<QString>("timestamp");
+
+    QTest::newRow("sample line 1") << "14-Nov-2010 06:27:03 +0100";
+    QTest::newRow("same day") << "14-Nov-2010 06:27:06 +0100";
+    QTest::newRow("negative offset") << "14-Nov-2010 23:59:59 -0500";
+    QTest::newRow("leap day") << "29-Feb-2012 12:00:00 +0200";
+    QTest::newRow("new year") << "01-Jan-2011 00:00:00 +0100";
+    QTest::newRow("invalid leap day") << "29-Feb-2011 12:00:00 +0000";
+    QTest::newRow("before the epoch") << "01-Jan-1970 00:30:00 +0100";
+    QTest::newRow("invalid month") << "14-Foo-2010 06:27:03 +0100";
+    QTest::newRow("invalid hour") << "14-Nov-2010 24:00:00 +0100";
+    QTest::newRow("too short") << "14-Nov-2010 06:27";
+}
+
+/**
+ * TimestampDecoder must be bit-exact with the QDateTime-based conversion the
+ * parser used before.
+ */
+void TestParser::decodeTimestamp() {
+    static TimestampDecoder decoder;
+    QFETCH(QString, timestamp);
+
+    QDateTime timeConvertor = QDateTime::fromString(timestamp.left(20), "dd-MMM-yyyy HH:mm:ss");
+    timeConvertor.setTimeSpec(Qt::OffsetFromUTC);
+    timeConvertor.setUtcOffset(timestamp.right(5).left(3).toInt() * 3600);
+    Time expected = timeConvertor.toUTC().toTime_t();
+
+    QByteArray bytes = timestamp.toLatin1();
+    QCOMPARE(decoder.decode(bytes.constData(), bytes.size()), expected);
+}
+
+void TestParser::episodeDurationDiscretizer_data() {
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<int>("duration");
+    QTest::addColumn<QString>("speed");
+
+    QTest::newRow("fastest") << "domready" << 0 << "fast";
+    QTest::newRow("fast, at threshold") << "domready" << 150 << "fast";
+    QTest::newRow("acceptable") << "domready" << 151 << "acceptable";
+    QTest::newRow("acceptable, at threshold") << "domready" << 1000 << "acceptable";
+    QTest::newRow("slow") << "domready" << 1001 << "slow";
+    QTest::newRow("slowest") << "domready" << 65535 << "slow";
+    QTest::newRow("other episode") << "backend" << 150 << "acceptable";
+    QTest::newRow("unknown episode") << "foo" << 150 << "unknown";
+}
+
+void TestParser::episodeDurationDiscretizer() {
+    QFETCH(QString, name);
+    QFETCH(int, duration);
+    QFETCH(QString, speed);
+
+    QFile csvFile("episodes-speeds.csv");
+    QVERIFY(csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate));
+    QTextStream out(&csvFile);
+    out << "domready,fast,150,acceptable,1000,slow" << "\n"
+        << "backend,fast,100,acceptable,500,slow" << "\n";
+    out.flush();
+    csvFile.close();
+
+    EpisodeDurationDiscretizer discretizer;
+    QVERIFY(discretizer.parseCsvFile("episodes-speeds.csv"));
+    QFile::remove("episodes-speeds.csv");
+
+    EpisodeSpeedID speedID = discretizer.mapToSpeedID(discretizer.getEpisodeIndex(name), (EpisodeDuration) duration);
+    QCOMPARE(discretizer.getSpeed(speedID), speed);
+    QCOMPARE(discretizer.getDurationItem(speedID), QString("duration:") + speed);
+    QCOMPARE(discretizer.mapToDurationItem(name, (EpisodeDuration) duration), QString("duration:") + speed);
+}
+
+void TestParser::concurrentInternTable() {
+    const int numKeys = 10000;
+    const int numThreads = 8;
+    QStringList keys;
+    for (int i = 0; i < numKeys; i++)
+        keys << QString("episode%1").arg(i);
+
+    TestInternTable table;
+    QList< QVector<quint32> > ids;
+    internConcurrently(&table, keys, numThreads, 2, ids);
+
+    // Every key must have been assigned exactly one ID, and all threads must
+    // agree on it.
+    QCOMPARE(table.size(), numKeys);
+    for (int t = 1; t < numThreads; t++)
+        QCOMPARE(ids[t], ids[0]);
+    for (int i = 0; i < numKeys; i++)
+        QCOMPARE(table.value(ids[0][i]), keys[i]);
+
+    // Sequential interning is deterministic.
+    ConcurrentInternTable<QString, quint8> small;
+    QCOMPARE((int) small.intern("css"), 0);
+    QCOMPARE((int) small.intern("headerjs"), 1);
+    QCOMPARE((int) small.intern("css"), 0);
+    QVERIFY(small.contains("headerjs"));
+    QVERIFY(!small.contains("footerjs"));
+
+    // Raw lookups find the same IDs, and insert the same keys.
+    const char * line = "css:203,footerjs:94,headerjs:1";
+    quint8 id;
+    QVERIFY(small.lookup(line + 20, 8, id));
+    QCOMPARE((int) id, 1);
+    QVERIFY(!small.lookup(line + 8, 8, id));
+    QCOMPARE((int) small.intern(line, 3), 0);
+    QCOMPARE((int) small.intern(line + 8, 8), 2);
+    QCOMPARE(small.value(2), QString("footerjs"));
+    QCOMPARE((int) small.intern("footerjs"), 2);
+    QCOMPARE((int) small.intern("caf\xe9", 4), 3);
+    QCOMPARE((int) small.intern(QString::fromUtf8("caf\xc3\xa9")), 3);
+}
+
+void TestParser::shardedCache() {
+    ShardedCache<quint32, LocationID> cache(3, 1);
+    LocationID id;
+
+    QVERIFY(!cache.lookup(1, id));
+    cache.insert(1, 10);
+    cache.insert(2, 20);
+    cache.insert(3, 30);
+    QVERIFY(cache.lookup(1, id));
+    QCOMPARE(id, (LocationID) 10);
+
+    // The cache is full: 1 gets a second chance because it was hit, so 2 is
+    // evicted instead.
+    cache.insert(4, 40);
+    QVERIFY(cache.lookup(1, id));
+    QVERIFY(!cache.lookup(2, id));
+    QVERIFY(cache.lookup(3, id));
+    QVERIFY(cache.lookup(4, id));
+    QCOMPARE(id, (LocationID) 40);
+
+    CacheStatistics statistics = cache.getStatistics();
+    QCOMPARE(statistics.hits, (quint64) 4);
+    QCOMPARE(statistics.misses, (quint64) 2);
+    QCOMPARE(statistics.evictions, (quint64) 1);
+    QCOMPARE(statistics.getHitRate(), 4.0 / 6);
+
+    cache.clear();
+    QVERIFY(!cache.lookup(1, id));
+}
+
+void TestParser::eventArchive() {
+    EpisodeDictionary episodeDictionary;
+    LocationDictionary locationDictionary;
+    UAHierarchyDictionary uaHierarchyDictionary;
+    Location location;
+    UAHierarchyDetails ua;
+    ExpandedEpisodesLogLine line;
+    QList<ExpandedEpisodesLogLine> firstQuarter, secondQuarter;
+
+    location.continent = "EU";
+    location.country = "BE";
+    location.region = "Limburg";
+    location.city = "Hasselt";
+    location.isp = "Telenet";
+    ua.platform = "Win7";
+    ua.browser_name = "Firefox";
+    ua.browser_version = "3.6";
+    ua.browser_version_major = 3;
+    ua.browser_version_minor = 6;
+    ua.is_mobile = false;
+
+    line.location = locationDictionary.intern(location);
+    line.ua = uaHierarchyDictionary.intern(ua);
+    line.status = 200;
+    line.url = "http://driverpacks.net/";
+    line.time = 1289712423;
+    line.episodes << Episode(episodeDictionary.intern("css"), 203) << Episode(episodeDictionary.intern("headerjs"), 94);
+    firstQuarter << line;
+    line.time = 1289712426;
+    line.url = "http://driverpacks.net/driverpacks";
+    line.status = 404;
+    line.episodes.clear();
+    line.episodes << Episode(episodeDictionary.intern("domready"), 843);
+    firstQuarter << line;
+    line.time = 1289712423 + 900;
+    secondQuarter << line;
+
+    // A page view with more episodes than fit in a byte.
+    QList<ExpandedEpisodesLogLine> thirdQuarter;
+    line.time = 1289712423 + 1800;
+    line.episodes.clear();
+    for (int i = 0; i < 300; i++)
+        line.episodes << Episode(episodeDictionary.intern("domready"), i);
+    thirdQuarter << line;
+
+    // The footer that is written by flush() is overwritten by the next
+    // block.
+    EventArchiveWriter writer;
+    QVERIFY(writer.open("episodes.archive"));
+    QVERIFY(writer.writeBlock(firstQuarter));
+    QVERIFY(writer.flush(episodeDictionary, locationDictionary, uaHierarchyDictionary));
+    EventArchiveReader flushedReader;
+    QVERIFY(flushedReader.open("episodes.archive"));
+    QCOMPARE(flushedReader.getBlocks(0, UINT_MAX).size(), 1);
+    flushedReader.close();
+    QVERIFY(writer.writeBlock(secondQuarter));
+    QVERIFY(writer.writeBlock(thirdQuarter));
+    QVERIFY(writer.close(episodeDictionary, locationDictionary, uaHierarchyDictionary));
+
+    EventArchiveReader reader;
+    QVERIFY(reader.open("episodes.archive"));
+    QCOMPARE(reader.getEpisodeNames(), QStringList() << "css" << "headerjs" << "domready");
+    QCOMPARE(reader.getLocations().size(), 1);
+    QCOMPARE(reader.getLocations()[0].city, QString("Hasselt"));
+    QCOMPARE(reader.getUAHierarchies().size(), 1);
+    QCOMPARE(reader.getUAHierarchies()[0].browser_version_minor, (quint16) 6);
+    QCOMPARE(reader.getURLs(), QStringList() << "http://driverpacks.net/" << "http://driverpacks.net/driverpacks");
+
+    // Time range predicate pushdown.
+    QCOMPARE(reader.getBlocks(0, UINT_MAX).size(), 3);
+    QCOMPARE(reader.getBlocks(1289712423 + 900, 1289712423 + 900).size(), 1);
+    QCOMPARE(reader.getBlocks(0, 1289712422).size(), 0);
+
+    EventArchiveBlockData data;
+    QVERIFY(reader.readBlock(reader.getBlocks(0, UINT_MAX)[0], data));
+    QCOMPARE(data.times, QVector<Time>() << 1289712423 << 1289712426);
+    QCOMPARE(data.urls, QVector<quint32>() << 0 << 1);
+    QCOMPARE(data.statuses, QVector<HTTPStatus>() << 200 << 404);
+    QCOMPARE(data.numEpisodes, QVector<quint32>() << 2 << 1);
+    QCOMPARE(data.episodeIDs, QVector<EpisodeID>() << 0 << 1 << 2);
+    QCOMPARE(data.durations, QVector<EpisodeDuration>() << 203 << 94 << 843);
+
+    QVERIFY(reader.readBlock(reader.getBlocks(1289712423 + 900, 1289712423 + 900)[0], data));
+    QCOMPARE(data.times, QVector<Time>() << 1289712423 + 900);
+
+    QVERIFY(reader.readBlock(reader.getBlocks(1289712423 + 1800, UINT_MAX)[0], data));
+    QCOMPARE(data.numEpisodes, QVector<quint32>() << 300);
+    QCOMPARE(data.durations.size(), 300);
+    QCOMPARE(data.durations.last(), (EpisodeDuration) 299);
+    reader.close();
+
+    // A corrupt column size is rejected rather than allocated.
+    QVERIFY(reader.open("episodes.archive"));
+    EventArchiveBlock block = reader.getBlocks(0, UINT_MAX)[0];
+    reader.close();
+    QFile file("episodes.archive");
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(block.offset + sizeof(quint32)));
+    QDataStream stream(&file);
+    stream << (quint32) 0xffffffff;
+    file.close();
+    QVERIFY(reader.open("episodes.archive"));
+    QVERIFY(!reader.readBlock(block, data));
+    reader.close();
+
+    QFile::remove("episodes.archive");
+}
+
+void TestParser::replaySampledBatch() {
+    Parser parser;
+    QSignalSpy batches(&parser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time, double)));
+    QByteArray lines;
+
+    // The 5 lines of the first quarter, plus a line of a later quarter, to
+    // complete the first.
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly));
+    lines = logFile.readAll();
+    logFile.close();
+    QFile::remove("episodes-sampled.log");
+    appendToFile("episodes-sampled.log", lines);
+    appendToFile("episodes-sampled.log", lines.left(lines.indexOf('\n') + 1).replace("06:27:03", "07:12:03"));
+
+    // At most 2 of the first quarter's 5 page views are kept: each is kept
+    // with probability 1/3.
+    QFile::remove("episodes-sampled.archive");
+    parser.setLoadSheddingThreshold(2);
+    parser.setArchiveFileName("episodes-sampled.archive");
+    parser.parse("episodes-sampled.log");
+    QCOMPARE(batches.size(), 1);
+    QCOMPARE(batches[0][4].toDouble(), 1.0 / 3);
+
+    // Replaying the archived sample must weigh it the same way.
+    Parser replayingParser;
+    QSignalSpy replayedBatches(&replayingParser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time, double)));
+    replayingParser.replay("episodes-sampled.archive");
+    QCOMPARE(replayedBatches.size(), 1);
+    QCOMPARE(replayedBatches[0][4].toDouble(), 1.0 / 3);
+    QCOMPARE(replayedBatches[0][0].value< QList<QStringList> >().size(), batches[0][0].value< QList<QStringList> >().size());
+
+    parser.setArchiveFileName("");
+    QFile::remove("episodes-sampled.archive");
+    QFile::remove("episodes-sampled.log");
+}
+
+void TestParser::compressedLogReader() {
+    MappedLogReader mappedReader;
+    CompressedLogReader compressedReader;
+    RawLineChunk chunk;
+    QList<QByteArray> expected, lines;
+
+    QVERIFY(mappedReader.open("episodes.log"));
+    while (mappedReader.readChunk(chunk, CHUNK_SIZE) > 0)
+        foreach (const RawLine & line, chunk)
+            expected.append(QByteArray(line.data, line.length));
+    mappedReader.close();
+
+    QCOMPARE(CompressedLogReader::detectFormat("episodes.log"), COMPRESSION_NONE);
+    QVERIFY(!compressedReader.open("episodes.log"));
+
+    // Two concatenated gzip members. Read in tiny chunks, to make sure
+    // lines that span decompressed blocks are handled correctly.
+    QVERIFY(gzipFile("episodes.log", "episodes.log.gz"));
+    QVERIFY(gzipFile("episodes.log", "episodes.log.gz", true));
+    QCOMPARE(CompressedLogReader::detectFormat("episodes.log.gz"), COMPRESSION_GZIP);
+    QVERIFY(compressedReader.open("episodes.log.gz"));
+    while (compressedReader.readChunk(chunk, 7) > 0)
+        foreach (const RawLine & line, chunk)
+            lines.append(QByteArray(line.data, line.length));
+    QVERIFY(compressedReader.atEnd());
+    QVERIFY(!compressedReader.hasFailed());
+    compressedReader.close();
+    QCOMPARE(lines, expected + expected);
+
+    // Closing the reader before the end has been reached.
+    QVERIFY(compressedReader.open("episodes.log.gz"));
+    QCOMPARE(compressedReader.readChunk(chunk, 1), 1);
+    compressedReader.close();
+
+    // BGZF.
+    QVERIFY(bgzipFile("episodes.log", "episodes.log.bgz"));
+    QCOMPARE(CompressedLogReader::detectFormat("episodes.log.bgz"), COMPRESSION_BGZF);
+    QVERIFY(compressedReader.open("episodes.log.bgz"));
+    lines.clear();
+    while (compressedReader.readChunk(chunk, 7) > 0)
+        foreach (const RawLine & line, chunk)
+            lines.append(QByteArray(line.data, line.length));
+    QVERIFY(!compressedReader.hasFailed());
+    compressedReader.close();
+    QCOMPARE(lines, expected);
+
+    // A BGZF block whose ISIZE exceeds the BGZF maximum is rejected, rather
+    // than allocated (or, beyond 2 GiB, overflowed).
+    QFile bgzf("episodes.log.bgz");
+    QVERIFY(bgzf.open(QIODevice::ReadWrite));
+    QByteArray header = bgzf.read(18);
+    int blockSize = ((quint8) header[16] | ((quint8) header[17] << 8)) + 1;
+    QVERIFY(bgzf.seek(blockSize - 4));
+    QCOMPARE(bgzf.write("\x00\x00\x00\x80", 4), (qint64) 4);
+    bgzf.close();
+    QVERIFY(compressedReader.open("episodes.log.bgz"));
+    QCOMPARE(compressedReader.readChunk(chunk, CHUNK_SIZE), 0);
+    QVERIFY(compressedReader.hasFailed());
+    compressedReader.close();
+
+    QFile::remove("episodes.log.gz");
+    QFile::remove("episodes.log.bgz");
+}
+
+void TestParser::followingLogReader() {
+    FollowingLogReader reader;
+    RawLineChunk chunk;
+
+    QFile::remove("episodes-followed.log");
+    QFile::remove("episodes-followed.log.1");
+    QVERIFY(!reader.open("episodes-followed.log"));
+
+    // Only complete lines are read.
+    appendToFile("episodes-followed.log", "first\nsecond\r\nthi");
+    QVERIFY(reader.open("episodes-followed.log"));
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 2);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("first"));
+    QCOMPARE(QByteArray(chunk[1].data, chunk[1].length), QByteArray("second"));
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 0);
+
+    // Lines that are appended later on are read, too.
+    appendToFile("episodes-followed.log", "rd\nfourth\n");
+    QCOMPARE(reader.readChunk(chunk, 1), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("third"));
+    QCOMPARE(reader.readChunk(chunk, 1), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("fourth"));
+    QCOMPARE(reader.getPosition(), (qint64) 27);
+    QVERIFY(!reader.isRotated());
+
+    // Rotation by renaming: the old file is read until its end first.
+    appendToFile("episodes-followed.log", "fifth\n");
+    QVERIFY(QFile::rename("episodes-followed.log", "episodes-followed.log.1"));
+    QVERIFY(!reader.isRotated());
+    appendToFile("episodes-followed.log", "sixth\n");
+#ifdef Q_OS_UNIX
+    QVERIFY(reader.isRotated());
+#endif
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("fifth"));
+    QVERIFY(reader.reopen());
+    QVERIFY(!reader.isRotated());
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("sixth"));
+
+    // Rotation by truncation, in the middle of a line: the part that was
+    // written before the rotation remains buffered until the line is
+    // completed in the new file.
+    appendToFile("episodes-followed.log", "seve");
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 0);
+    QFile truncated("episodes-followed.log");
+    QVERIFY(truncated.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    truncated.close();
+    QVERIFY(reader.isRotated());
+    QVERIFY(reader.reopen());
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 0);
+    appendToFile("episodes-followed.log", "nth\n");
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("seventh"));
+
+    // Once the file has ended, its last line is complete, even without a
+    // newline.
+    appendToFile("episodes-followed.log", "eighth");
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE), 0);
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE, true), 1);
+    QCOMPARE(QByteArray(chunk[0].data, chunk[0].length), QByteArray("eighth"));
+    QCOMPARE(reader.readChunk(chunk, CHUNK_SIZE, true), 0);
+    reader.close();
+
+    QFile::remove("episodes-followed.log");
+    QFile::remove("episodes-followed.log.1");
+}
+
+void TestParser::follow() {
+    Parser parser;
+    QSignalSpy batches(&parser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time, double)));
+    QByteArray lines, line;
+
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly));
+    lines = logFile.readAll();
+    logFile.close();
+    line = lines.left(lines.indexOf('\n') + 1);
+
+    QFile::remove("episodes-followed.log");
+    appendToFile("episodes-followed.log", lines);
+
+    // All lines belong to a quarter that has ended long ago according to
+    // the wall clock, hence it is closed as soon as following starts,
+    // rather than when the first line of the next quarter arrives.
+    parser.follow("episodes-followed.log");
+    QVERIFY(parser.isFollowing());
+    QCOMPARE(batches.size(), 1);
+    QCOMPARE(batches[0][2].value<Time>(), (Time) 1289712423);
+    QCOMPARE(parser.getNumMalformedLines(), (quint64) 0);
+
+    // A line that is being written while the log is rotated (by
+    // truncation) is completed in the new file. It belongs to the quarter
+    // that has been closed, hence it is late.
+    appendToFile("episodes-followed.log", line.left(50));
+    QVERIFY(QMetaObject::invokeMethod(&parser, "readFollowedFile"));
+    QCOMPARE(parser.getNumLateLines(), (quint64) 0);
+    QFile truncated("episodes-followed.log");
+    QVERIFY(truncated.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    truncated.close();
+    appendToFile("episodes-followed.log", line.mid(50));
+    QVERIFY(QMetaObject::invokeMethod(&parser, "readFollowedFile"));
+    QCOMPARE(parser.getNumLateLines(), (quint64) 1);
+    QCOMPARE(parser.getNumMalformedLines(), (quint64) 0);
+
+    // When following stops, a last line without a newline is parsed, too.
+    appendToFile("episodes-followed.log", line.left(line.size() - 1));
+    QVERIFY(QMetaObject::invokeMethod(&parser, "readFollowedFile"));
+    QCOMPARE(parser.getNumLateLines(), (quint64) 1);
+    parser.stopFollowing();
+    QVERIFY(!parser.isFollowing());
+    QCOMPARE(parser.getNumLateLines(), (quint64) 2);
+    QCOMPARE(parser.getNumMalformedLines(), (quint64) 0);
+    QCOMPARE(batches.size(), 1);
+
+    QFile::remove("episodes-followed.log");
+}
+
+void TestParser::pendingBatches() {
+    Parser parser;
+    QSignalSpy batches(&parser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time, double)));
+    QTime timer;
+    QString line;
+
+    QCOMPARE(parser.getMaxPendingBatches(), PARSER_MAX_PENDING_BATCHES);
+    parser.setMaxPendingBatches(5);
+    parser.setMaxPendingBatches(2);
+    QCOMPARE(parser.getMaxPendingBatches(), 2);
+    QCOMPARE(parser.getNumPendingBatches(), 0);
+
+    // One line per quarter, for 6 quarters: the first 5 are completed.
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly | QIODevice::Text));
+    line = QString::fromUtf8(logFile.readLine());
+    logFile.close();
+    QFile::remove("episodes-pending.log");
+    foreach (const QString & time, QStringList() << "06:27:03" << "06:42:03" << "06:57:03" << "07:12:03" << "07:27:03" << "07:42:03")
+        appendToFile("episodes-pending.log", QString(line).replace("06:27:03", time).toUtf8());
+
+    // The receiver (i.e. the Analyst) does not finish processing any
+    // batch, hence the parser blocks once 2 batches are pending.
+    ParserThread thread(&parser, "episodes-pending.log");
+    thread.start();
+    timer.start();
+    while (parser.getNumPendingBatches() < 2 && timer.elapsed() < 5000)
+        QTest::qSleep(10);
+    QTest::qSleep(200);
+    QCOMPARE(parser.getNumPendingBatches(), 2);
+    QVERIFY(!thread.isFinished());
+
+    // Each processed batch lets the parser emit one more batch, after which
+    // it blocks again.
+    for (int i = 0; i < 2; i++) {
+        parser.continueParsing();
+        QTest::qSleep(200);
+        QCOMPARE(parser.getNumPendingBatches(), 2);
+        QVERIFY(!thread.isFinished());
+    }
+    parser.continueParsing();
+    QVERIFY(thread.wait(5000));
+    QCOMPARE(batches.size(), 5);
+    QCOMPARE(parser.getNumPendingBatches(), 2);
+    QVERIFY(parser.getTotalStallDuration() > 0);
+
+    parser.continueParsing();
+    parser.continueParsing();
+    QCOMPARE(parser.getNumPendingBatches(), 0);
+
+    QFile::remove("episodes-pending.log");
+}
+
+void TestParser::quarterReorderBuffer() {
+    QuarterReorderBuffer buffer(60, 2);
+    QList<EpisodesLogLine> batch;
+    EpisodesLogLine line;
+    const Time quarter = 1289712600; // 14-Nov-2010 05:30:00 UTC, a quarter start.
+
+    // Lines within the first quarter, slightly out of order.
+    line.time = quarter + 10;
+    QVERIFY(buffer.add(line));
+    line.time = quarter + 5;
+    QVERIFY(buffer.add(line));
+    QVERIFY(!buffer.takeCompletedQuarter(batch));
+
+    // A line of the next quarter does not complete the first one yet...
+    line.time = quarter + 900 + 30;
+    QVERIFY(buffer.add(line));
+    QVERIFY(!buffer.takeCompletedQuarter(batch));
+
+    // ... hence a straggler still ends up in the first quarter.
+    line.time = quarter + 899;
+    QVERIFY(buffer.add(line));
+    QCOMPARE(buffer.getNumPendingQuarters(), 2);
+
+    // Once the watermark passes the end of the first quarter, it's complete.
+    line.time = quarter + 900 + 60;
+    QVERIFY(buffer.add(line));
+    QCOMPARE(buffer.getWatermark(), quarter + 900);
+    QVERIFY(buffer.takeCompletedQuarter(batch));
+    QCOMPARE(batch.size(), 3);
+    QCOMPARE(batch[0].time, quarter + 5);
+    QCOMPARE(batch[1].time, quarter + 10);
+    QCOMPARE(batch[2].time, quarter + 899);
+    QVERIFY(!buffer.takeCompletedQuarter(batch));
+
+    // Lines for a quarter that has been taken are dropped.
+    line.time = quarter + 100;
+    QVERIFY(!buffer.add(line));
+    QCOMPARE(buffer.getNumLateLines(), (quint64) 1);
+
+    // The number of pending quarters is bounded.
+    line.time = quarter + 2 * 900;
+    QVERIFY(buffer.add(line));
+    QVERIFY(!buffer.takeCompletedQuarter(batch));
+    line.time = quarter + 3 * 900;
+    QVERIFY(buffer.add(line));
+    QVERIFY(buffer.takeCompletedQuarter(batch));
+    QCOMPARE(batch.size(), 2);
+    QCOMPARE(batch[0].time, quarter + 900 + 30);
+    QVERIFY(!buffer.takeCompletedQuarter(batch));
+
+    // The watermark can also be advanced explicitly.
+    buffer.advanceWatermark(quarter + 4 * 900);
+    QVERIFY(buffer.takeCompletedQuarter(batch));
+    QCOMPARE(batch[0].time, quarter + 2 * 900);
+    QVERIFY(buffer.takeCompletedQuarter(batch));
+    QCOMPARE(batch[0].time, quarter + 3 * 900);
+    QCOMPARE(buffer.getNumPendingQuarters(), 0);
+}
+
+void TestParser::loadShedder() {
+    QList<EpisodesLogLine> batch;
+    QList<EpisodesLogLine> sample;
+    EpisodesLogLine line;
+    const Time quarter = 1289712600; // 14-Nov-2010 05:30:00 UTC, a quarter start.
+
+    for (int i = 0; i < 1000; i++) {
+        line.time = quarter + i * 900 / 1000;
+        line.status = i; // Used to identify the line.
+        batch.append(line);
+    }
+
+    // Disabled by default.
+    LoadShedder disabled;
+    sample = batch;
+    QCOMPARE(disabled.shed(sample), 1.0);
+    QCOMPARE(sample.size(), 1000);
+
+    // Batches that do not exceed the maximum are left untouched.
+    LoadShedder shedder(1000);
+    sample = batch;
+    QCOMPARE(shedder.shed(sample), 1.0);
+    QCOMPARE(sample.size(), 1000);
+    QCOMPARE(shedder.getNumShedLines(), (quint64) 0);
+
+    // Larger batches are sampled at rate 1/k: 1000 page views, of which at
+    // most 300 are expected to be kept, hence k = 4.
+    shedder.setMaxEventsPerQuarter(300);
+    sample = batch;
+    QCOMPARE(shedder.shed(sample), 0.25);
+    QVERIFY(sample.size() > 150 && sample.size() < 350);
+    QCOMPARE(shedder.getNumShedLines(), (quint64) (1000 - sample.size()));
+    QCOMPARE(shedder.getNumSampledBatches(), (quint64) 1);
+
+    // The sample is a subsequence of the batch.
+    for (int i = 1; i < sample.size(); i++)
+        QVERIFY(sample[i - 1].status < sample[i].status);
+
+    // Sampling is reproducible.
+    LoadShedder other(300);
+    QList<EpisodesLogLine> otherSample = batch;
+    other.shed(otherSample);
+    QCOMPARE(otherSample.size(), sample.size());
+    for (int i = 0; i < sample.size(); i++)
+        QCOMPARE(otherSample[i].status, sample[i].status);
+
+    // A batch is never emptied.
+    LoadShedder tiny(1);
+    sample = batch;
+    QCOMPARE(tiny.shed(sample), 0.001);
+    QVERIFY(sample.size() >= 1);
+}
+
+void TestParser::mergedLogReader() {
+    QStringList lines;
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly | QIODevice::Text));
+    QTextStream in(&logFile);
+    while (!in.atEnd())
+        lines.append(in.readLine());
+    logFile.close();
+
+    // Distribute the lines over two files, as if two web servers logged
+    // them. The second file is compressed and contains a malformed line.
+    QFile firstFile("episodes-frontend1.log");
+    QVERIFY(firstFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate));
+    QTextStream first(&firstFile);
+    first << lines[0] << "\n" << lines[2] << "\n" << lines[4] << "\n";
+    first.flush();
+    firstFile.close();
+    QFile secondFile("episodes-frontend2.log");
+    QVERIFY(secondFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate));
+    QTextStream second(&secondFile);
+    second << lines[1] << "\n" << "this is not an Episodes log line" << "\n" << lines[3] << "\n";
+    second.flush();
+    secondFile.close();
+    QVERIFY(gzipFile("episodes-frontend2.log", "episodes-frontend2.log.gz"));
+    QFile::remove("episodes-frontend2.log");
+
+    ParserContext context;
+    MergedLogReader reader;
+    EpisodesLogLine line;
+    QList<Time> times;
+    QVERIFY(!reader.open(QStringList() << "episodes-frontend1.log" << "does-not-exist.log", &context));
+    QVERIFY(reader.open(QStringList() << "episodes-frontend1.log" << "episodes-frontend2.log.gz", &context));
+    while (reader.readLine(line))
+        times.append(line.time);
+    QVERIFY(!reader.hasFailed());
+    QCOMPARE(reader.getNumMalformedLines(), (quint64) 1);
+    reader.close();
+
+    QCOMPARE(times, QList<Time>() << 1289712423 << 1289712426 << 1289712428 << 1289712431 << 1289712432);
+
+    QFile::remove("episodes-frontend1.log");
+    QFile::remove("episodes-frontend2.log.gz");
+}
+
+void TestParser::delimiterIndex() {
+    QFile logFile("episodes.log");
+    QVERIFY(logFile.open(QIODevice::ReadOnly));
+    QByteArray data = logFile.readAll();
+    logFile.close();
+
+    // The expected positions.
+    QVector<quint32> expected;
+    for (int i = 0; i < data.size(); i++)
+        if (DelimiterIndex::isDelimiter(data[i]))
+            expected.append(i);
+    QVERIFY(expected.size() > 0);
+
+    DelimiterIndexImplementation original = DelimiterIndex::getImplementation();
+    QVector<quint32> positions(data.size());
+    int count;
+    for (int implementation = DELIMITER_INDEX_SCALAR; implementation <= DELIMITER_INDEX_AVX2; implementation++) {
+        if (!DelimiterIndex::setImplementation((DelimiterIndexImplementation) implementation))
+            continue;
+
+        // All positions.
+        count = DelimiterIndex::build(data.constData(), data.size(), positions.data(), positions.size());
+        QCOMPARE(count, expected.size());
+        QCOMPARE(positions.mid(0, count), expected);
+
+        // Unaligned blocks, with lengths that are not a multiple of the
+        // block size.
+        for (int offset = 1; offset < 40; offset += 3) {
+            count = DelimiterIndex::build(data.constData() + offset, data.size() - 2 * offset, positions.data(), positions.size());
+            int e = 0;
+            while (expected[e] < (quint32) offset)
+                e++;
+            for (int i = 0; i < count; i++, e++)
+                QCOMPARE(positions[i] + offset, expected[e]);
+            QVERIFY(e == expected.size() || expected[e] >= (quint32) (data.size() - offset));
+        }
+
+        // When there are more delimiters than positions can hold, only the
+        // first ones are stored, but all are counted.
+        positions.fill(0);
+        count = DelimiterIndex::build(data.constData(), data.size(), positions.data(), 10);
+        QCOMPARE(count, expected.size());
+        QCOMPARE(positions.mid(0, 10), expected.mid(0, 10));
+        QCOMPARE(positions[10], (quint32) 0);
+    }
+    DelimiterIndex::setImplementation(original);
+}
+
+void TestParser::scanEpisodes_data() {
+    QTest::addColumn<QByteArray>("ets");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("sample") << QByteArray("css:203,headerjs:94,footerjs:500,domready:843,tabs:110,ToThePointShowHideChangelog:15,DrupalBehaviors:141,frontend:1547") << true;
+    QTest::newRow("single episode") << QByteArray("css:203") << true;
+    QTest::newRow("other delimiters in name") << QByteArray("a[b]\"c:1,d:2") << true;
+    QTest::newRow("empty") << QByteArray("") << false;
+    QTest::newRow("name only") << QByteArray("css") << false;
+    QTest::newRow("empty name") << QByteArray(":203") << false;
+    QTest::newRow("empty duration") << QByteArray("css:") << false;
+    QTest::newRow("trailing comma") << QByteArray("css:203,") << false;
+    QTest::newRow("leading comma") << QByteArray(",css:203") << false;
+    QTest::newRow("double comma") << QByteArray("css:203,,js:94") << false;
+    QTest::newRow("double colon") << QByteArray("css:203:94") << false;
+    QTest::newRow("comma in name") << QByteArray("c,ss:203") << false;
+    QTest::newRow("non-numeric duration") << QByteArray("css:2O3") << false;
+    QTest::newRow("9-digit duration") << QByteArray("css:123456789") << true;
+    QTest::newRow("10-digit duration") << QByteArray("css:1234567890") << false;
+}
+
+void TestParser::scanEpisodes() {
+    QFETCH(QByteArray, ets);
+    QFETCH(bool, valid);
+    RawField field(ets.constData(), ets.size());
+
+    QCOMPARE(EpisodesLogScannerTester::scanEpisodes(field), valid);
+}
+
+void TestParser::benchmarkInterning_data() {
+    QTest::addColumn<bool>("lockFree");
+    QTest::addColumn<int>("numThreads");
+
+    for (int numThreads = 1; numThreads <= 16; numThreads *= 2) {
+        QTest::newRow(qPrintable(QString("QReadWriteLock, %1 threads").arg(numThreads))) << false << numThreads;
+        QTest::newRow(qPrintable(QString("lock-free, %1 threads").arg(numThreads))) << true << numThreads;
+    }
+}
+
+/**
+ * Measure the throughput of N parser threads that are interning the same,
+ * mostly already interned keys, which is the common case while parsing.
+ */
+void TestParser::benchmarkInterning() {
+    QFETCH(bool, lockFree);
+    QFETCH(int, numThreads);
+
+    const int numKeys = 1000;
+    const int rounds = 100;
+    QStringList keys;
+    for (int i = 0; i < numKeys; i++)
+        keys << QString("episode%1").arg(i);
+
+    QList< QVector<quint32> > ids;
+    QBENCHMARK {
+        if (lockFree) {
+            TestInternTable table;
+            internConcurrently(&table, keys, numThreads, rounds, ids);
+        }
+        else {
+            LockedInternTable table;
+            internConcurrently(&table, keys, numThreads, rounds, ids);
+        }
+    }
+}
+
+void TestParser::benchmarkIngestion_data() {
+    QTest::addColumn<bool>("memoryMapped");
+
+    QTest::newRow("QTextStream") << false;
+    QTest::newRow("memory-mapped") << true;
+}
+
+/**
+ * Measure the time it takes both ingestion modes to read 200,000 lines,
+ * i.e. only reading the file and splitting it into lines.
+ */
+void TestParser::benchmarkIngestion() {
+    QFETCH(bool, memoryMapped);
+
+    const int numLines = 200000;
+    QVERIFY(writeBenchmarkLog("episodes-benchmark.log", numLines));
+
+    int linesRead = 0;
+    QBENCHMARK {
+        linesRead = 0;
+        if (memoryMapped) {
+            MappedLogReader reader;
+            RawLineChunk chunk;
+            QVERIFY(reader.open("episodes-benchmark.log"));
+            while (reader.readChunk(chunk, CHUNK_SIZE) > 0)
+                linesRead += chunk.size();
+        }
+        else {
+            QFile file("episodes-benchmark.log");
+            QStringList chunk;
+            QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+            QTextStream in(&file);
+            while (!in.atEnd()) {
+                chunk.append(in.readLine());
+                if (chunk.size() == CHUNK_SIZE) {
+                    linesRead += chunk.size();
+                    chunk.clear();
+                }
+            }
+            linesRead += chunk.size();
+        }
+    }
+    QCOMPARE(linesRead, numLines);
+
+    QFile::remove("episodes-benchmark.log");
+}
+
+void TestParser::benchmarkCompressedIngestion_data() {
+    QTest::addColumn<bool>("streaming");
+
+    QTest::newRow("decompress-then-parse") << false;
+    QTest::newRow("streaming") << true;
+}
+
+/**
+ * Measure the end-to-end ingestion time of a gzip-compressed Episodes log
+ * file of 200,000 lines: either first decompressing it to disk and then reading
+ * it, or reading it directly while it is decompressed on another thread.
+ * Each line is scanned, to have parsing overlap with decompression.
+ */
+void TestParser::benchmarkCompressedIngestion() {
+    QFETCH(bool, streaming);
+
+    const int numLines = 200000;
+    QVERIFY(writeBenchmarkLog("episodes-benchmark.log", numLines));
+    QVERIFY(gzipFile("episodes-benchmark.log", "episodes-benchmark.log.gz"));
+    QFile::remove("episodes-benchmark.log");
+
+    ScannedEpisodesLogLine scanned;
+    int linesRead = 0;
+    QBENCHMARK {
+        linesRead = 0;
+        RawLineChunk chunk;
+        if (streaming) {
+            CompressedLogReader reader;
+            QVERIFY(reader.open("episodes-benchmark.log.gz"));
+            while (reader.readChunk(chunk, CHUNK_SIZE) > 0) {
+                foreach (const RawLine & line, chunk)
+                    EpisodesLogScanner::scan(line.data, line.length, scanned);
+                linesRead += chunk.size();
+            }
+        }
+        else {
+            MappedLogReader reader;
+            QVERIFY(gunzipFile("episodes-benchmark.log.gz", "episodes-benchmark.log"));
+            QVERIFY(reader.open("episodes-benchmark.log"));
+            while (reader.readChunk(chunk, CHUNK_SIZE) > 0) {
+                foreach (const RawLine & line, chunk)
+                    EpisodesLogScanner::scan(line.data, line.length, scanned);
+                linesRead += chunk.size();
+            }
+            reader.close();
+            QFile::remove("episodes-benchmark.log");
+        }
+    }
+    QCOMPARE(linesRead, numLines);
+
+    QFile::remove("episodes-benchmark.log.gz");
+}
+
+/**
+ * Measure the throughput (in bytes per second) of tokenizing 200,000 Episodes
+ * log lines.
+ */
+void TestParser::benchmarkEpisodesLogScanner() {
+    const int numLines = 200000;
+    QByteArray block = buildBenchmarkLog(numLines);
+    QVERIFY(!block.isEmpty());
+
+    // Split it into lines, like the log readers do.
+    RawLineChunk lines;
+    const char * start = block.constData();
+    const char * end = start + block.size();
+    const char * eol;
+    while ((eol = (const char *) memchr(start, '\n', end - start)) != NULL) {
+        lines.append(RawLine(start, eol - start));
+        start = eol + 1;
+    }
+    QCOMPARE(lines.size(), numLines);
+
+    // Tokenize the lines until at least a second has passed, to get a
+    // meaningful throughput.
+    ScannedEpisodesLogLine scanned;
+    QElapsedTimer timer;
+    qint64 elapsed;
+    int numScanned;
+    int repetitions = 0;
+    timer.start();
+    do {
+        numScanned = 0;
+        foreach (const RawLine & line, lines)
+            if (EpisodesLogScanner::scan(line.data, line.length, scanned))
+                numScanned++;
+        repetitions++;
+    } while ((elapsed = timer.elapsed()) < 1000);
+
+    QVERIFY(numScanned > 0);
+    QTest::setBenchmarkResult((qreal) block.size() * repetitions * 1000 / elapsed, QTest::BytesPerSecond);
+}
+
+void TestParser::benchmarkDelimiterIndex_data() {
+    QTest::addColumn<int>("implementation");
+
+    QTest::newRow("scalar") << (int) DELIMITER_INDEX_SCALAR;
+    if (DelimiterIndex::isSupported(DELIMITER_INDEX_SSE2))
+        QTest::newRow("SSE2") << (int) DELIMITER_INDEX_SSE2;
+    if (DelimiterIndex::isSupported(DELIMITER_INDEX_AVX2))
+        QTest::newRow("AVX2") << (int) DELIMITER_INDEX_AVX2;
+}
+
+/**
+ * Measure the throughput (in bytes per second) of finding all delimiters in a
+ * block of 200,000 Episodes log lines, for each implementation that the CPU
+ * supports.
+ */
+void TestParser::benchmarkDelimiterIndex() {
+    QFETCH(int, implementation);
+
+    const int numLines = 200000;
+    QByteArray block = buildBenchmarkLog(numLines);
+    QVERIFY(!block.isEmpty());
+    QVector<quint32> positions(block.size());
+
+    DelimiterIndexImplementation original = DelimiterIndex::getImplementation();
+    QVERIFY(DelimiterIndex::setImplementation((DelimiterIndexImplementation) implementation));
+
+    QElapsedTimer timer;
+    qint64 elapsed;
+    int count;
+    int repetitions = 0;
+    timer.start();
+    do {
+        count = DelimiterIndex::build(block.constData(), block.size(), positions.data(), positions.size());
+        repetitions++;
+    } while ((elapsed = timer.elapsed()) < 1000);
+    DelimiterIndex::setImplementation(original);
+
+    QVERIFY(count > numLines);
+    QTest::setBenchmarkResult((qreal) block.size() * repetitions * 1000 / elapsed, QTest::BytesPerSecond);
+}
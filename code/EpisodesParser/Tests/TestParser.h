@@ -3,7 +3,23 @@
 
 #include <QtTest/QtTest>
 #include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QReadWriteLock>
+#include <QElapsedTimer>
 #include "../Parser.h"
+#include "../ParserContext.h"
+#include "../ConcurrentInternTable.h"
+#include "../TimestampDecoder.h"
+#include "../ShardedCache.h"
+#include "../EventArchive.h"
+#include "../CompressedLogReader.h"
+#include "../FollowingLogReader.h"
+#include "../QuarterReorderBuffer.h"
+#include "../LoadShedder.h"
+#include "../MergedLogReader.h"
+#include "../DelimiterIndex.h"
 
 using namespace EpisodesParser;
 
@@ -11,13 +27,44 @@ class TestParser: public QObject {
     Q_OBJECT
 
 private slots:
-//    void initTestCase() {}
+    void initTestCase();
 //    void cleanupTestCase() {}
     void init();
     void cleanup();
     void parse();
     void mapLineToEpisodesLogLine_data();
     void mapLineToEpisodesLogLine();
+    void mapLineToEpisodesLogLine_malformed_data();
+    void mapLineToEpisodesLogLine_malformed();
+    void mapStringsToEpisodesLogLines();
+    void parserContext();
+    void decodeTimestamp_data();
+    void decodeTimestamp();
+    void episodeDurationDiscretizer_data();
+    void episodeDurationDiscretizer();
+    void concurrentInternTable();
+    void shardedCache();
+    void eventArchive();
+    void replaySampledBatch();
+    void compressedLogReader();
+    void followingLogReader();
+    void follow();
+    void pendingBatches();
+    void quarterReorderBuffer();
+    void loadShedder();
+    void mergedLogReader();
+    void delimiterIndex();
+    void scanEpisodes_data();
+    void scanEpisodes();
+    void benchmarkInterning_data();
+    void benchmarkInterning();
+    void benchmarkIngestion_data();
+    void benchmarkIngestion();
+    void benchmarkCompressedIngestion_data();
+    void benchmarkCompressedIngestion();
+    void benchmarkEpisodesLogScanner();
+    void benchmarkDelimiterIndex_data();
+    void benchmarkDelimiterIndex();
 };
 
 #endif // TESTPARSER_H
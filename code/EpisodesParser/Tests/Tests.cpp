@@ -1,6 +1,9 @@
 #include "TestParser.h"
 
-int main() {
+int main(int argc, char ** argv) {
+    // Follow mode requires an event loop.
+    QCoreApplication app(argc, argv);
+
     TestParser parser;
     QTest::qExec(&parser);
 
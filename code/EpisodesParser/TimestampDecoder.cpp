@@ -0,0 +1,157 @@
+#include "TimestampDecoder.h"
+
+#include <string.h>
+
+namespace EpisodesParser {
+
+    TimestampDecoder::TimestampDecoder() {
+        this->cacheValid = false;
+        this->cachedDayEpoch = -1;
+    }
+
+    /**
+     * Decode a timestamp to a UTC UNIX timestamp.
+     *
+     * @param timestamp
+     *   Pointer to a timestamp of the form "dd-MMM-yyyy HH:mm:ss +zzzz".
+     * @param length
+     *   Length of the timestamp, in bytes.
+     * @return
+     *   The corresponding UNIX timestamp, or (uint) -1 if it is invalid.
+     */
+    Time TimestampDecoder::decode(const char * timestamp, int length) {
+        qint64 dayEpoch;
+        int hours, minutes, seconds, timezoneOffset;
+        qint64 time;
+
+        if (length < TIMESTAMP_LENGTH)
+            return (Time) -1;
+
+        // Date.
+        if (this->cacheValid && memcmp(this->cachedDate, timestamp, TIMESTAMP_DATE_LENGTH) == 0)
+            dayEpoch = this->cachedDayEpoch;
+        else {
+            dayEpoch = TimestampDecoder::decodeDay(timestamp);
+            memcpy(this->cachedDate, timestamp, TIMESTAMP_DATE_LENGTH);
+            this->cachedDayEpoch = dayEpoch;
+            this->cacheValid = true;
+        }
+        // Valid day epochs are multiples of 86400, so -1 is never ambiguous.
+        if (dayEpoch == -1)
+            return (Time) -1;
+
+        // Time: "HH:mm:ss".
+        if (timestamp[11] != ' ' || timestamp[14] != ':' || timestamp[17] != ':')
+            return (Time) -1;
+        hours   = TimestampDecoder::decodeTwoDigits(timestamp + 12);
+        minutes = TimestampDecoder::decodeTwoDigits(timestamp + 15);
+        seconds = TimestampDecoder::decodeTwoDigits(timestamp + 18);
+        if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59)
+            return (Time) -1;
+
+        // Timezone offset: the hours part of the last 5 characters.
+        timezoneOffset = (length < 5) ? 0 : TimestampDecoder::decodeTimezoneOffset(timestamp + length - 5);
+
+        time = dayEpoch + hours * 3600 + minutes * 60 + seconds - timezoneOffset * 3600;
+
+        // Same range as QDateTime::toTime_t().
+        if (time < 0 || time > Q_INT64_C(0xFFFFFFFE))
+            return (Time) -1;
+
+        return (Time) time;
+    }
+
+
+    //---------------------------------------------------------------------------
+    // Protected static methods.
+
+    /**
+     * Decode a "dd-MMM-yyyy" date to the number of seconds between the UNIX
+     * epoch and the start of that day, or -1 if the date is invalid.
+     */
+    qint64 TimestampDecoder::decodeDay(const char * date) {
+        static const char * months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        static const int daysInMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        int day, month, year;
+        bool leap;
+
+        if (date[2] != '-' || date[6] != '-')
+            return -1;
+
+        day = TimestampDecoder::decodeTwoDigits(date);
+
+        month = -1;
+        for (int m = 0; m < 12; m++) {
+            if (memcmp(months + 3 * m, date + 3, 3) == 0) {
+                month = m + 1;
+                break;
+            }
+        }
+
+        year = TimestampDecoder::decodeTwoDigits(date + 7);
+        if (year >= 0 && TimestampDecoder::decodeTwoDigits(date + 9) >= 0)
+            year = year * 100 + TimestampDecoder::decodeTwoDigits(date + 9);
+        else
+            year = -1;
+
+        if (day < 1 || month < 0 || year < 0)
+            return -1;
+
+        leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        if (day > daysInMonth[month - 1] + ((month == 2 && leap) ? 1 : 0))
+            return -1;
+
+        return TimestampDecoder::daysFromCivil(year, month, day) * 86400;
+    }
+
+    /**
+     * Decode the hours of a "+zzzz" timezone offset. Mirrors
+     * QString::toInt() on the first three characters: anything else than a
+     * sign followed by two digits (or three digits) yields 0.
+     */
+    int TimestampDecoder::decodeTimezoneOffset(const char * offset) {
+        int hours;
+
+        if (offset[0] == '+' || offset[0] == '-') {
+            hours = TimestampDecoder::decodeTwoDigits(offset + 1);
+            if (hours < 0)
+                return 0;
+            return (offset[0] == '-') ? -hours : hours;
+        }
+        else if (offset[0] >= '0' && offset[0] <= '9') {
+            hours = TimestampDecoder::decodeTwoDigits(offset + 1);
+            if (hours < 0)
+                return 0;
+            return (offset[0] - '0') * 100 + hours;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Decode two decimal digits, or return -1 if they aren't digits.
+     */
+    int TimestampDecoder::decodeTwoDigits(const char * digits) {
+        if (digits[0] < '0' || digits[0] > '9' || digits[1] < '0' || digits[1] > '9')
+            return -1;
+        return (digits[0] - '0') * 10 + (digits[1] - '0');
+    }
+
+    /**
+     * Number of days between the UNIX epoch and a date in the proleptic
+     * Gregorian calendar.
+     *
+     * See http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
+     */
+    qint64 TimestampDecoder::daysFromCivil(int year, int month, int day) {
+        int era, yearOfEra, dayOfYear, dayOfEra;
+
+        year -= (month <= 2) ? 1 : 0;
+        era = (year >= 0 ? year : year - 399) / 400;
+        yearOfEra = year - era * 400;
+        dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+        return (qint64) era * 146097 + dayOfEra - 719468;
+    }
+}
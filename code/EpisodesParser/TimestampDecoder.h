@@ -0,0 +1,50 @@
+#ifndef TIMESTAMPDECODER_H
+#define TIMESTAMPDECODER_H
+
+#include <QtGlobal>
+
+#include "typedefs.h"
+
+
+namespace EpisodesParser {
+
+    // Length of "dd-MMM-yyyy HH:mm:ss".
+    #define TIMESTAMP_LENGTH 20
+    // Length of "dd-MMM-yyyy".
+    #define TIMESTAMP_DATE_LENGTH 11
+
+    /**
+     * Decoder for the fixed-format timestamps in Episodes log files:
+     *
+     *   dd-MMM-yyyy HH:mm:ss +zzzz
+     *
+     * The result is identical to what QDateTime::fromString() with the
+     * format "dd-MMM-yyyy HH:mm:ss", followed by applying the timezone offset
+     * (only its hours, like the parser always did) and toTime_t() yields,
+     * including (uint) -1 for invalid or unrepresentable timestamps.
+     *
+     * The epoch of the most recently decoded day is cached, so consecutive
+     * timestamps of the same day only cost a few integer operations. A
+     * decoder is not thread-safe: use one decoder per thread.
+     */
+    class TimestampDecoder {
+    public:
+        TimestampDecoder();
+
+        Time decode(const char * timestamp, int length);
+
+    protected:
+        static qint64 decodeDay(const char * date);
+        static int decodeTimezoneOffset(const char * offset);
+        static int decodeTwoDigits(const char * digits);
+        static qint64 daysFromCivil(int year, int month, int day);
+
+        // Cache of the most recently decoded day.
+        char cachedDate[TIMESTAMP_DATE_LENGTH];
+        qint64 cachedDayEpoch;
+        bool cacheValid;
+    };
+
+}
+
+#endif // TIMESTAMPDECODER_H
@@ -4,11 +4,14 @@
 #include <QtGlobal>
 #include <QMetaType>
 #include <QList>
+#include <QVector>
 #include <QHostAddress>
 #include <QStringList>
 #include <QString>
 #include <QHash>
 
+#include "ConcurrentInternTable.h"
+
 #ifdef DEBUG
 #include <QDebug>
 #endif
@@ -19,19 +22,34 @@ namespace EpisodesParser {
 
 typedef uint Time;
 
+// A view on a single line in a raw (memory-mapped) Episodes log file: it
+// points directly into the file's bytes, no copy is made. The line does not
+// include its line terminator and is only valid for as long as the file is
+// mapped.
+struct RawLine {
+    RawLine() : data(NULL), length(0) {}
+    RawLine(const char * data, int length) : data(data), length(length) {}
+
+    const char * data;
+    int length;
+};
+typedef QVector<RawLine> RawLineChunk;
+
 // Efficient storage of Episode names: don't store the actual names, use
 // 8-bit IDs instead. This allows for 256 different Episode names, which
 // should be more than sufficient.
 typedef QString EpisodeName;
 typedef quint8 EpisodeID;
-typedef QHash<EpisodeName, EpisodeID> EpisodeNameIDHash;
-typedef QHash<EpisodeID, EpisodeName> EpisodeIDNameHash;
+typedef ConcurrentInternTable<EpisodeName, EpisodeID> EpisodeDictionary;
 
 // Store Episode durations as 16-bit uints.
 typedef quint16 EpisodeDuration;
 // The EpisodeDuration will be discretized to an EpisodeSpeed for association
 // rule mining.
 typedef QString EpisodeSpeed;
+// The distinct EpisodeSpeeds are few, hence they are identified by 8-bit
+// uints while parsing; their names are only needed when rendering items.
+typedef quint8 EpisodeSpeedID;
 
 struct Episode {
     Episode() {}
@@ -40,7 +58,7 @@ struct Episode {
     EpisodeID id;
     EpisodeDuration duration;
 #ifdef DEBUG
-    EpisodeIDNameHash * IDNameHash;
+    EpisodeDictionary * IDNameHash;
 #endif
 };
 inline bool operator==(const Episode &e1, const Episode &e2) {
@@ -58,14 +76,13 @@ typedef QString UA;
 // Efficient storage of domain names.
 typedef QString DomainName;
 typedef quint8 DomainID;
-typedef QHash<DomainName, DomainID> DomainNameIDHash;
-typedef QHash<DomainID, DomainName> DomainIDNameHash;
+typedef ConcurrentInternTable<DomainName, DomainID> DomainDictionary;
 struct Domain {
     DomainID id;
     // TODO: allow multiple domains to be analyzed as one whole by providing
     // a common identifier.
 #ifdef DEBUG
-    EpisodeIDNameHash * IDNameHash;
+    DomainDictionary * IDNameHash;
 #endif
 };
 
@@ -79,11 +96,19 @@ struct EpisodesLogLine {
     UA ua;
     Domain domain;
 #ifdef DEBUG
-    EpisodeIDNameHash * episodeIDNameHash;
-    DomainIDNameHash * domainIDNameHash;
+    EpisodeDictionary * episodeIDNameHash;
+    DomainDictionary * domainIDNameHash;
 #endif
 };
 
+// The result of mapping a slice of lines to EpisodesLogLines.
+struct ParsedChunkSlice {
+    ParsedChunkSlice() : numMalformedLines(0) {}
+
+    QList<EpisodesLogLine> lines;
+    quint64 numMalformedLines;
+};
+
 
 
 struct Location{
@@ -93,6 +118,10 @@ struct Location{
     QString city;
     QString isp;
 
+    // The result of generateAssociationRuleItems(), rendered once when this
+    // Location is interned. Not part of the Location's identity.
+    QStringList associationRuleItems;
+
     // @TODO this is a likely performance bottleneck.
     // @TRICKY: Note that we don't check continent and country, we assume each
     // (region, city, isp) tuple is unique on its own!
@@ -122,9 +151,8 @@ struct Location{
     }
 };
 typedef quint32 LocationID;
-typedef QHash<Location, LocationID> LocationToIDHash;
-typedef QHash<LocationID, Location> LocationFromIDHash;
 uint qHash(const Location & location);
+typedef ConcurrentInternTable<Location, LocationID> LocationDictionary;
 
 struct UAHierarchyDetails {
     // OS details.
@@ -136,6 +164,10 @@ struct UAHierarchyDetails {
     quint16 browser_version_minor;
     bool is_mobile;
 
+    // The result of generateAssociationRuleItems(), rendered once when these
+    // UAHierarchyDetails are interned. Not part of their identity.
+    QStringList associationRuleItems;
+
     // @TODO this is a likely performance bottleneck.
     bool operator==(const UAHierarchyDetails & other) const {
         return (this->platform == other.platform && this->browser_name == other.browser_name && this->browser_version == other.browser_version);
@@ -171,9 +203,8 @@ struct UAHierarchyDetails {
     }
 };
 typedef quint16 UAHierarchyID;
-typedef QHash<UAHierarchyDetails, UAHierarchyID> UAHierarchyDetailsIDHash;
-typedef QHash<UAHierarchyID, UAHierarchyDetails> UAHierarchyIDDetailsHash;
 uint qHash(const UAHierarchyDetails & ua);
+typedef ConcurrentInternTable<UAHierarchyDetails, UAHierarchyID> UAHierarchyDictionary;
 
 struct ExpandedEpisodesLogLine {
     LocationID location;
@@ -183,10 +214,10 @@ struct ExpandedEpisodesLogLine {
     URL url;
     UAHierarchyID ua;
 
-    LocationFromIDHash * locationFromIDHash;
-    UAHierarchyIDDetailsHash * uaHierarchyIDDetailsHash;
+    LocationDictionary * locationFromIDHash;
+    UAHierarchyDictionary * uaHierarchyIDDetailsHash;
 #ifdef DEBUG
-    EpisodeIDNameHash * episodeIDNameHash;
+    EpisodeDictionary * episodeIDNameHash;
 #endif
 };
 
@@ -8,6 +8,8 @@ MainWindow::MainWindow(QWidget *parent) :
     this->totalParsingDuration = 0;
     this->totalAnalyzingDuration = 0;
     this->totalMiningDuration = 0;
+    this->totalPipelineStallDuration = 0;
+    this->totalApproximateQuarters = 0;
 
     // Logic + connections.
     this->initLogic();
@@ -33,7 +35,7 @@ void MainWindow::updateParsingStatus(bool parsing) {
     QMutexLocker(&this->statusMutex);
     this->parsing = parsing;
     this->updateStatus();
-    this->menuFileImport->setEnabled(!parsing);
+    this->menuFileImport->setEnabled(!parsing && !this->menuFileFollow->isChecked());
     if (!parsing)
         this->mineOrCompare();
 }
@@ -48,6 +50,31 @@ void MainWindow::updateParsingDuration(int duration) {
     );
 }
 
+void MainWindow::updatePipelineStatus(int numPendingBatches, int stallDuration) {
+    this->totalPipelineStallDuration += stallDuration;
+    this->status_performance_pipeline->setText(
+                QString("%1/%2 batches queued (parser stalled %3 s)")
+                .arg(numPendingBatches)
+                .arg(this->parser->getMaxPendingBatches())
+                .arg(QString::number(this->totalPipelineStallDuration / 1000.0, 'f', 2))
+    );
+}
+
+void MainWindow::updateSamplingStatus(Time start, Time end, double samplingRate) {
+    // Only quarters that were sampled because of load shedding are flagged.
+    if (samplingRate >= 1.0)
+        return;
+
+    this->totalApproximateQuarters++;
+    this->status_measurements_approximateQuarters->setText(
+                QString("%1 (last: %2% of page views between %3 and %4)")
+                .arg(this->totalApproximateQuarters)
+                .arg(QString::number(100.0 * samplingRate, 'f', 1))
+                .arg(QDateTime::fromTime_t(start).toString("yyyy-MM-dd hh:mm"))
+                .arg(QDateTime::fromTime_t(end).toString("yyyy-MM-dd hh:mm"))
+    );
+}
+
 void MainWindow::updateAnalyzingDuration(int duration) {
     QMutexLocker(&this->statusMutex);
     this->totalAnalyzingDuration += duration;
@@ -123,6 +150,18 @@ void MainWindow::updateAnalyzingStats(Time start, Time end, int pageViews, int t
     );
 }
 
+void MainWindow::updateDeduplicationStats(int transactions, int distinctTransactions) {
+    if (transactions == 0)
+        return;
+
+    this->status_mining_distinctTransactions->setText(
+                QString("%1 of %2 in last batch (%3% fewer)")
+                .arg(QString::number(distinctTransactions))
+                .arg(QString::number(transactions))
+                .arg(QString::number(100.0 - 100.0 * distinctTransactions / transactions, 'f', 1))
+    );
+}
+
 void MainWindow::minedRules(uint from, uint to, QList<Analytics::AssociationRule> associationRules, Analytics::SupportCount eventsInTimeRange) {
     Time latestAnalyzedTime = this->endTime - (this->endTime % 900) + 900;
     Time endTime = latestAnalyzedTime - (Analytics::TiltedTimeWindow::quarterDistanceToBucket(from, false) * 900);
@@ -328,12 +367,38 @@ void MainWindow::importFile() {
     QSettings settings;
     QString lastDirectory = settings.value("UI/lastImportDirectory", QDesktopServices::storageLocation(QDesktopServices::DesktopLocation)).toString();
 
-    QString logFile = QFileDialog::getOpenFileName(this, tr("Open Episodes log file"), lastDirectory, tr("Episodes log files (*.log)"), NULL, QFileDialog::ReadOnly);
+    // Selecting multiple files means that they cover the same time range
+    // (e.g. the logs of load-balanced web servers): they're merged.
+    QStringList logFiles = QFileDialog::getOpenFileNames(this, tr("Open Episodes log file(s)"), lastDirectory, tr("Episodes log files (*.log *.log.gz *.log.zst)"), NULL, QFileDialog::ReadOnly);
+
+    if (!logFiles.isEmpty()) {
+        settings.setValue("UI/lastImportDirectory", QFileInfo(logFiles.first()).path());
+        if (logFiles.size() == 1)
+            emit parse(logFiles.first());
+        else
+            emit parseMerged(logFiles);
+    }
+}
+
+void MainWindow::followFile(bool follow) {
+    if (!follow) {
+        emit stopFollowing();
+        this->menuFileImport->setEnabled(!this->parsing);
+        return;
+    }
+
+    QSettings settings;
+    QString lastDirectory = settings.value("UI/lastImportDirectory", QDesktopServices::storageLocation(QDesktopServices::DesktopLocation)).toString();
+
+    QString logFile = QFileDialog::getOpenFileName(this, tr("Follow Episodes log file"), lastDirectory, tr("Episodes log files (*.log)"), NULL, QFileDialog::ReadOnly);
 
     if (!logFile.isEmpty()) {
         settings.setValue("UI/lastImportDirectory", QFileInfo(logFile).path());
-        emit parse(logFile);
+        this->menuFileImport->setEnabled(false);
+        emit follow(logFile);
     }
+    else
+        this->menuFileFollow->setChecked(false);
 }
 
 void MainWindow::settingsDialog() {
@@ -367,6 +432,9 @@ void MainWindow::initLogic() {
 
     // Instantiate the EpisodesParser and the Analytics. Then connect them.
     this->parser = new EpisodesParser::Parser();
+    this->parser->setMaxPendingBatches(settings.value("parser/maxPendingBatches", PARSER_MAX_PENDING_BATCHES).toInt());
+    this->parser->setAllowedLateness(settings.value("parser/allowedLateness", REORDER_ALLOWED_LATENESS).toUInt());
+    this->parser->setLoadSheddingThreshold(settings.value("parser/loadSheddingThreshold", LOAD_SHEDDING_MAX_EVENTS_PER_QUARTER).toUInt());
 
     double minSupport = settings.value("analyst/minimumSupport", 0.05).toDouble();
     double minPatternTreeSupport = settings.value("analyst/minimumPatternTreeSupport", 0.04).toDouble();
@@ -383,7 +451,7 @@ void MainWindow::initLogic() {
 
 void MainWindow::connectLogic() {
     // Pure logic.
-    connect(this->parser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time)), this->analyst, SLOT(analyzeTransactions(QList<QStringList>, double, Time, Time)));
+    connect(this->parser, SIGNAL(parsedBatch(QList<QStringList>, double, Time, Time, double)), this->analyst, SLOT(analyzeTransactions(QList<QStringList>, double, Time, Time, double)));
 
     // Logic -> main thread -> logic (wake up sleeping threads).
     connect(this->analyst, SIGNAL(processedBatch()), SLOT(wakeParser()));
@@ -391,11 +459,14 @@ void MainWindow::connectLogic() {
     // Logic -> UI.
     connect(this->parser, SIGNAL(parsing(bool)), SLOT(updateParsingStatus(bool)));
     connect(this->parser, SIGNAL(parsedDuration(int)), SLOT(updateParsingDuration(int)));
+    connect(this->parser, SIGNAL(pipelineStatus(int,int)), SLOT(updatePipelineStatus(int,int)));
+    connect(this->parser, SIGNAL(sampledBatch(Time,Time,double)), SLOT(updateSamplingStatus(Time,Time,double)));
     connect(this->analyst, SIGNAL(analyzing(bool,Time,Time,int,int)), SLOT(updateAnalyzingStatus(bool,Time,Time,int,int)));
     connect(this->analyst, SIGNAL(analyzedDuration(int)), SLOT(updateAnalyzingDuration(int)));
     connect(this->analyst, SIGNAL(mining(bool)), SLOT(updateMiningStatus(bool)));
     connect(this->analyst, SIGNAL(minedDuration(int)), SLOT(updateMiningDuration(int)));
     connect(this->analyst, SIGNAL(stats(Time,Time,int,int,int,int,int)), SLOT(updateAnalyzingStats(Time,Time,int,int,int,int,int)));
+    connect(this->analyst, SIGNAL(deduplicatedTransactions(int,int)), SLOT(updateDeduplicationStats(int,int)));
     connect(this->analyst, SIGNAL(minedRules(uint,uint,QList<Analytics::AssociationRule>,Analytics::SupportCount)), SLOT(minedRules(uint,uint,QList<Analytics::AssociationRule>,Analytics::SupportCount)));
     connect(
                 this->analyst,
@@ -405,6 +476,9 @@ void MainWindow::connectLogic() {
 
     // UI -> logic.
     connect(this, SIGNAL(parse(QString)), this->parser, SLOT(parse(QString)));
+    connect(this, SIGNAL(parseMerged(QStringList)), this->parser, SLOT(parseMerged(QStringList)));
+    connect(this, SIGNAL(follow(QString)), this->parser, SLOT(follow(QString)));
+    connect(this, SIGNAL(stopFollowing()), this->parser, SLOT(stopFollowing()));
     connect(this, SIGNAL(mine(uint,uint)), this->analyst, SLOT(mineRules(uint,uint)));
     connect(this, SIGNAL(mineAndCompare(uint,uint,uint,uint)), this->analyst, SLOT(mineAndCompareRules(uint,uint,uint,uint)));
 }
@@ -685,6 +759,8 @@ void MainWindow::createStatusGroupbox() {
     this->status_measurements_pageViews = new QLabel("0");
     QLabel * me4 = new QLabel(tr("Episodes:"));
     this->status_measurements_episodes = new QLabel("0");
+    QLabel * me5 = new QLabel(tr("Approximate quarters:"));
+    this->status_measurements_approximateQuarters = new QLabel(tr("None"));
     measurementsLayout->addWidget(me1);
     measurementsLayout->addWidget(this->status_measurements_startDate);
     measurementsLayout->addStretch();
@@ -696,6 +772,9 @@ void MainWindow::createStatusGroupbox() {
     measurementsLayout->addStretch();
     measurementsLayout->addWidget(me4);
     measurementsLayout->addWidget(this->status_measurements_episodes);
+    measurementsLayout->addStretch();
+    measurementsLayout->addWidget(me5);
+    measurementsLayout->addWidget(this->status_measurements_approximateQuarters);
     measurementsGroupbox->setLayout(measurementsLayout);
 
     // Add children to "mining" groupbox.
@@ -706,6 +785,8 @@ void MainWindow::createStatusGroupbox() {
     this->status_mining_frequentItems = new QLabel("0");
     QLabel * mir1_3 = new QLabel(tr("Pattern Tree:"));
     this->status_mining_patternTree = new QLabel("0");
+    QLabel * mir1_4 = new QLabel(tr("Distinct transactions:"));
+    this->status_mining_distinctTransactions = new QLabel(tr("N/A yet"));
     miningLayout->addWidget(mir1_1);
     miningLayout->addWidget(this->status_mining_uniqueItems);
     miningLayout->addStretch();
@@ -714,6 +795,9 @@ void MainWindow::createStatusGroupbox() {
     miningLayout->addStretch();
     miningLayout->addWidget(mir1_3);
     miningLayout->addWidget(this->status_mining_patternTree);
+    miningLayout->addStretch();
+    miningLayout->addWidget(mir1_4);
+    miningLayout->addWidget(this->status_mining_distinctTransactions);
     miningGroupbox->setLayout(miningLayout);
 
     // Add children to "performance" groupbox.
@@ -724,6 +808,8 @@ void MainWindow::createStatusGroupbox() {
     this->status_performance_analyzing = new QLabel("0 s");
     QLabel * mir2_3 = new QLabel(tr("Mining:"));
     this->status_performance_mining = new QLabel("0 s");
+    QLabel * mir2_4 = new QLabel(tr("Pipeline:"));
+    this->status_performance_pipeline = new QLabel(tr("N/A yet"));
     performanceLayout->addWidget(mir2_1);
     performanceLayout->addWidget(this->status_performance_parsing);
     performanceLayout->addStretch();
@@ -732,6 +818,9 @@ void MainWindow::createStatusGroupbox() {
     performanceLayout->addStretch();
     performanceLayout->addWidget(mir2_3);
     performanceLayout->addWidget(this->status_performance_mining);
+    performanceLayout->addStretch();
+    performanceLayout->addWidget(mir2_4);
+    performanceLayout->addWidget(this->status_performance_pipeline);
     performanceGroupbox->setLayout(performanceLayout);
 
     // Set layout for groupbox.
@@ -746,6 +835,10 @@ void MainWindow::createMenuBar() {
     this->menuFileImport->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_I));
     this->menuFile->addAction(this->menuFileImport);
 
+    this->menuFileFollow = new QAction(tr("Follow"), this->menuFile);
+    this->menuFileFollow->setCheckable(true);
+    this->menuFile->addAction(this->menuFileFollow);
+
     this->menuFileSettings = new QAction(tr("Settings"), this->menuFile);
     this->menuFile->addAction(this->menuFileSettings);
 
@@ -760,5 +853,6 @@ void MainWindow::connectUI() {
 
     // Menus.
     connect(this->menuFileImport, SIGNAL(triggered()), SLOT(importFile()));
+    connect(this->menuFileFollow, SIGNAL(triggered(bool)), SLOT(followFile(bool)));
     connect(this->menuFileSettings, SIGNAL(triggered()), SLOT(settingsDialog()));
 }
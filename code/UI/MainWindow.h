@@ -65,6 +65,9 @@ public:
 
 signals:
     void parse(QString file);
+    void parseMerged(QStringList files);
+    void follow(QString file);
+    void stopFollowing();
     void mine(uint from, uint to);
     void mineAndCompare(uint fromOlder, uint toOlder, uint fromNewer, uint toNewer);
 
@@ -73,11 +76,14 @@ public slots:
     void wakeParser();
     void updateParsingStatus(bool parsing);
     void updateParsingDuration(int duration);
+    void updatePipelineStatus(int numPendingBatches, int stallDuration);
+    void updateSamplingStatus(Time start, Time end, double samplingRate);
 
     // Analyst: analyzing.
     void updateAnalyzingStatus(bool analyzing, Time start, Time end, int numPageViews, int numTransactions);
     void updateAnalyzingDuration(int duration);
     void updateAnalyzingStats(Time start, Time end, int pageViews, int transactions, int uniqueItems, int frequentItems, int patternTreeSize);
+    void updateDeduplicationStats(int transactions, int distinctTransactions);
 
     // Analyst: mining.
     void updateMiningStatus(bool mining);
@@ -101,6 +107,7 @@ protected slots:
     void causesFilterChanged(QString filterString);
 
     void importFile();
+    void followFile(bool follow);
     void settingsDialog();
 
 private:
@@ -142,6 +149,11 @@ private:
     int totalParsingDuration;
     int totalAnalyzingDuration;
     int totalMiningDuration;
+    // Only updated by slots that the parser's signals invoke through queued
+    // connections, i.e. on the GUI thread, hence not protected by
+    // statusMutex.
+    int totalPipelineStallDuration;
+    int totalApproximateQuarters;
 
     // Major widgets.
     QVBoxLayout * mainLayout;
@@ -175,16 +187,20 @@ private:
     QLabel * status_measurements_endDate;
     QLabel * status_measurements_pageViews;
     QLabel * status_measurements_episodes;
+    QLabel * status_measurements_approximateQuarters;
     QLabel * status_performance_parsing;
     QLabel * status_performance_analyzing;
     QLabel * status_performance_mining;
+    QLabel * status_performance_pipeline;
     QLabel * status_mining_uniqueItems;
     QLabel * status_mining_frequentItems;
     QLabel * status_mining_patternTree;
+    QLabel * status_mining_distinctTransactions;
 
     // Menu bar.
     QMenu * menuFile;
     QAction * menuFileImport;
+    QAction * menuFileFollow;
     QAction * menuFileSettings;
 };
 